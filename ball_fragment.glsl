@@ -1,9 +1,27 @@
 #version 330 core
 
+in vec3 ballColor;
+in vec3 Normal;
+in vec3 FragPos;
+
 out vec4 fragColor;
 
 uniform vec3 objectColor;
 
 void main() {
-    fragColor = vec4(objectColor, 1.0);
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(lightPos.xyz - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+
+    vec3 ambient = 0.4 * lightColor.rgb;
+    vec3 diffuse = max(dot(norm, lightDir), 0.0) * lightColor.rgb;
+    float spec = pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), 32.0);
+    vec3 specular = 0.5 * spec * lightColor.rgb;
+
+    vec3 clusterDiffuse = vec3(0.0), clusterSpecular = vec3(0.0);
+    addClusterLights(FragPos, norm, viewDir, clusterDiffuse, clusterSpecular);
+    diffuse += clusterDiffuse;
+    specular += 0.5 * clusterSpecular;
+
+    fragColor = vec4((ambient + diffuse) * ballColor * objectColor + specular, 1.0);
 }
@@ -0,0 +1,254 @@
+#include "ball_sim.h"
+
+#include <cmath>
+
+// random numbers
+// ------------------------------------------------------------------------
+static inline unsigned int xorshift32(unsigned int state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// uniform float in [0, 1) from the top 24 bits
+static inline float unitFloat(unsigned int r)
+{
+    return static_cast<float>(r >> 8) * (1.0f / 16777216.0f);
+}
+
+static glm::vec3 hueColor(float hue)
+{
+    glm::vec3 rgb(std::fabs(hue * 6.0f - 3.0f) - 1.0f,
+                  2.0f - std::fabs(hue * 6.0f - 2.0f),
+                  2.0f - std::fabs(hue * 6.0f - 4.0f));
+    return glm::clamp(rgb, glm::vec3(0.0f), glm::vec3(1.0f));
+}
+
+// reorders values so that values[i] becomes the old values[order[i]]; the
+// result is built in scratch and swapped in, which leaves scratch holding the
+// old buffer for the next array of the same type
+template <typename T>
+static void permute(std::vector<T>& values, const std::vector<unsigned int>& order, std::vector<T>& scratch)
+{
+    scratch.resize(values.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        scratch[i] = values[order[i]];
+    values.swap(scratch);
+}
+
+static inline int cellCoord(float value, float inverseCellSize)
+{
+    return static_cast<int>(std::floor(value * inverseCellSize));
+}
+
+// BallSystem
+// ------------------------------------------------------------------------
+BallSystem::BallSystem()
+    : cellSize(1.0f), contacts(0), bucketMask(0)
+{
+}
+
+void BallSystem::generate(size_t count, const BallBounds& bounds, unsigned int seed)
+{
+    position.resize(count);
+    previousPosition.resize(count);
+    velocity.resize(count);
+    color.resize(count);
+    radius.resize(count);
+    contacts = 0;
+    if (count == 0)
+        return;
+
+    glm::vec3 extent = bounds.max - bounds.min;
+    float volume = extent.x * extent.y * extent.z;
+    const float maxRadius = 0.09f;
+    const float sphereVolume = 4.18879f; // 4/3 * pi
+    float largest = std::cbrt(0.2f * volume / (count * sphereVolume));
+    largest = largest < maxRadius ? largest : maxRadius;
+    cellSize = 2.0f * largest;
+
+    unsigned int r = seed * 2654435761u + 1u;
+    for (size_t i = 0; i < count; ++i)
+    {
+        r = xorshift32(r); radius[i] = largest * (0.6f + 0.4f * unitFloat(r));
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            r = xorshift32(r);
+            float room = extent[axis] - 2.0f * radius[i];
+            position[i][axis] = bounds.min[axis] + radius[i] + unitFloat(r) * (room > 0.0f ? room : 0.0f);
+        }
+        glm::vec3 direction;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            r = xorshift32(r);
+            direction[axis] = unitFloat(r) * 2.0f - 1.0f;
+        }
+        r = xorshift32(r);
+        float speed = 0.2f + 0.3f * unitFloat(r);
+        velocity[i] = glm::length(direction) > 1e-3f ? glm::normalize(direction) * speed : glm::vec3(speed, 0.0f, 0.0f);
+        r = xorshift32(r); color[i] = hueColor(unitFloat(r));
+    }
+    previousPosition = position;
+}
+
+void BallSystem::step(float deltaTime, const BallBounds& bounds)
+{
+    integrate(0, position.size(), deltaTime, bounds);
+    resolveContacts(bounds);
+}
+
+void BallSystem::integrate(size_t begin, size_t end, float deltaTime, const BallBounds& bounds)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        previousPosition[i] = position[i];
+        position[i] += velocity[i] * deltaTime;
+        bounce(i, bounds);
+    }
+}
+
+void BallSystem::resolveContacts(const BallBounds& bounds)
+{
+    contacts = 0;
+    size_t count = position.size();
+    if (count == 0)
+        return;
+
+    // ball-ball contacts: cells are one diameter wide, so touching balls are
+    // always in the same or adjacent cells. Each ball checks the rest of its own
+    // cell and the 13 neighbours "after" it, which sees every pair exactly once.
+    // Several cells can share a bucket, so entries from other cells are skipped.
+    static const int forward[13][3] = {
+        { 1, 0, 0 },
+        { -1, 1, 0 }, { 0, 1, 0 }, { 1, 1, 0 },
+        { -1, -1, 1 }, { 0, -1, 1 }, { 1, -1, 1 },
+        { -1, 0, 1 }, { 0, 0, 1 }, { 1, 0, 1 },
+        { -1, 1, 1 }, { 0, 1, 1 }, { 1, 1, 1 }
+    };
+    buildGrid();
+    for (unsigned int a = 0; a < count; ++a)
+    {
+        glm::ivec3 cell = ballCell[a];
+        unsigned int ownEnd = cellStart[ballBucket[a] + 1];
+        for (unsigned int b = a + 1; b < ownEnd; ++b)
+        {
+            if (ballCell[b] == cell)
+                collide(a, b);
+        }
+        for (int k = 0; k < 13; ++k)
+        {
+            glm::ivec3 neighbor(cell.x + forward[k][0], cell.y + forward[k][1], cell.z + forward[k][2]);
+            unsigned int bucket = bucketOf(neighbor.x, neighbor.y, neighbor.z);
+            for (unsigned int b = cellStart[bucket]; b < cellStart[bucket + 1]; ++b)
+            {
+                if (ballCell[b] == neighbor)
+                    collide(a, b);
+            }
+        }
+    }
+
+    // pushing a pair apart can move a ball that was against a wall through it;
+    // for the balls that were not pushed this changes nothing
+    for (size_t i = 0; i < count; ++i)
+        bounce(i, bounds);
+}
+
+void BallSystem::bounce(size_t i, const BallBounds& bounds)
+{
+    glm::vec3& p = position[i];
+    glm::vec3& v = velocity[i];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (p[axis] - radius[i] <= bounds.min[axis])
+        {
+            p[axis] = bounds.min[axis] + radius[i];
+            v[axis] = std::fabs(v[axis]);
+        }
+        if (p[axis] + radius[i] >= bounds.max[axis])
+        {
+            p[axis] = bounds.max[axis] - radius[i];
+            v[axis] = -std::fabs(v[axis]);
+        }
+    }
+}
+
+unsigned int BallSystem::bucketOf(int cx, int cy, int cz) const
+{
+    unsigned int h = static_cast<unsigned int>(cx) * 73856093u ^
+                     static_cast<unsigned int>(cy) * 19349663u ^
+                     static_cast<unsigned int>(cz) * 83492791u;
+    return h & bucketMask;
+}
+
+void BallSystem::buildGrid()
+{
+    size_t count = position.size();
+    size_t tableSize = 1;
+    while (tableSize < 2 * count)
+        tableSize <<= 1;
+    bucketMask = static_cast<unsigned int>(tableSize - 1);
+
+    // counting sort by bucket: count, prefix sum to bucket ends, then fill
+    // backwards so every cellStart[b] ends up at the start of its bucket
+    cellStart.assign(tableSize + 1, 0);
+    ballCell.resize(count);
+    ballBucket.resize(count);
+    order.resize(count);
+    float inverseCellSize = 1.0f / cellSize;
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::ivec3 cell(cellCoord(position[i].x, inverseCellSize),
+                        cellCoord(position[i].y, inverseCellSize),
+                        cellCoord(position[i].z, inverseCellSize));
+        ballCell[i] = cell;
+        ballBucket[i] = bucketOf(cell.x, cell.y, cell.z);
+        ++cellStart[ballBucket[i]];
+    }
+    for (size_t b = 1; b < tableSize; ++b)
+        cellStart[b] += cellStart[b - 1];
+    cellStart[tableSize] = static_cast<unsigned int>(count);
+    for (size_t i = count; i-- > 0;)
+        order[--cellStart[ballBucket[i]]] = static_cast<unsigned int>(i);
+
+    // store the balls themselves in bucket order, so a bucket is a contiguous
+    // range and neighbouring balls stay close in memory
+    permute(position, order, scratchVectors);
+    permute(previousPosition, order, scratchVectors);
+    permute(velocity, order, scratchVectors);
+    permute(color, order, scratchVectors);
+    permute(radius, order, scratchFloats);
+    permute(ballCell, order, scratchCells);
+    permute(ballBucket, order, scratchBuckets);
+}
+
+void BallSystem::collide(unsigned int a, unsigned int b)
+{
+    glm::vec3 delta = position[b] - position[a];
+    float reach = radius[a] + radius[b];
+    float distanceSquared = glm::dot(delta, delta);
+    if (distanceSquared >= reach * reach)
+        return;
+
+    float distance = std::sqrt(distanceSquared);
+    glm::vec3 normal = distance > 1e-6f ? delta / distance : glm::vec3(1.0f, 0.0f, 0.0f);
+    float inverseMassA = 1.0f / (radius[a] * radius[a] * radius[a]);
+    float inverseMassB = 1.0f / (radius[b] * radius[b] * radius[b]);
+    float inverseMassSum = inverseMassA + inverseMassB;
+
+    // push the pair apart, the lighter ball moving further
+    float overlap = reach - distance;
+    position[a] -= normal * (overlap * inverseMassA / inverseMassSum);
+    position[b] += normal * (overlap * inverseMassB / inverseMassSum);
+
+    // elastic impulse along the contact normal, only while approaching
+    float approach = glm::dot(velocity[b] - velocity[a], normal);
+    if (approach < 0.0f)
+    {
+        float impulse = -2.0f * approach / inverseMassSum;
+        velocity[a] -= normal * (impulse * inverseMassA);
+        velocity[b] += normal * (impulse * inverseMassB);
+    }
+    ++contacts;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef BALL_SIM_H
+#define BALL_SIM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Axis-aligned box the balls bounce around in.
+struct BallBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// N bouncing balls with per-ball radius and color. Each step integrates the
+// balls, reflects them off the bounds and resolves ball-ball contacts as
+// elastic collisions (mass grows with radius cubed). Candidate pairs come from
+// a uniform spatial hash grid that is rebuilt every step with a counting sort,
+// so a step costs O(n) for any reasonable density. The rebuild also reorders
+// the balls by grid bucket, so indices are not stable across steps.
+class BallSystem
+{
+public:
+    std::vector<glm::vec3> position;
+    // position at the start of the last step, for interpolating between steps
+    std::vector<glm::vec3> previousPosition;
+    std::vector<glm::vec3> velocity;
+    std::vector<glm::vec3> color;
+    std::vector<float> radius;
+
+    BallSystem();
+
+    // replaces all balls with count new ones spread over the bounds; the radius
+    // shrinks as count grows so the box never gets more than ~20% full
+    void generate(size_t count, const BallBounds& bounds, unsigned int seed);
+    // advances every ball by deltaTime: integrate() over all balls, then resolveContacts()
+    void step(float deltaTime, const BallBounds& bounds);
+    // moves balls begin..end-1 and bounces them off the bounds; ranges that do
+    // not overlap can be integrated on different threads
+    void integrate(size_t begin, size_t end, float deltaTime, const BallBounds& bounds);
+    // resolves the contacts between the integrated balls and keeps the ones it
+    // pushes inside the bounds; reorders them, so it must not run alongside integrate()
+    void resolveContacts(const BallBounds& bounds);
+
+    size_t count() const { return position.size(); }
+    // overlapping pairs resolved during the last step
+    size_t contactCount() const { return contacts; }
+
+private:
+    float cellSize;
+    size_t contacts;
+    unsigned int bucketMask;
+    // spatial hash: the balls are kept sorted by bucket, and bucket b holds
+    // balls cellStart[b]..cellStart[b + 1]
+    std::vector<unsigned int> cellStart;
+    std::vector<unsigned int> order;
+    // grid cell and bucket of every ball, as of the last rebuild
+    std::vector<glm::ivec3> ballCell;
+    std::vector<unsigned int> ballBucket;
+    // targets of the reordering in buildGrid(), kept so it does not allocate
+    std::vector<glm::vec3> scratchVectors;
+    std::vector<float> scratchFloats;
+    std::vector<glm::ivec3> scratchCells;
+    std::vector<unsigned int> scratchBuckets;
+
+    unsigned int bucketOf(int cx, int cy, int cz) const;
+    // clamps ball i inside the bounds, inset by its radius, and turns its velocity away from the walls it hit
+    void bounce(size_t i, const BallBounds& bounds);
+    void buildGrid();
+    void collide(unsigned int a, unsigned int b);
+};
+#endif
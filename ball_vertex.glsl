@@ -1,10 +1,23 @@
 #version 330 core
+// unit sphere vertex
 layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+// per-ball instance data
+layout(location = 2) in vec3 aCenter;
+layout(location = 3) in float aRadius;
+layout(location = 4) in vec3 aColor;
+layout(location = 5) in vec3 aPrevCenter; // center one simulation step earlier
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform float interpolation; // 0 = previous step, 1 = latest step
+
+out vec3 ballColor;
+out vec3 Normal;
+out vec3 FragPos;
 
 void main() {
-    gl_Position = projection * view * model * vec4(position, 1.0);
+    ballColor = aColor;
+    vec3 center = mix(aPrevCenter, aCenter, interpolation);
+    FragPos = center + position * aRadius;
+    Normal = normal;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
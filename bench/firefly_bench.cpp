@@ -0,0 +1,127 @@
+// Firefly update benchmark: times every update kernel the CPU supports on
+// 1M fireflies and checks that each one matches the scalar kernel bit for bit,
+// then times the best kernel split into chunks across the job system.
+//
+//   g++ -O2 -std=c++14 -pthread -I.. firefly_bench.cpp ../firefly_sim.cpp ../job_system.cpp -o firefly_bench
+//   ./firefly_bench [count] [iterations]
+
+#include "firefly_sim.h"
+#include "job_system.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct ChunkedUpdate
+{
+    FireflyStore* store;
+    float deltaTime;
+    FireflyBounds bounds;
+    FireflyKernel kernel;
+};
+
+static void updateChunk(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+{
+    const ChunkedUpdate* update = static_cast<const ChunkedUpdate*>(context);
+    updateFireflies(*update->store, begin, end, update->deltaTime, update->bounds, update->kernel);
+}
+
+static double bestOf(const std::vector<double>& times, double* mean)
+{
+    double best = times[0], total = 0.0;
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+        best = times[i] < best ? times[i] : best;
+        total += times[i];
+    }
+    *mean = total / times.size();
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 1000000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    const float deltaTime = 1.0f / 60.0f;
+    FireflyBounds bounds = { 0.0f, 0.3f, 2.0f, -0.2f };
+
+    // reference run with the scalar kernel
+    FireflyStore reference;
+    generateFireflies(reference, count, bounds, 1234u);
+    for (int i = 0; i < 8; ++i)
+        updateFireflies(reference, 0, reference.capacity(), deltaTime, bounds, FIREFLY_KERNEL_SCALAR);
+
+    printf("fireflies: %zu, iterations: %d, best kernel: %s\n", count, iterations, fireflyKernelName(fireflyBestKernel()));
+    const FireflyKernel kernels[] = { FIREFLY_KERNEL_SCALAR, FIREFLY_KERNEL_SSE2, FIREFLY_KERNEL_AVX2 };
+    bool allMatch = true;
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k)
+    {
+        FireflyKernel kernel = kernels[k];
+        if (!fireflyKernelSupported(kernel))
+        {
+            printf("%-7s unsupported\n", fireflyKernelName(kernel));
+            continue;
+        }
+
+        FireflyStore store;
+        generateFireflies(store, count, bounds, 1234u);
+        for (int i = 0; i < 8; ++i)
+            updateFireflies(store, 0, store.capacity(), deltaTime, bounds, kernel);
+        size_t bytes = store.capacity() * sizeof(float);
+        bool match = memcmp(store.x, reference.x, bytes) == 0 && memcmp(store.y, reference.y, bytes) == 0 &&
+                     memcmp(store.rng, reference.rng, store.capacity() * sizeof(unsigned int)) == 0;
+        allMatch = allMatch && match;
+
+        std::vector<double> times;
+        for (int i = 0; i < iterations; ++i)
+        {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            updateFireflies(store, 0, store.capacity(), deltaTime, bounds, kernel);
+            std::chrono::high_resolution_clock::time_point stop = std::chrono::high_resolution_clock::now();
+            times.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+        }
+        double mean;
+        double best = bestOf(times, &mean);
+        printf("%-7s mean %8.3f ms  best %8.3f ms  %6.2f ns/firefly  %s\n", fireflyKernelName(kernel),
+               mean, best, best * 1e6 / count, match ? "matches scalar" : "MISMATCH");
+    }
+
+    // best kernel in fixed-size chunks on 0..N worker threads (plus the waiting thread)
+    const size_t chunkSize = 16384;
+    unsigned int maxWorkers = JobSystem::defaultWorkerCount() > 0 ? JobSystem::defaultWorkerCount() : 1;
+    for (unsigned int workers = 0; workers <= maxWorkers; workers = workers ? workers * 2 : 1)
+    {
+        JobSystem jobs(workers);
+        FireflyStore store;
+        generateFireflies(store, count, bounds, 1234u);
+        ChunkedUpdate update = { &store, deltaTime, bounds, fireflyBestKernel() };
+        for (int i = 0; i < 8; ++i)
+        {
+            JobCounter counter;
+            jobs.parallelFor(store.capacity(), chunkSize, updateChunk, &update, counter);
+            jobs.wait(counter);
+        }
+        size_t bytes = store.capacity() * sizeof(float);
+        bool match = memcmp(store.x, reference.x, bytes) == 0 && memcmp(store.y, reference.y, bytes) == 0 &&
+                     memcmp(store.rng, reference.rng, store.capacity() * sizeof(unsigned int)) == 0;
+        allMatch = allMatch && match;
+
+        std::vector<double> times;
+        for (int i = 0; i < iterations; ++i)
+        {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            JobCounter counter;
+            jobs.parallelFor(store.capacity(), chunkSize, updateChunk, &update, counter);
+            jobs.wait(counter);
+            std::chrono::high_resolution_clock::time_point stop = std::chrono::high_resolution_clock::now();
+            times.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+        }
+        double mean;
+        double best = bestOf(times, &mean);
+        printf("%u workers mean %8.3f ms  best %8.3f ms  %6.2f ns/firefly  %s\n", workers,
+               mean, best, best * 1e6 / count, match ? "matches scalar" : "MISMATCH");
+    }
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+// JPEG decode benchmark: decodes each file with the scalar stb_image decoder,
+// with the SIMD kernels, and with the SIMD kernels plus the job system as
+// stb_image's parallel_for, and checks every result against the scalar one
+// byte for byte. Restart intervals, progressive IDCT and color conversion are
+// only split into tasks for images of 512x512 and up.
+//
+//   g++ -O2 -std=c++14 -pthread -mavx2 -I.. jpeg_bench.cpp jpeg_scalar.cpp ../job_system.cpp -o jpeg_bench
+//   ./jpeg_bench [iterations] [file.jpg ...]
+//
+// Without -mavx2 GCC and Clang stop at the SSE2 kernels; MSVC picks AVX2 at run time.
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_STATIC
+#define STBI_ONLY_JPEG
+#include "stb_image.h"
+#include "job_system.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+unsigned char* scalarJpegLoad(const unsigned char* data, int size, int* width, int* height, int* channels);
+void scalarJpegFree(unsigned char* pixels);
+
+struct JpegTasks
+{
+    stbi_jpeg_task* task;
+    void* data;
+};
+
+static void runJpegTasks(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+{
+    const JpegTasks* tasks = static_cast<const JpegTasks*>(context);
+    for (size_t i = begin; i < end; ++i)
+        tasks->task(tasks->data, static_cast<int>(i));
+}
+
+static void jobParallelFor(void* user, int count, stbi_jpeg_task* task, void* data)
+{
+    JobSystem* jobs = static_cast<JobSystem*>(user);
+    JpegTasks tasks = { task, data };
+    JobCounter counter;
+    jobs->parallelFor(static_cast<size_t>(count), 1, runJpegTasks, &tasks, counter);
+    jobs->wait(counter);
+}
+
+static bool readFile(const char* path, std::vector<unsigned char>& bytes)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    bytes.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    bool ok = size > 0 && fread(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    fclose(file);
+    return ok;
+}
+
+// best time in ms; *match is false if any decode differs from reference
+static double timeDecodes(const std::vector<unsigned char>& bytes, int iterations, bool scalar,
+                          const unsigned char* reference, size_t referenceSize, bool* match)
+{
+    double best = 1e30;
+    *match = true;
+    for (int i = 0; i < iterations; ++i)
+    {
+        int width, height, channels;
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        unsigned char* pixels = scalar ? scalarJpegLoad(&bytes[0], static_cast<int>(bytes.size()), &width, &height, &channels)
+                                       : stbi_load_from_memory(&bytes[0], static_cast<int>(bytes.size()), &width, &height, &channels, 0);
+        std::chrono::high_resolution_clock::time_point stop = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+        best = ms < best ? ms : best;
+        if (reference)
+            *match = *match && pixels && static_cast<size_t>(width) * height * channels == referenceSize &&
+                     memcmp(pixels, reference, referenceSize) == 0;
+        if (scalar)
+            scalarJpegFree(pixels);
+        else
+            stbi_image_free(pixels);
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 10;
+    std::vector<const char*> paths;
+    for (int i = 2; i < argc; ++i)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        paths.push_back("../board_texture.jpg");
+        paths.push_back("../frame_texture.jpg");
+    }
+    if (iterations < 1)
+        iterations = 1;
+
+    bool allMatch = true;
+    unsigned int maxWorkers = JobSystem::defaultWorkerCount() > 0 ? JobSystem::defaultWorkerCount() : 1;
+    for (size_t p = 0; p < paths.size(); ++p)
+    {
+        std::vector<unsigned char> bytes;
+        if (!readFile(paths[p], bytes))
+        {
+            printf("%s: cannot read\n", paths[p]);
+            allMatch = false;
+            continue;
+        }
+        int width, height, channels;
+        unsigned char* reference = scalarJpegLoad(&bytes[0], static_cast<int>(bytes.size()), &width, &height, &channels);
+        if (!reference)
+        {
+            printf("%s: not a JPEG stb_image can decode\n", paths[p]);
+            allMatch = false;
+            continue;
+        }
+        size_t referenceSize = static_cast<size_t>(width) * height * channels;
+        printf("%s: %dx%d, %d channels, %zu bytes\n", paths[p], width, height, channels, bytes.size());
+
+        bool match;
+        double scalar = timeDecodes(bytes, iterations, true, NULL, 0, &match);
+        printf("  scalar           %9.3f ms  %7.2f Mpixel/s\n", scalar, width * height / scalar / 1e3);
+
+        stbi_jpeg_set_parallel_for(NULL, NULL, 1);
+        double simd = timeDecodes(bytes, iterations, false, reference, referenceSize, &match);
+        allMatch = allMatch && match;
+        printf("  simd             %9.3f ms  %7.2f Mpixel/s  x%.2f  %s\n", simd, width * height / simd / 1e3,
+               scalar / simd, match ? "matches scalar" : "MISMATCH");
+
+        // 0..N workers plus the waiting thread
+        for (unsigned int workers = 0; workers <= maxWorkers; workers = workers ? workers * 2 : 1)
+        {
+            JobSystem jobs(workers);
+            stbi_jpeg_set_parallel_for(jobParallelFor, &jobs, static_cast<int>(workers) + 1);
+            double parallel = timeDecodes(bytes, iterations, false, reference, referenceSize, &match);
+            allMatch = allMatch && match;
+            printf("  simd, %2u workers %9.3f ms  %7.2f Mpixel/s  x%.2f  %s\n", workers, parallel,
+                   width * height / parallel / 1e3, scalar / parallel, match ? "matches scalar" : "MISMATCH");
+            stbi_jpeg_set_parallel_for(NULL, NULL, 1);
+        }
+        scalarJpegFree(reference);
+    }
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+// The stb_image JPEG decoder with every SIMD kernel compiled out, as the
+// reference for jpeg_bench. Static, so it can sit next to the accelerated copy.
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_STATIC
+#define STBI_NO_SIMD
+#define STBI_ONLY_JPEG
+#include "stb_image.h"
+
+unsigned char* scalarJpegLoad(const unsigned char* data, int size, int* width, int* height, int* channels)
+{
+    return stbi_load_from_memory(data, size, width, height, channels, 0);
+}
+
+void scalarJpegFree(unsigned char* pixels)
+{
+    stbi_image_free(pixels);
+}
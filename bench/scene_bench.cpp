@@ -0,0 +1,764 @@
+// Micro-benchmarks for the CPU hot paths of the scene: mesh generation, the
+// firefly and ball simulation steps, ball LOD grouping, camera matrices,
+// building, refitting and frustum culling the bounding volume hierarchy,
+// rasterizing occluders and testing boxes against them, assigning point
+// lights to clusters, ImGui draw list / font atlas building and loading a
+// scene file from its text and its compiled form. Each case is timed over several
+// samples of enough iterations to last --min-time seconds; inputs that scale
+// are run at sizes 1e2 to 1e6 (ImDrawList cases stop at 1e5 primitives, about
+// a million vertices, far more than a frame ever holds).
+//
+// Results go to the console and, with --json, to a file with one benchmark
+// per line; --compare checks a run against a baseline and fails if any case
+// got slower than --threshold allows.
+//
+//   cmake -S bench -B build/bench -DCMAKE_BUILD_TYPE=Release && cmake --build build/bench
+//   build/bench/scene_bench [--filter TEXT] [--max-size N] [--min-time S] [--samples N] [--json FILE]
+//   build/bench/scene_bench --compare BASE.json NEW.json [--threshold 0.10]
+
+#include "ball_sim.h"
+#include "camera.h"
+#include "culling.h"
+#include "occlusion.h"
+#include "light_clusters.h"
+#include "firefly_sim.h"
+#include "job_system.h"
+#include "scene_file.h"
+#include "scene_geometry.h"
+#include "scene_simulation.h"
+#include "sphere_mesh.h"
+
+#include "imgui.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Settings
+    {
+        std::string filter;
+        size_t maxSize;
+        double minTime;
+        int samples;
+        std::string jsonPath;
+        Settings() : maxSize(1000000), minTime(0.05), samples(5) {}
+    };
+
+    struct Result
+    {
+        std::string name;
+        size_t size;
+        long long iterations;
+        double minNs;
+        double medianNs;
+        double meanNs;
+    };
+
+    Settings settings;
+    std::vector<Result> results;
+    // results are folded into this so the optimizer cannot drop the work
+    volatile double sink;
+
+    bool selected(const char* name)
+    {
+        return settings.filter.empty() || std::strstr(name, settings.filter.c_str()) != NULL;
+    }
+
+    // Times body(iterations) for the case: first finds an iteration count whose
+    // sample lasts at least minTime, then takes the samples. setup() runs
+    // before every sample and is not timed.
+    template <typename Setup, typename Body>
+    void measure(const char* name, size_t size, Setup setup, Body body)
+    {
+        long long iterations = 1;
+        for (;;)
+        {
+            setup();
+            Clock::time_point start = Clock::now();
+            body(iterations);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (seconds >= settings.minTime || iterations >= (1LL << 40))
+                break;
+            // aim a little past minTime, but never grow by more than 100x at once
+            double scale = seconds > 0.0 ? settings.minTime * 1.2 / seconds : 100.0;
+            iterations = static_cast<long long>(iterations * std::min(std::max(scale, 2.0), 100.0));
+        }
+
+        std::vector<double> perIteration;
+        for (int sample = 0; sample < settings.samples; ++sample)
+        {
+            setup();
+            Clock::time_point start = Clock::now();
+            body(iterations);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            perIteration.push_back(seconds * 1e9 / iterations);
+        }
+        std::sort(perIteration.begin(), perIteration.end());
+        double total = 0.0;
+        for (size_t i = 0; i < perIteration.size(); ++i)
+            total += perIteration[i];
+
+        Result result;
+        result.name = name;
+        result.size = size;
+        result.iterations = iterations;
+        result.minNs = perIteration.front();
+        result.medianNs = perIteration[perIteration.size() / 2];
+        result.meanNs = total / perIteration.size();
+        results.push_back(result);
+        std::printf("%-28s %8zu %12.1f ns %12.1f ns %10.3f ns/item %10lld it\n", name, size, result.medianNs, result.minNs,
+                    result.medianNs / size, iterations);
+        std::fflush(stdout);
+    }
+
+    template <typename Body>
+    void measure(const char* name, size_t size, Body body)
+    {
+        measure(name, size, [] {}, body);
+    }
+
+    std::vector<size_t> sizes(size_t largest)
+    {
+        std::vector<size_t> list;
+        for (size_t size = 100; size <= std::min(largest, settings.maxSize); size *= 10)
+            list.push_back(size);
+        return list;
+    }
+
+    const glm::vec3 roomCenter(0.0f, 0.3f, 2.0f);
+    const float roomScale = 2.0f;
+    const float stepSeconds = 1.0f / 60.0f;
+
+    void benchGeometry()
+    {
+        // a cube as main.cpp lays it out: position and normal per vertex
+        std::vector<float> cube;
+        const float faces[6][3] = { { 0, 0, -1 }, { 0, 0, 1 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 } };
+        for (int face = 0; face < 6; ++face)
+            for (int v = 0; v < 6; ++v)
+            {
+                const float corner[3] = { faces[face][0] * 0.5f, faces[face][1] * 0.5f, faces[face][2] * 0.5f };
+                cube.insert(cube.end(), corner, corner + 3);
+                cube.insert(cube.end(), faces[face], faces[face] + 3);
+            }
+
+        if (selected("room_mesh"))
+        {
+            std::vector<float> vertices;
+            std::vector<unsigned int> indices;
+            measure("room_mesh", 1, [&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i)
+                {
+                    generateRoomMesh(&cube[0], vertices, indices);
+                    sink = sink + vertices[0];
+                }
+            });
+        }
+        if (selected("chalkboard_vertices"))
+            measure("chalkboard_vertices", 1, [&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i)
+                    sink = sink + generateChalkboardVertices(glm::vec3(1.0f, 0.6f, 0.05f))[0];
+            });
+        if (selected("frame_vertices"))
+            measure("frame_vertices", 1, [&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i)
+                    sink = sink + generateFrameVertices(glm::vec3(1.05f, 0.65f, 0.05f), 0.05f)[0];
+            });
+
+        // one level of about size vertices: (sectors + 1) * (sectors / 2 + 1)
+        if (selected("sphere_mesh"))
+        {
+            std::vector<size_t> list = sizes(1000000);
+            for (size_t s = 0; s < list.size(); ++s)
+            {
+                int levels[1][2];
+                levels[0][0] = static_cast<int>(std::sqrt(2.0 * list[s]));
+                levels[0][1] = levels[0][0] / 2;
+                measure("sphere_mesh", list[s], [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                        sink = sink + generateSphereLods(levels, 1).vertices.size();
+                });
+            }
+        }
+    }
+
+    // the layout of a simulation snapshot: positions, radii, colors, previous positions
+    std::vector<float> ballSnapshot(const BallSystem& balls, size_t count)
+    {
+        std::vector<float> snapshot(10 * count);
+        std::memcpy(&snapshot[0], &balls.position[0], count * sizeof(glm::vec3));
+        std::memcpy(&snapshot[3 * count], &balls.radius[0], count * sizeof(float));
+        std::memcpy(&snapshot[4 * count], &balls.color[0], count * sizeof(glm::vec3));
+        std::memcpy(&snapshot[7 * count], &balls.previousPosition[0], count * sizeof(glm::vec3));
+        return snapshot;
+    }
+
+    void benchSimulation(JobSystem& jobs)
+    {
+        std::vector<size_t> list = sizes(1000000);
+        const FireflyBounds fireflyBounds = roomFireflyBounds(roomCenter);
+        const BallBounds ballBounds = roomBallBounds(roomCenter, roomScale);
+
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            size_t count = list[s];
+            FireflyStore fireflies;
+            generateFireflies(fireflies, count, fireflyBounds, 1u);
+            if (selected("firefly_update"))
+                measure("firefly_update", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                        updateFireflies(fireflies, stepSeconds, fireflyBounds);
+                    sink = sink + fireflies.x[0];
+                });
+            if (selected("firefly_update_jobs"))
+                measure("firefly_update_jobs", count, [&](long long iterations) {
+                    FireflyStep step = { &fireflies, stepSeconds, fireflyBounds, fireflyBestKernel() };
+                    for (long long i = 0; i < iterations; ++i)
+                    {
+                        JobCounter counter;
+                        kickFireflyStep(jobs, step, counter);
+                        jobs.wait(counter);
+                    }
+                    sink = sink + fireflies.x[0];
+                });
+        }
+
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            size_t count = list[s];
+            BallSystem balls;
+            if (selected("ball_step"))
+            {
+                // every sample starts from the same state, so later samples are not
+                // timing a pile of balls that has settled
+                measure("ball_step", count, [&] { balls.generate(count, ballBounds, 1u); }, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                        balls.step(stepSeconds, ballBounds);
+                    sink = sink + balls.position[0].x;
+                });
+            }
+
+            if (selected("ball_lod_grouping"))
+            {
+                balls.generate(count, ballBounds, 1u);
+                balls.step(stepSeconds, ballBounds);
+                std::vector<float> snapshot = ballSnapshot(balls, count);
+                const int levels[][2] = { { 8, 4 }, { 16, 8 }, { 32, 16 }, { 64, 32 }, { 128, 64 } };
+                SphereMesh mesh = generateSphereLods(levels, 5);
+                glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 960.0f, 0.1f, 100.0f);
+                float pixelsPerUnit = projection[1][1] * 0.5f * 960.0f;
+                std::vector<float> instances;
+                std::vector<size_t> lodCounts;
+                std::vector<unsigned char> ballLod;
+                measure("ball_lod_grouping", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                        groupBallsByLod(&snapshot[0], count, mesh, glm::vec3(0.0f, 0.3f, 3.3f), pixelsPerUnit, 8.0f, instances, lodCounts, ballLod);
+                    sink = sink + instances[0];
+                });
+            }
+        }
+    }
+
+    void benchCamera()
+    {
+        if (!selected("camera_matrices"))
+            return;
+        std::vector<size_t> list = sizes(1000000);
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            size_t count = list[s];
+            // per update: mouse look, a step forward, and the view and projection matrices of a frame
+            measure("camera_matrices", count, [&](long long iterations) {
+                Camera camera(glm::vec3(0.0f, 0.3f, 3.3f));
+                float total = 0.0f;
+                for (long long i = 0; i < iterations; ++i)
+                    for (size_t u = 0; u < count; ++u)
+                    {
+                        camera.ProcessMouseMovement((u & 1) ? 0.5f : -0.5f, (u & 2) ? 0.25f : -0.25f);
+                        camera.ProcessKeyboard((u & 4) ? FORWARD : BACKWARD, stepSeconds);
+                        glm::mat4 view = camera.GetViewMatrix();
+                        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 1280.0f / 960.0f, 0.1f, 100.0f);
+                        total += (projection * view)[3][2];
+                    }
+                sink = sink + total;
+            });
+        }
+    }
+
+    // ball boxes as the app culls them, seen from the default camera, which has
+    // the whole room in view; the culling case looks at one corner of it instead
+    void benchCulling()
+    {
+        if (!selected("bvh_build") && !selected("bvh_refit") && !selected("frustum_cull"))
+            return;
+        const BallBounds ballBounds = roomBallBounds(roomCenter, roomScale);
+        std::vector<size_t> list = sizes(1000000);
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            size_t count = list[s];
+            BallSystem balls;
+            balls.generate(count, ballBounds, 1u);
+            balls.step(stepSeconds, ballBounds);
+            std::vector<float> snapshot = ballSnapshot(balls, count);
+            std::vector<BoundingBox> boxes(count);
+            ballBoundingBoxes(&snapshot[0], count, &boxes[0]);
+            BoundingVolumeHierarchy hierarchy;
+            if (selected("bvh_build"))
+                measure("bvh_build", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                        hierarchy.build(&boxes[0], count);
+                    sink = sink + hierarchy.nodeCount();
+                });
+            hierarchy.build(&boxes[0], count);
+            // one simulation step's worth of movement per refit
+            if (selected("bvh_refit"))
+            {
+                balls.step(stepSeconds, ballBounds);
+                snapshot = ballSnapshot(balls, count);
+                std::vector<BoundingBox> moved(count);
+                ballBoundingBoxes(&snapshot[0], count, &moved[0]);
+                measure("bvh_refit", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                        hierarchy.refit((i & 1) ? &boxes[0] : &moved[0]);
+                    sink = sink + hierarchy.cost();
+                });
+            }
+            if (selected("frustum_cull"))
+            {
+                glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 960.0f, 0.1f, 100.0f);
+                glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.3f, 3.3f), glm::vec3(-0.6f, -0.1f, 1.6f), glm::vec3(0.0f, 1.0f, 0.0f));
+                Frustum frustum(projection * view);
+                std::vector<uint32_t> visible;
+                visible.reserve(count);
+                measure("frustum_cull", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                    {
+                        visible.clear();
+                        hierarchy.cull(frustum, visible);
+                    }
+                    sink = sink + visible.size();
+                });
+            }
+        }
+    }
+
+    // triangles of the faces of a box around the origin, three floats per
+    // vertex; openSide (0 to 5 for -x, +x, -y, +y, -z, +z, or -1) is left out
+    std::vector<float> boxTriangles(const glm::vec3& halfExtent, int openSide)
+    {
+        std::vector<float> triangles;
+        for (int face = 0; face < 6; ++face)
+        {
+            if (face == openSide)
+                continue;
+            int axis = face / 2;
+            float side = (face % 2) ? 1.0f : -1.0f;
+            glm::vec3 corners[4];
+            for (int c = 0; c < 4; ++c)
+            {
+                glm::vec3 corner;
+                corner[axis] = side;
+                corner[(axis + 1) % 3] = (c == 1 || c == 2) ? 1.0f : -1.0f;
+                corner[(axis + 2) % 3] = (c >= 2) ? 1.0f : -1.0f;
+                corners[c] = corner * halfExtent;
+            }
+            const int order[6] = { 0, 1, 2, 0, 2, 3 };
+            for (int v = 0; v < 6; ++v)
+                triangles.insert(triangles.end(), &corners[order[v]].x, &corners[order[v]].x + 3);
+        }
+        return triangles;
+    }
+
+    // the room's five walls and the chalkboard as occluders; the test case
+    // looks into the room past its right wall, which hides part of the balls
+    void benchOcclusion(JobSystem& jobs)
+    {
+        if (!selected("occlusion_render") && !selected("occlusion_test"))
+            return;
+        std::vector<float> walls = boxTriangles(glm::vec3(0.5f * roomScale, 0.5f, 0.5f), 5);
+        std::vector<float> board = boxTriangles(glm::vec3(0.5f, 0.3f, 0.025f), -1);
+        glm::mat4 wallModel = glm::translate(glm::mat4(1.0f), roomCenter);
+        glm::mat4 boardModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.3f, 1.51f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 960.0f, 0.1f, 100.0f);
+        OcclusionBuffer occlusion;
+
+        if (selected("occlusion_render"))
+        {
+            glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.3f, 3.3f), glm::vec3(0.0f, 0.3f, 2.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+            measure("occlusion_render", 1, [&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i)
+                {
+                    occlusion.begin(projection * view);
+                    occlusion.addOccluder(&walls[0], 3, NULL, walls.size() / 3, wallModel);
+                    occlusion.addOccluder(&board[0], 3, NULL, board.size() / 3, boardModel);
+                    occlusion.render(jobs);
+                }
+                sink = sink + occlusion.triangleCount();
+            });
+        }
+
+        if (!selected("occlusion_test"))
+            return;
+        glm::mat4 view = glm::lookAt(glm::vec3(1.6f, 0.3f, 3.0f), roomCenter, glm::vec3(0.0f, 1.0f, 0.0f));
+        occlusion.begin(projection * view);
+        occlusion.addOccluder(&walls[0], 3, NULL, walls.size() / 3, wallModel);
+        occlusion.addOccluder(&board[0], 3, NULL, board.size() / 3, boardModel);
+        occlusion.render(jobs);
+        const BallBounds ballBounds = roomBallBounds(roomCenter, roomScale);
+        std::vector<size_t> list = sizes(1000000);
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            size_t count = list[s];
+            BallSystem balls;
+            balls.generate(count, ballBounds, 1u);
+            std::vector<float> snapshot = ballSnapshot(balls, count);
+            std::vector<BoundingBox> boxes(count);
+            ballBoundingBoxes(&snapshot[0], count, &boxes[0]);
+            std::vector<uint32_t> objects(count);
+            for (size_t i = 0; i < count; ++i)
+                objects[i] = static_cast<uint32_t>(i);
+            std::vector<unsigned char> visible(count);
+            measure("occlusion_test", count, [&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i)
+                {
+                    std::fill(visible.begin(), visible.end(), 1);
+                    sink = sink + occlusion.cull(jobs, &boxes[0], &objects[0], count, &visible[0]);
+                }
+            });
+        }
+    }
+
+    // fireflies as point lights, seen from the default camera; the grid holds
+    // at most LightClusterGrid::MAX_LIGHTS
+    void benchLightClusters(JobSystem& jobs)
+    {
+        if (!selected("light_clusters"))
+            return;
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 960.0f, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.3f, 3.3f), glm::vec3(0.0f, 0.3f, 2.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+        std::vector<size_t> list = sizes(LightClusterGrid::MAX_LIGHTS);
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            size_t count = list[s];
+            FireflyStore fireflies;
+            generateFireflies(fireflies, count, roomFireflyBounds(roomCenter), 1u);
+            std::vector<PointLight> lights(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                lights[i].position = glm::vec3(fireflies.x[i], fireflies.y[i], fireflies.z[i]);
+                lights[i].radius = 0.3f;
+                lights[i].color = glm::vec3(0.49f, 0.29f, 0.049f);
+            }
+            LightClusterGrid grid;
+            measure("light_clusters", count, [&](long long iterations) {
+                for (long long i = 0; i < iterations; ++i)
+                    grid.build(jobs, view, projection, 0.1f, 100.0f, &lights[0], count);
+                sink = sink + grid.indexCount();
+            });
+        }
+    }
+
+    void benchSceneFile()
+    {
+        if (!selected("scene_parse") && !selected("scene_open"))
+            return;
+        std::vector<size_t> list = sizes(1000000);
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            size_t count = list[s];
+            // one room and count entities spread over the other kinds
+            std::string textPath = "scene_bench_" + std::to_string(count) + ".scene";
+            std::string compiledPath = compiledScenePath(textPath);
+            FILE* file = std::fopen(textPath.c_str(), "w");
+            if (!file)
+            {
+                std::fprintf(stderr, "cannot write %s\n", textPath.c_str());
+                return;
+            }
+            std::fprintf(file, "room center 0 0.3 2 scale 2\n");
+            for (size_t e = 0; e < count; ++e)
+            {
+                float x = static_cast<float>(e % 100) * 0.01f;
+                switch (e % 4)
+                {
+                case 0: std::fprintf(file, "board position %g 0.3 1.51 size 1 0.6 0.05\n    texture board_%zu.jpg\n", x, e); break;
+                case 1: std::fprintf(file, "light position %g 0.75 1.65 color 1 0.9 0.8\n", x); break;
+                case 2: std::fprintf(file, "fireflies room 0 count %zu seed %zu\n", e % 1000, e); break;
+                default: std::fprintf(file, "balls room 0 count 16 seed %zu tint 1 %g 1\n", e, x); break;
+                }
+            }
+            std::fclose(file);
+            if (!compileSceneFile(textPath.c_str(), compiledPath.c_str()))
+                return;
+
+            if (selected("scene_parse"))
+                measure("scene_parse", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                    {
+                        SceneDescription scene;
+                        std::string error;
+                        parseScene(textPath.c_str(), scene, error);
+                        sink = sink + scene.lights.size();
+                    }
+                });
+            // what a start with a current compiled file costs, up to reading the first and last record
+            if (selected("scene_open"))
+                measure("scene_open", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                    {
+                        CompiledScene scene;
+                        scene.open(compiledPath.c_str());
+                        sink = sink + scene.lights()[0].color[1] + scene.ballSets()[scene.ballSetCount() - 1].tint[1];
+                    }
+                });
+            std::remove(textPath.c_str());
+            std::remove(compiledPath.c_str());
+        }
+    }
+
+    void benchImGui()
+    {
+        if (!selected("imdrawlist") && !selected("font_atlas"))
+            return;
+
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO();
+        io.IniFilename = NULL;
+        io.DisplaySize = ImVec2(1280.0f, 960.0f);
+        io.DeltaTime = 1.0f / 60.0f;
+        // lists past 64K vertices are split into draw commands with a vertex offset
+        io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+        unsigned char* pixels;
+        int width, height;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+        ImGui::NewFrame();
+
+        if (selected("imdrawlist"))
+        {
+            ImDrawList list(ImGui::GetDrawListSharedData());
+            ImFont* font = ImGui::GetFont();
+            std::vector<size_t> sizesList = sizes(100000);
+            for (size_t s = 0; s < sizesList.size(); ++s)
+            {
+                size_t count = sizesList[s];
+                // the mix of a busy UI: filled rects, lines, circles and short labels
+                measure("imdrawlist_primitives", count, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                    {
+                        list._ResetForNewFrame();
+                        list.PushClipRectFullScreen();
+                        list.PushTextureID(io.Fonts->TexID);
+                        for (size_t p = 0; p < count; ++p)
+                        {
+                            float x = static_cast<float>(p % 1000);
+                            float y = static_cast<float>(p / 1000 % 900);
+                            switch (p & 3)
+                            {
+                            case 0: list.AddRectFilled(ImVec2(x, y), ImVec2(x + 8.0f, y + 6.0f), IM_COL32(200, 80, 40, 255)); break;
+                            case 1: list.AddLine(ImVec2(x, y), ImVec2(x + 20.0f, y + 5.0f), IM_COL32(255, 255, 255, 255), 1.5f); break;
+                            case 2: list.AddCircleFilled(ImVec2(x, y), 4.0f, IM_COL32(40, 200, 80, 255), 12); break;
+                            default: list.AddText(font, 13.0f, ImVec2(x, y), IM_COL32(255, 255, 0, 255), "fps"); break;
+                            }
+                        }
+                        sink = sink + list.VtxBuffer.Size;
+                    }
+                });
+            }
+        }
+        ImGui::EndFrame();
+
+        if (selected("font_atlas"))
+        {
+            const size_t fontCounts[3] = { 1, 4, 16 };
+            for (int f = 0; f < 3; ++f)
+            {
+                size_t fonts = fontCounts[f];
+                // the default font at several sizes, as a UI with scaled headings would load it
+                measure("font_atlas_build", fonts, [&](long long iterations) {
+                    for (long long i = 0; i < iterations; ++i)
+                    {
+                        ImFontAtlas atlas;
+                        for (size_t n = 0; n < fonts; ++n)
+                        {
+                            ImFontConfig config;
+                            config.SizePixels = 13.0f + 2.0f * n;
+                            atlas.AddFontDefault(&config);
+                        }
+                        unsigned char* atlasPixels;
+                        int atlasWidth, atlasHeight;
+                        atlas.GetTexDataAsRGBA32(&atlasPixels, &atlasWidth, &atlasHeight);
+                        sink = sink + atlasPixels[0];
+                    }
+                });
+            }
+        }
+        ImGui::DestroyContext();
+    }
+
+    const char* compilerName()
+    {
+#if defined(_MSC_VER)
+        return "msvc";
+#elif defined(__VERSION__)
+        return __VERSION__;
+#else
+        return "unknown";
+#endif
+    }
+
+    bool writeJson(const std::string& path, unsigned int workers)
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file)
+            return false;
+        std::fprintf(file, "{\n  \"suite\": \"scene_bench\",\n");
+        std::fprintf(file, "  \"context\": { \"compiler\": \"%s\", \"workers\": %u, \"firefly_kernel\": \"%s\", \"min_time\": %g, "
+                           "\"samples\": %d },\n",
+                     compilerName(), workers, fireflyKernelName(fireflyBestKernel()), settings.minTime, settings.samples);
+        std::fprintf(file, "  \"benchmarks\": [\n");
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            std::fprintf(file, "    { \"name\": \"%s\", \"size\": %zu, \"iterations\": %lld, \"min_ns\": %.1f, \"median_ns\": %.1f, "
+                               "\"mean_ns\": %.1f, \"ns_per_item\": %.4f }%s\n",
+                         r.name.c_str(), r.size, r.iterations, r.minNs, r.medianNs, r.meanNs, r.medianNs / r.size,
+                         i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(file, "  ]\n}\n");
+        return std::fclose(file) == 0;
+    }
+
+    // reads back the benchmarks of a file written by writeJson(), one per line
+    bool readJson(const char* path, std::vector<Result>& list)
+    {
+        FILE* file = std::fopen(path, "r");
+        if (!file)
+            return false;
+        char line[1024];
+        while (std::fgets(line, sizeof(line), file))
+        {
+            const char* name = std::strstr(line, "\"name\": \"");
+            const char* size = std::strstr(line, "\"size\": ");
+            const char* median = std::strstr(line, "\"median_ns\": ");
+            if (!name || !size || !median)
+                continue;
+            name += 9;
+            const char* end = std::strchr(name, '"');
+            if (!end)
+                continue;
+            Result result;
+            result.name.assign(name, end);
+            result.size = static_cast<size_t>(std::strtoull(size + 8, NULL, 10));
+            result.medianNs = std::strtod(median + 13, NULL);
+            list.push_back(result);
+        }
+        std::fclose(file);
+        return true;
+    }
+
+    int compare(const char* basePath, const char* newPath, double threshold)
+    {
+        std::vector<Result> base, current;
+        if (!readJson(basePath, base) || !readJson(newPath, current))
+        {
+            std::fprintf(stderr, "cannot read %s or %s\n", basePath, newPath);
+            return 2;
+        }
+        int regressions = 0;
+        std::printf("%-28s %8s %14s %14s %8s\n", "benchmark", "size", "base", "new", "change");
+        for (size_t i = 0; i < current.size(); ++i)
+        {
+            const Result* old = NULL;
+            for (size_t j = 0; j < base.size() && !old; ++j)
+                if (base[j].name == current[i].name && base[j].size == current[i].size)
+                    old = &base[j];
+            if (!old)
+            {
+                std::printf("%-28s %8zu %14s %11.1f ns      new\n", current[i].name.c_str(), current[i].size, "-", current[i].medianNs);
+                continue;
+            }
+            double change = current[i].medianNs / old->medianNs - 1.0;
+            bool slower = change > threshold;
+            regressions += slower;
+            std::printf("%-28s %8zu %11.1f ns %11.1f ns %+7.1f%%%s\n", current[i].name.c_str(), current[i].size, old->medianNs,
+                        current[i].medianNs, change * 100.0, slower ? "  SLOWER" : (change < -threshold ? "  faster" : ""));
+        }
+        std::printf("%d regression(s) beyond %.0f%%\n", regressions, threshold * 100.0);
+        return regressions > 0 ? 1 : 0;
+    }
+
+    void usage(const char* program)
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--filter TEXT] [--max-size N] [--min-time SECONDS] [--samples N] [--json FILE]\n"
+                     "       %s --compare BASE.json NEW.json [--threshold FRACTION]\n",
+                     program, program);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* compareBase = NULL;
+    const char* compareNew = NULL;
+    double threshold = 0.10;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--filter" && hasValue)
+            settings.filter = argv[++i];
+        else if (option == "--max-size" && hasValue)
+            settings.maxSize = static_cast<size_t>(std::strtoull(argv[++i], NULL, 10));
+        else if (option == "--min-time" && hasValue)
+            settings.minTime = std::atof(argv[++i]);
+        else if (option == "--samples" && hasValue)
+            settings.samples = std::max(1, std::atoi(argv[++i]));
+        else if (option == "--json" && hasValue)
+            settings.jsonPath = argv[++i];
+        else if (option == "--threshold" && hasValue)
+            threshold = std::atof(argv[++i]);
+        else if (option == "--compare" && i + 2 < argc)
+        {
+            compareBase = argv[++i];
+            compareNew = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (compareBase)
+        return compare(compareBase, compareNew, threshold);
+
+    JobSystem jobs;
+    std::printf("workers: %u, firefly kernel: %s, min time %.3f s, %d samples\n", jobs.workerCount(),
+                fireflyKernelName(fireflyBestKernel()), settings.minTime, settings.samples);
+    std::printf("%-28s %8s %15s %15s %18s %13s\n", "benchmark", "size", "median", "min", "per item", "iterations");
+    benchGeometry();
+    benchSimulation(jobs);
+    benchCamera();
+    benchCulling();
+    benchOcclusion(jobs);
+    benchLightClusters(jobs);
+    benchSceneFile();
+    benchImGui();
+
+    if (!settings.jsonPath.empty() && !writeJson(settings.jsonPath, jobs.workerCount()))
+    {
+        std::fprintf(stderr, "cannot write %s\n", settings.jsonPath.c_str());
+        return 1;
+    }
+    return 0;
+}
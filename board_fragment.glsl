@@ -7,29 +7,32 @@ in vec2 TexCoord;
 
 uniform sampler2D texture1; // ڰ
 uniform sampler2D texture2; // ߿
-uniform vec3 lightColor;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
 uniform bool useTexture1; // ı־
 
 void main()
 {
     // Ambient
     float ambientStrength = 0.1;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * lightColor.rgb;
     
     // Diffuse 
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 lightDir = normalize(lightPos.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.rgb;
     
     // Specular
     float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;  
+    vec3 specular = specularStrength * spec * lightColor.rgb;  
+
+    // Point lights
+    vec3 clusterDiffuse = vec3(0.0), clusterSpecular = vec3(0.0);
+    addClusterLights(FragPos, norm, viewDir, clusterDiffuse, clusterSpecular);
+    diffuse += clusterDiffuse;
+    specular += specularStrength * clusterSpecular;
     
     // ʹòͬ
     vec3 result;
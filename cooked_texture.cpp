@@ -0,0 +1,166 @@
+#include "cooked_texture.h"
+
+#include "stb_image.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    uint64_t alignUp(uint64_t value)
+    {
+        return (value + 15) & ~static_cast<uint64_t>(15);
+    }
+
+    // halves source (clamping odd edges) with a rounded 2x2 average
+    void downsample(const unsigned char* source, int width, int height, int channels,
+                    unsigned char* target, int targetWidth, int targetHeight)
+    {
+        for (int y = 0; y < targetHeight; ++y)
+        {
+            int y0 = y * 2;
+            int y1 = y0 + 1 < height ? y0 + 1 : y0;
+            for (int x = 0; x < targetWidth; ++x)
+            {
+                int x0 = x * 2;
+                int x1 = x0 + 1 < width ? x0 + 1 : x0;
+                for (int c = 0; c < channels; ++c)
+                {
+                    int sum = source[(y0 * width + x0) * channels + c] + source[(y0 * width + x1) * channels + c] +
+                              source[(y1 * width + x0) * channels + c] + source[(y1 * width + x1) * channels + c];
+                    target[(y * targetWidth + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+std::string cookedTexturePath(const std::string& sourcePath)
+{
+    std::string::size_type dot = sourcePath.find_last_of('.');
+    std::string::size_type slash = sourcePath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return sourcePath + ".ctex";
+    return sourcePath.substr(0, dot) + ".ctex";
+}
+
+bool cookTexture(const char* sourcePath, const char* cookedPath, bool flipVertically)
+{
+    CookedTextureHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = COOKED_TEXTURE_MAGIC;
+    header.version = COOKED_TEXTURE_VERSION;
+    header.flipped = flipVertically ? 1 : 0;
+    SourceStamp stamp;
+    if (!stampSource(sourcePath, stamp))
+    {
+        std::cout << "COOK::CANNOT_READ " << sourcePath << std::endl;
+        return false;
+    }
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    unsigned char* pixels = stbi_load(sourcePath, &width, &height, &channels, 0);
+    if (!pixels)
+    {
+        std::cout << "COOK::DECODE_FAILED " << sourcePath << ": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    header.format = static_cast<uint32_t>(channels);
+
+    // mip chain down to 1x1, each level made from the one before
+    std::vector<std::vector<unsigned char> > levels(1);
+    levels[0].assign(pixels, pixels + static_cast<size_t>(width) * height * channels);
+    stbi_image_free(pixels);
+    int levelWidth = width, levelHeight = height;
+    uint64_t offset = alignUp(sizeof(CookedTextureHeader));
+    for (unsigned int level = 0; ; ++level)
+    {
+        header.levels[level].offset = offset;
+        header.levels[level].size = levels[level].size();
+        header.levels[level].width = static_cast<uint32_t>(levelWidth);
+        header.levels[level].height = static_cast<uint32_t>(levelHeight);
+        header.levelCount = level + 1;
+        offset = alignUp(offset + levels[level].size());
+        if ((levelWidth == 1 && levelHeight == 1) || level + 1 == COOKED_TEXTURE_MAX_LEVELS)
+            break;
+
+        int nextWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+        int nextHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+        levels.push_back(std::vector<unsigned char>(static_cast<size_t>(nextWidth) * nextHeight * channels));
+        downsample(&levels[level][0], levelWidth, levelHeight, channels, &levels[level + 1][0], nextWidth, nextHeight);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    std::ofstream file(cookedPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[16] = { 0 };
+    uint64_t written = sizeof(header);
+    for (unsigned int level = 0; level < header.levelCount; ++level)
+    {
+        file.write(padding, static_cast<std::streamsize>(header.levels[level].offset - written));
+        file.write(reinterpret_cast<const char*>(&levels[level][0]), static_cast<std::streamsize>(levels[level].size()));
+        written = header.levels[level].offset + levels[level].size();
+    }
+    if (!file)
+    {
+        std::cout << "COOK::WRITE_FAILED " << cookedPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CookedTexture::CookedTexture()
+{
+}
+
+CookedTexture::~CookedTexture()
+{
+    close();
+}
+
+bool CookedTexture::open(const char* path)
+{
+    close();
+    if (!file.open(path, sizeof(CookedTextureHeader)))
+        return false;
+
+    const CookedTextureHeader& h = header();
+    size_t size = file.size();
+    bool valid = h.magic == COOKED_TEXTURE_MAGIC && h.version == COOKED_TEXTURE_VERSION &&
+                 h.format >= COOKED_R8 && h.format <= COOKED_RGBA8 &&
+                 h.levelCount >= 1 && h.levelCount <= COOKED_TEXTURE_MAX_LEVELS;
+    for (unsigned int i = 0; valid && i < h.levelCount; ++i)
+    {
+        const CookedTextureLevel& level = h.levels[i];
+        valid = level.offset <= size && level.size <= size - level.offset &&
+                level.size == static_cast<uint64_t>(level.width) * level.height * h.format;
+    }
+    if (!valid)
+    {
+        std::cout << "COOKED_TEXTURE::INVALID " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CookedTexture::close()
+{
+    file.close();
+}
+
+bool CookedTexture::isCurrent(const char* sourcePath, bool flipVertically) const
+{
+    const CookedTextureHeader& h = header();
+    if ((h.flipped != 0) != flipVertically)
+        return false;
+    SourceStamp stamp = { h.sourceSize, h.sourceTime, h.sourceHash };
+    return isSourceCurrent(sourcePath, stamp);
+}
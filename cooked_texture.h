@@ -0,0 +1,83 @@
+#pragma once
+#ifndef COOKED_TEXTURE_H
+#define COOKED_TEXTURE_H
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+// Precooked texture file (.ctex): a fixed-size header followed by every mip
+// level, largest first, as tightly packed 8-bit rows. Loading one is a file
+// mapping plus one glTexImage2D per level; no decode and no mipmap generation.
+// The header records the size, modification time and hash of the image it was
+// cooked from, so a loader can tell when the source has changed since.
+
+enum { COOKED_TEXTURE_MAGIC = 0x58455443 }; // "CTEX"
+enum { COOKED_TEXTURE_VERSION = 1 };
+enum { COOKED_TEXTURE_MAX_LEVELS = 16 };
+
+// the value is also the number of channels
+enum CookedTextureFormat
+{
+    COOKED_R8 = 1,
+    COOKED_RG8 = 2,
+    COOKED_RGB8 = 3,
+    COOKED_RGBA8 = 4
+};
+
+struct CookedTextureLevel
+{
+    uint64_t offset; // from the start of the file, 16-byte aligned
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct CookedTextureHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t levelCount;
+    uint32_t flipped; // rows stored bottom-up, as stbi with vertical flip
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash; // FNV-1a of the source file
+    CookedTextureLevel levels[COOKED_TEXTURE_MAX_LEVELS];
+};
+
+// "textures/board.jpg" -> "textures/board.ctex"
+std::string cookedTexturePath(const std::string& sourcePath);
+
+// decodes sourcePath, builds the full mip chain with a 2x2 box filter and
+// writes it to cookedPath; returns false (and prints why) on failure
+bool cookTexture(const char* sourcePath, const char* cookedPath, bool flipVertically);
+
+// Read-only mapping of a cooked file.
+class CookedTexture
+{
+public:
+    CookedTexture();
+    ~CookedTexture();
+
+    // maps path and checks the header and level table against the file size
+    bool open(const char* path);
+    void close();
+
+    // true if the file was cooked with flipVertically from sourcePath as it is
+    // now (see isSourceCurrent())
+    bool isCurrent(const char* sourcePath, bool flipVertically) const;
+
+    const CookedTextureHeader& header() const { return *reinterpret_cast<const CookedTextureHeader*>(file.data()); }
+    const unsigned char* level(unsigned int index) const { return file.data() + header().levels[index].offset; }
+
+private:
+    MappedFile file;
+
+    CookedTexture(const CookedTexture&);
+    CookedTexture& operator=(const CookedTexture&);
+};
+#endif
@@ -0,0 +1,365 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CULLING_X86 1
+#include <emmintrin.h>
+#endif
+
+const float BoundingVolumeHierarchy::REBUILD_RATIO = 1.5f;
+
+// bounding boxes
+// ------------------------------------------------------------------------
+BoundingBox emptyBounds()
+{
+    BoundingBox box;
+    box.min = glm::vec3(FLT_MAX);
+    box.max = glm::vec3(-FLT_MAX);
+    return box;
+}
+
+BoundingBox mergeBounds(const BoundingBox& a, const BoundingBox& b)
+{
+    BoundingBox box;
+    box.min = glm::min(a.min, b.min);
+    box.max = glm::max(a.max, b.max);
+    return box;
+}
+
+BoundingBox sphereBounds(const glm::vec3& center, float radius)
+{
+    BoundingBox box;
+    box.min = center - glm::vec3(radius);
+    box.max = center + glm::vec3(radius);
+    return box;
+}
+
+BoundingBox vertexBounds(const float* vertices, size_t count, size_t stride)
+{
+    BoundingBox box = emptyBounds();
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 position(vertices[i * stride], vertices[i * stride + 1], vertices[i * stride + 2]);
+        box.min = glm::min(box.min, position);
+        box.max = glm::max(box.max, position);
+    }
+    return box;
+}
+
+BoundingBox transformBounds(const glm::mat4& transform, const BoundingBox& box)
+{
+    // centre and half extents; each output extent is the sum of the absolute
+    // contributions of the input axes
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+    glm::vec3 newExtent(0.0f);
+    for (int axis = 0; axis < 3; ++axis)
+        newExtent += glm::abs(glm::vec3(transform[axis])) * extent[axis];
+    BoundingBox result;
+    result.min = newCenter - newExtent;
+    result.max = newCenter + newExtent;
+    return result;
+}
+
+float surfaceArea(const BoundingBox& box)
+{
+    glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// Frustum
+// ------------------------------------------------------------------------
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+    // Gribb and Hartmann: every plane is the last row of the matrix plus or
+    // minus one of the others (glm stores columns, so row i is m[0][i], m[1][i], ...)
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        int row = plane / 2;
+        float sign = (plane % 2 == 0) ? 1.0f : -1.0f;
+        glm::vec4 p;
+        for (int column = 0; column < 4; ++column)
+            p[column] = viewProjection[column][3] + sign * viewProjection[column][row];
+        float length = glm::length(glm::vec3(p));
+        if (length > 0.0f)
+            p /= length;
+        a[plane] = p.x;
+        b[plane] = p.y;
+        c[plane] = p.z;
+        d[plane] = p.w;
+    }
+    for (int plane = 6; plane < 8; ++plane)
+    {
+        a[plane] = b[plane] = c[plane] = 0.0f;
+        d[plane] = 1.0f;
+    }
+}
+
+Frustum::Result Frustum::test(const BoundingBox& box, unsigned int& planeMask) const
+{
+    if (planeMask == 0)
+        return INSIDE;
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+
+    // a box is outside a plane when even its corner furthest along the normal
+    // is behind it, and inside when its nearest corner is in front
+    unsigned int outside = 0;
+    unsigned int inside = 0;
+#ifdef CULLING_X86
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    for (int group = 0; group < 2; ++group)
+    {
+        __m128 pa = _mm_loadu_ps(a + 4 * group);
+        __m128 pb = _mm_loadu_ps(b + 4 * group);
+        __m128 pc = _mm_loadu_ps(c + 4 * group);
+        __m128 pd = _mm_loadu_ps(d + 4 * group);
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pa, cx), _mm_mul_ps(pb, cy)), _mm_add_ps(_mm_mul_ps(pc, cz), pd));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, pa), ex), _mm_mul_ps(_mm_andnot_ps(signMask, pb), ey)),
+                                   _mm_mul_ps(_mm_andnot_ps(signMask, pc), ez));
+        outside |= static_cast<unsigned int>(_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero))) << (4 * group);
+        inside |= static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(distance, radius), zero))) << (4 * group);
+    }
+#else
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        float distance = a[plane] * center.x + b[plane] * center.y + c[plane] * center.z + d[plane];
+        float radius = std::fabs(a[plane]) * extent.x + std::fabs(b[plane]) * extent.y + std::fabs(c[plane]) * extent.z;
+        if (distance + radius < 0.0f)
+            outside |= 1u << plane;
+        if (distance - radius >= 0.0f)
+            inside |= 1u << plane;
+    }
+#endif
+    if (outside & planeMask)
+        return OUTSIDE;
+    planeMask &= ~inside;
+    return planeMask ? INTERSECTS : INSIDE;
+}
+
+// BoundingVolumeHierarchy
+// ------------------------------------------------------------------------
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+    : builtCost(0.0f), builds(0)
+{
+}
+
+void BoundingVolumeHierarchy::build(const BoundingBox* newBoxes, size_t count)
+{
+    boxes.assign(newBoxes, newBoxes + count);
+    centroids.resize(count);
+    items.resize(count);
+    nodes.clear();
+    ++builds;
+    if (count == 0)
+    {
+        builtCost = 0.0f;
+        return;
+    }
+
+    BoundingBox bounds = emptyBounds();
+    for (size_t i = 0; i < count; ++i)
+    {
+        centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+        items[i] = static_cast<uint32_t>(i);
+        bounds = mergeBounds(bounds, boxes[i]);
+    }
+    nodes.reserve(2 * count / MAX_LEAF_SIZE + 1);
+    Node root;
+    root.bounds = bounds;
+    root.left = 0;
+    root.first = 0;
+    root.count = static_cast<uint32_t>(count);
+    nodes.push_back(root);
+    split(0);
+    builtCost = cost();
+}
+
+void BoundingVolumeHierarchy::split(uint32_t index)
+{
+    uint32_t first = nodes[index].first;
+    uint32_t count = nodes[index].count;
+    if (count <= MAX_LEAF_SIZE)
+        return;
+
+    BoundingBox centroidBounds = emptyBounds();
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        centroidBounds.min = glm::min(centroidBounds.min, centroids[items[i]]);
+        centroidBounds.max = glm::max(centroidBounds.max, centroids[items[i]]);
+    }
+    glm::vec3 size = centroidBounds.max - centroidBounds.min;
+    int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    if (size[axis] <= 0.0f)
+        return; // every centroid in one place: no split separates them
+
+    // bin the centroids along the longest axis, then sweep the bins from both
+    // sides for the split with the lowest area-weighted count
+    BoundingBox binBounds[SAH_BINS];
+    uint32_t binCounts[SAH_BINS];
+    for (int bin = 0; bin < SAH_BINS; ++bin)
+    {
+        binBounds[bin] = emptyBounds();
+        binCounts[bin] = 0;
+    }
+    float origin = centroidBounds.min[axis];
+    float binScale = SAH_BINS / size[axis];
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        int bin = std::min(static_cast<int>((centroids[items[i]][axis] - origin) * binScale), SAH_BINS - 1);
+        binBounds[bin] = mergeBounds(binBounds[bin], boxes[items[i]]);
+        ++binCounts[bin];
+    }
+
+    float rightCost[SAH_BINS];
+    BoundingBox rightBounds = emptyBounds();
+    uint32_t rightCount = 0;
+    for (int bin = SAH_BINS - 1; bin > 0; --bin)
+    {
+        rightBounds = mergeBounds(rightBounds, binBounds[bin]);
+        rightCount += binCounts[bin];
+        rightCost[bin] = rightCount * surfaceArea(rightBounds);
+    }
+    int bestBin = 1;
+    float bestCost = FLT_MAX;
+    BoundingBox leftBounds = emptyBounds();
+    uint32_t leftCount = 0;
+    for (int bin = 1; bin < SAH_BINS; ++bin)
+    {
+        leftBounds = mergeBounds(leftBounds, binBounds[bin - 1]);
+        leftCount += binCounts[bin - 1];
+        float splitCost = leftCount * surfaceArea(leftBounds) + rightCost[bin];
+        if (leftCount > 0 && leftCount < count && splitCost < bestCost)
+        {
+            bestCost = splitCost;
+            bestBin = bin;
+        }
+    }
+
+    // the first and last bins both hold a centroid, so neither side is empty
+    const std::vector<glm::vec3>& centers = centroids;
+    uint32_t* middle = std::partition(&items[first], &items[first] + count, [&](uint32_t item) {
+        return std::min(static_cast<int>((centers[item][axis] - origin) * binScale), SAH_BINS - 1) < bestBin;
+    });
+    Node left, right;
+    left.bounds = emptyBounds();
+    right.bounds = emptyBounds();
+    for (int bin = 0; bin < SAH_BINS; ++bin)
+    {
+        BoundingBox& side = bin < bestBin ? left.bounds : right.bounds;
+        side = mergeBounds(side, binBounds[bin]);
+    }
+    left.left = right.left = 0;
+    left.first = first;
+    left.count = static_cast<uint32_t>(middle - &items[first]);
+    right.first = left.first + left.count;
+    right.count = count - left.count;
+
+    uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+    nodes[index].left = leftIndex;
+    nodes.push_back(left);
+    nodes.push_back(right);
+    split(leftIndex);
+    split(leftIndex + 1);
+}
+
+void BoundingVolumeHierarchy::refit(const BoundingBox* newBoxes)
+{
+    std::copy(newBoxes, newBoxes + boxes.size(), boxes.begin());
+    // children always come after their parent, so one backwards pass sees
+    // every child before the node that holds it
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        Node& node = nodes[i];
+        if (node.left)
+        {
+            node.bounds = mergeBounds(nodes[node.left].bounds, nodes[node.left + 1].bounds);
+            continue;
+        }
+        BoundingBox bounds = emptyBounds();
+        for (uint32_t item = node.first; item < node.first + node.count; ++item)
+            bounds = mergeBounds(bounds, boxes[items[item]]);
+        node.bounds = bounds;
+    }
+}
+
+bool BoundingVolumeHierarchy::update(const BoundingBox* newBoxes, size_t count)
+{
+    if (count != boxes.size() || builds == 0)
+    {
+        build(newBoxes, count);
+        return true;
+    }
+    refit(newBoxes);
+    if (cost() > builtCost * REBUILD_RATIO)
+    {
+        build(newBoxes, count);
+        return true;
+    }
+    return false;
+}
+
+float BoundingVolumeHierarchy::cost() const
+{
+    if (nodes.empty())
+        return 0.0f;
+    float rootArea = surfaceArea(nodes[0].bounds);
+    if (rootArea <= 0.0f)
+        return static_cast<float>(boxes.size());
+    // a visit to a node costs one test, a leaf one more per box; each node is
+    // visited with a probability proportional to its surface area
+    float total = 0.0f;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        total += surfaceArea(nodes[i].bounds) * (nodes[i].left ? 1.0f : 1.0f + nodes[i].count);
+    return total / rootArea;
+}
+
+void BoundingVolumeHierarchy::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    if (nodes.empty())
+        return;
+    struct Entry
+    {
+        uint32_t node;
+        unsigned int planeMask;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    Entry root = { 0, Frustum::ALL_PLANES };
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[entry.node];
+        Frustum::Result result = frustum.test(node.bounds, entry.planeMask);
+        if (result == Frustum::OUTSIDE)
+            continue;
+        if (result == Frustum::INSIDE)
+        {
+            visible.insert(visible.end(), items.begin() + node.first, items.begin() + node.first + node.count);
+            continue;
+        }
+        if (node.left)
+        {
+            Entry right = { node.left + 1, entry.planeMask };
+            Entry left = { node.left, entry.planeMask };
+            stack.push_back(right);
+            stack.push_back(left);
+            continue;
+        }
+        for (uint32_t item = node.first; item < node.first + node.count; ++item)
+        {
+            unsigned int planeMask = entry.planeMask;
+            if (frustum.test(boxes[items[item]], planeMask) != Frustum::OUTSIDE)
+                visible.push_back(items[item]);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+// Frustum culling: world space bounding boxes of the renderables, the view
+// frustum as six planes, and a bounding volume hierarchy over the boxes that
+// yields the visible ones. Needs no GL context.
+
+struct BoundingBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+BoundingBox emptyBounds();
+BoundingBox mergeBounds(const BoundingBox& a, const BoundingBox& b);
+BoundingBox sphereBounds(const glm::vec3& center, float radius);
+// bounds of the first three floats of count vertices that are stride floats apart
+BoundingBox vertexBounds(const float* vertices, size_t count, size_t stride);
+// bounds of box after transform
+BoundingBox transformBounds(const glm::mat4& transform, const BoundingBox& box);
+float surfaceArea(const BoundingBox& box);
+
+// The six planes of a view frustum, taken from projection * view. Boxes are
+// tested against four planes at a time with SSE where available.
+class Frustum
+{
+public:
+    enum Result { OUTSIDE, INTERSECTS, INSIDE };
+    enum { ALL_PLANES = 0x3F };
+
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // Tests box against the planes in planeMask and clears the bits of the
+    // planes box is entirely in front of: boxes inside such a box need not be
+    // tested against them again. INSIDE once no plane is left.
+    Result test(const BoundingBox& box, unsigned int& planeMask) const;
+
+private:
+    // planes as a * x + b * y + c * z + d >= 0 inside, structure of arrays;
+    // the last two are padding that every box is inside of
+    float a[8], b[8], c[8], d[8];
+};
+
+// Bounding volume hierarchy over a set of boxes, built with a binned surface
+// area heuristic. Moving boxes are handled by refitting: the tree keeps its
+// shape and only the node bounds grow or shrink, which is linear in the
+// number of boxes. Refitting lets the tree get worse as boxes move apart from
+// the ones they were grouped with, so update() rebuilds it once its SAH cost
+// has grown by REBUILD_RATIO since the last build.
+class BoundingVolumeHierarchy
+{
+public:
+    enum { MAX_LEAF_SIZE = 4, SAH_BINS = 16 };
+    static const float REBUILD_RATIO;
+
+    BoundingVolumeHierarchy();
+
+    void build(const BoundingBox* boxes, size_t count);
+    // new bounds for the boxes of the last build, in the same order
+    void refit(const BoundingBox* boxes);
+    // refits, or builds when the count changed or the tree has degraded;
+    // returns true if it built
+    bool update(const BoundingBox* boxes, size_t count);
+
+    // appends the indices of the boxes that are at least partly inside the frustum
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    size_t size() const { return boxes.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t buildCount() const { return builds; }
+    // expected cost of a traversal relative to testing the root alone
+    float cost() const;
+
+private:
+    // Every node covers a contiguous range of items, so a node entirely inside
+    // the frustum yields its boxes without visiting its children.
+    struct Node
+    {
+        BoundingBox bounds;
+        uint32_t left;    // first child, the second follows it; 0 for a leaf
+        uint32_t first;   // range in items
+        uint32_t count;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items;     // box indices
+    std::vector<BoundingBox> boxes;
+    std::vector<glm::vec3> centroids; // only used while building
+    float builtCost;
+    size_t builds;
+
+    void split(uint32_t node);
+};
+#endif
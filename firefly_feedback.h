@@ -0,0 +1,172 @@
+#pragma once
+#ifndef FIREFLY_FEEDBACK_H
+#define FIREFLY_FEEDBACK_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "shader.h"
+#include "firefly_sim.h"
+
+#include <cstddef>
+#include <vector>
+
+// GPU-resident firefly simulation. The state of every firefly lives in one of
+// two ping-pong vertex buffers and is advanced by firefly_update_vertex.glsl
+// with transform feedback, so each frame the CPU only sets deltaTime and the
+// bounds. The motion is the same as updateFireflies() on the CPU; every firefly
+// carries its own random state, seeded when the store is generated. The buffer
+// not written last still holds the previous step, which the renderer uses to
+// interpolate between steps.
+class FireflyFeedback
+{
+public:
+    // interleaved per-firefly state, in the order of the captured varyings
+    struct State
+    {
+        float x, y, z;
+        float speed;
+        float size;
+        float phase;
+        unsigned int rng;
+    };
+
+    FireflyFeedback(const char* updateShaderPath)
+        : updateShader(updateShaderPath, feedbackVaryings()), fireflyCount(0), current(0)
+    {
+        glGenBuffers(2, stateVBO);
+        glGenVertexArrays(2, updateVAO);
+        glGenVertexArrays(2, renderVAO);
+        for (int i = 0; i < 2; ++i)
+        {
+            GLState::bindBuffer(GL_ARRAY_BUFFER, stateVBO[i]);
+
+            // inputs of the update shader
+            GLState::bindVertexArray(updateVAO[i]);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(State), (void*)offsetof(State, x));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(State), (void*)offsetof(State, speed));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(State), (void*)offsetof(State, size));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(State), (void*)offsetof(State, phase));
+            glEnableVertexAttribArray(3);
+            glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(State), (void*)offsetof(State, rng));
+            glEnableVertexAttribArray(4);
+
+        }
+        for (int i = 0; i < 2; ++i)
+        {
+            // per-vertex inputs of snowflake_vertex.glsl: x, y, z, size and phase
+            // from this buffer, and the previous x, y, z from the other one
+            GLState::bindVertexArray(renderVAO[i]);
+            const size_t offsets[8] = { offsetof(State, x), offsetof(State, y), offsetof(State, z), offsetof(State, size), offsetof(State, phase),
+                                        offsetof(State, x), offsetof(State, y), offsetof(State, z) };
+            for (int attribute = 0; attribute < 8; ++attribute)
+            {
+                GLState::bindBuffer(GL_ARRAY_BUFFER, stateVBO[attribute < 5 ? i : 1 - i]);
+                glVertexAttribPointer(attribute, 1, GL_FLOAT, GL_FALSE, sizeof(State), (void*)offsets[attribute]);
+                glEnableVertexAttribArray(attribute);
+            }
+        }
+        GLState::bindVertexArray(0);
+    }
+
+    // deletes the GL objects; call while the context is still current
+    void release()
+    {
+        glDeleteVertexArrays(2, renderVAO);
+        glDeleteVertexArrays(2, updateVAO);
+        glDeleteBuffers(2, stateVBO);
+        glDeleteProgram(updateShader.ID);
+    }
+
+    // copies the CPU store into the GPU buffers (on start or after regenerating)
+    void upload(const FireflyStore& store)
+    {
+        fireflyCount = store.count();
+        std::vector<State> states(fireflyCount);
+        for (size_t i = 0; i < fireflyCount; ++i)
+        {
+            State& s = states[i];
+            s.x = store.x[i];
+            s.y = store.y[i];
+            s.z = store.z[i];
+            s.speed = store.speed[i];
+            s.size = store.size[i];
+            s.phase = store.phase[i];
+            s.rng = store.rng[i];
+        }
+        for (int i = 0; i < 2; ++i)
+        {
+            GLState::bindBuffer(GL_ARRAY_BUFFER, stateVBO[i]);
+            // both buffers start out equal, so the previous state is valid before the first update
+            glBufferData(GL_ARRAY_BUFFER, fireflyCount * sizeof(State), states.data(), GL_DYNAMIC_COPY);
+        }
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // copies the GPU state back into the CPU store (when switching back to the CPU path)
+    void download(FireflyStore& store) const
+    {
+        if (store.count() != fireflyCount)
+            return;
+        std::vector<State> states(fireflyCount);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, stateVBO[current]);
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, fireflyCount * sizeof(State), states.data());
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+        for (size_t i = 0; i < fireflyCount; ++i)
+        {
+            store.x[i] = states[i].x;
+            store.y[i] = states[i].y;
+            store.z[i] = states[i].z;
+            store.rng[i] = states[i].rng;
+        }
+    }
+
+    // advances every firefly by one step, reading the current buffer and writing the other
+    void update(float deltaTime, const FireflyBounds& bounds)
+    {
+        if (fireflyCount == 0)
+            return;
+        int next = 1 - current;
+        updateShader.use();
+        updateShader.setFloat(UNIFORM("deltaTime"), deltaTime);
+        updateShader.setFloat(UNIFORM("centerX"), bounds.centerX);
+        updateShader.setFloat(UNIFORM("bottomY"), bounds.bottomY);
+
+        GLState::enable(GL_RASTERIZER_DISCARD);
+        GLState::bindVertexArray(updateVAO[current]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, stateVBO[next]);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)fireflyCount);
+        glEndTransformFeedback();
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        GLState::disable(GL_RASTERIZER_DISCARD);
+        current = next;
+    }
+
+    // VAO that feeds the latest and the previous state to snowflake_vertex.glsl as instances
+    unsigned int currentRenderVAO() const { return renderVAO[current]; }
+    size_t count() const { return fireflyCount; }
+
+    // the update program and the varyings it captures, e.g. for reloading it
+    Shader& shader() { return updateShader; }
+    static std::vector<const char*> feedbackVaryings()
+    {
+        const char* names[] = { "outPos", "outSpeed", "outSize", "outPhase", "outRng" };
+        return std::vector<const char*>(names, names + 5);
+    }
+
+private:
+    Shader updateShader;
+    unsigned int stateVBO[2];
+    unsigned int updateVAO[2];
+    unsigned int renderVAO[2];
+    size_t fireflyCount;
+    int current;
+
+    FireflyFeedback(const FireflyFeedback&);
+    FireflyFeedback& operator=(const FireflyFeedback&);
+};
+#endif
@@ -0,0 +1,295 @@
+#include "firefly_sim.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FIREFLY_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef FIREFLY_X86
+#include <xmmintrin.h>
+#define FIREFLY_ALLOC(bytes) _mm_malloc(bytes, 32)
+#define FIREFLY_FREE(ptr) _mm_free(ptr)
+#else
+#include <cstdlib>
+#define FIREFLY_ALLOC(bytes) aligned_alloc(32, bytes)
+#define FIREFLY_FREE(ptr) free(ptr)
+#endif
+
+// GCC and clang only emit AVX2 instructions in functions that ask for them;
+// MSVC accepts the intrinsics anywhere.
+#if defined(FIREFLY_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FIREFLY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FIREFLY_TARGET_AVX2
+#endif
+
+// FireflyStore
+// ------------------------------------------------------------------------
+FireflyStore::FireflyStore()
+    : x(NULL), y(NULL), z(NULL), speed(NULL), size(NULL), phase(NULL), rng(NULL), liveCount(0), paddedCount(0)
+{
+}
+
+FireflyStore::~FireflyStore()
+{
+    release();
+}
+
+void FireflyStore::resize(size_t count)
+{
+    release();
+    liveCount = count;
+    paddedCount = (count + FIREFLY_LANES - 1) / FIREFLY_LANES * FIREFLY_LANES;
+    if (paddedCount == 0)
+        return;
+    size_t bytes = paddedCount * sizeof(float);
+    x = static_cast<float*>(FIREFLY_ALLOC(bytes));
+    y = static_cast<float*>(FIREFLY_ALLOC(bytes));
+    z = static_cast<float*>(FIREFLY_ALLOC(bytes));
+    speed = static_cast<float*>(FIREFLY_ALLOC(bytes));
+    size = static_cast<float*>(FIREFLY_ALLOC(bytes));
+    phase = static_cast<float*>(FIREFLY_ALLOC(bytes));
+    rng = static_cast<unsigned int*>(FIREFLY_ALLOC(paddedCount * sizeof(unsigned int)));
+}
+
+void FireflyStore::release()
+{
+    float* arrays[] = { x, y, z, speed, size, phase };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i)
+    {
+        if (arrays[i])
+            FIREFLY_FREE(arrays[i]);
+    }
+    if (rng)
+        FIREFLY_FREE(rng);
+    x = y = z = speed = size = phase = NULL;
+    rng = NULL;
+    liveCount = paddedCount = 0;
+}
+
+// random numbers
+// ------------------------------------------------------------------------
+static inline unsigned int xorshift32(unsigned int state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// integer hash used to give every firefly an independent, non-zero starting state
+static inline unsigned int hashSeed(unsigned int seed, unsigned int index)
+{
+    unsigned int h = seed ^ (index * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h ? h : 0x6D2B79F5u;
+}
+
+// top 24 bits of a random word as a float in [0, 1)
+static inline float unitFloat(unsigned int r)
+{
+    return static_cast<float>(r >> 8) * (1.0f / 16777216.0f);
+}
+
+void generateFireflies(FireflyStore& store, size_t count, const FireflyBounds& bounds, unsigned int seed)
+{
+    store.resize(count);
+    // padding lanes get valid fireflies too, so kernels can run over the whole capacity
+    for (size_t i = 0; i < store.capacity(); ++i)
+    {
+        unsigned int r = hashSeed(seed, static_cast<unsigned int>(i));
+        r = xorshift32(r); store.x[i] = bounds.centerX + unitFloat(r) - 0.5f;
+        r = xorshift32(r); store.y[i] = bounds.centerY + unitFloat(r) - 0.5f;
+        r = xorshift32(r); store.z[i] = bounds.centerZ + unitFloat(r) - 0.5f;
+        r = xorshift32(r); store.size[i] = static_cast<float>(static_cast<int>(unitFloat(r) * 5.0f) + 1); // 1 to 5
+        r = xorshift32(r); store.speed[i] = unitFloat(r) * 0.1f;
+        r = xorshift32(r); store.phase[i] = unitFloat(r) * 6.2831853f;
+        store.rng[i] = xorshift32(r);
+    }
+}
+
+// kernels
+// ------------------------------------------------------------------------
+// Each step draws one random word per firefly: bit 0 picks up/down, bit 1 picks
+// left/right (horizontal drift is half the vertical speed) and the top 24 bits
+// give the new x when a firefly drops below the bottom and respawns 0.5 higher.
+// All kernels evaluate the same float expressions in the same order, so they
+// produce bit-identical results.
+static void updateScalar(FireflyStore& store, size_t begin, size_t end, float deltaTime, const FireflyBounds& bounds)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        unsigned int r = xorshift32(store.rng[i]);
+        store.rng[i] = r;
+        float step = store.speed[i] * deltaTime;
+        float signY = (r & 1u) ? -1.0f : 1.0f;
+        float signX = (r & 2u) ? -1.0f : 1.0f;
+        float newY = store.y[i] + signY * step;
+        float newX = store.x[i] + signX * (step * 0.5f);
+        bool respawn = newY < bounds.bottomY;
+        store.y[i] = respawn ? newY + 0.5f : newY;
+        store.x[i] = respawn ? (bounds.centerX + unitFloat(r)) - 0.5f : newX;
+    }
+}
+
+#ifdef FIREFLY_X86
+static void updateSSE2(FireflyStore& store, size_t begin, size_t end, float deltaTime, const FireflyBounds& bounds)
+{
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 bottom = _mm_set1_ps(bounds.bottomY);
+    const __m128 centerX = _mm_set1_ps(bounds.centerX);
+    const __m128 toUnit = _mm_set1_ps(1.0f / 16777216.0f);
+    const __m128i one = _mm_castps_si128(_mm_set1_ps(1.0f));
+    for (size_t i = begin; i < end; i += 4)
+    {
+        __m128i r = _mm_load_si128(reinterpret_cast<const __m128i*>(store.rng + i));
+        r = _mm_xor_si128(r, _mm_slli_epi32(r, 13));
+        r = _mm_xor_si128(r, _mm_srli_epi32(r, 17));
+        r = _mm_xor_si128(r, _mm_slli_epi32(r, 5));
+        _mm_store_si128(reinterpret_cast<__m128i*>(store.rng + i), r);
+
+        // move bit 0 / bit 1 into the sign bit of 1.0f to get +-1 without branches
+        __m128 signY = _mm_castsi128_ps(_mm_or_si128(_mm_slli_epi32(r, 31), one));
+        __m128 signX = _mm_castsi128_ps(_mm_or_si128(_mm_slli_epi32(_mm_srli_epi32(r, 1), 31), one));
+        __m128 step = _mm_mul_ps(_mm_load_ps(store.speed + i), dt);
+        __m128 newY = _mm_add_ps(_mm_load_ps(store.y + i), _mm_mul_ps(signY, step));
+        __m128 newX = _mm_add_ps(_mm_load_ps(store.x + i), _mm_mul_ps(signX, _mm_mul_ps(step, half)));
+
+        __m128 respawn = _mm_cmplt_ps(newY, bottom);
+        __m128 spawnX = _mm_sub_ps(_mm_add_ps(centerX, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(r, 8)), toUnit)), half);
+        newY = _mm_or_ps(_mm_and_ps(respawn, _mm_add_ps(newY, half)), _mm_andnot_ps(respawn, newY));
+        newX = _mm_or_ps(_mm_and_ps(respawn, spawnX), _mm_andnot_ps(respawn, newX));
+        _mm_store_ps(store.y + i, newY);
+        _mm_store_ps(store.x + i, newX);
+    }
+}
+
+FIREFLY_TARGET_AVX2
+static void updateAVX2(FireflyStore& store, size_t begin, size_t end, float deltaTime, const FireflyBounds& bounds)
+{
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 bottom = _mm256_set1_ps(bounds.bottomY);
+    const __m256 centerX = _mm256_set1_ps(bounds.centerX);
+    const __m256 toUnit = _mm256_set1_ps(1.0f / 16777216.0f);
+    const __m256i one = _mm256_castps_si256(_mm256_set1_ps(1.0f));
+    for (size_t i = begin; i < end; i += 8)
+    {
+        __m256i r = _mm256_load_si256(reinterpret_cast<const __m256i*>(store.rng + i));
+        r = _mm256_xor_si256(r, _mm256_slli_epi32(r, 13));
+        r = _mm256_xor_si256(r, _mm256_srli_epi32(r, 17));
+        r = _mm256_xor_si256(r, _mm256_slli_epi32(r, 5));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(store.rng + i), r);
+
+        __m256 signY = _mm256_castsi256_ps(_mm256_or_si256(_mm256_slli_epi32(r, 31), one));
+        __m256 signX = _mm256_castsi256_ps(_mm256_or_si256(_mm256_slli_epi32(_mm256_srli_epi32(r, 1), 31), one));
+        __m256 step = _mm256_mul_ps(_mm256_load_ps(store.speed + i), dt);
+        __m256 newY = _mm256_add_ps(_mm256_load_ps(store.y + i), _mm256_mul_ps(signY, step));
+        __m256 newX = _mm256_add_ps(_mm256_load_ps(store.x + i), _mm256_mul_ps(signX, _mm256_mul_ps(step, half)));
+
+        __m256 respawn = _mm256_cmp_ps(newY, bottom, _CMP_LT_OQ);
+        __m256 spawnX = _mm256_sub_ps(_mm256_add_ps(centerX, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(r, 8)), toUnit)), half);
+        _mm256_store_ps(store.y + i, _mm256_blendv_ps(newY, _mm256_add_ps(newY, half), respawn));
+        _mm256_store_ps(store.x + i, _mm256_blendv_ps(newX, spawnX, respawn));
+    }
+}
+#endif
+
+// dispatch
+// ------------------------------------------------------------------------
+#ifdef FIREFLY_X86
+static bool cpuHasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // the OS must save the YMM registers on context switches
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+bool fireflyKernelSupported(FireflyKernel kernel)
+{
+    switch (kernel)
+    {
+    case FIREFLY_KERNEL_SCALAR:
+        return true;
+#ifdef FIREFLY_X86
+    case FIREFLY_KERNEL_SSE2:
+        return true;
+    case FIREFLY_KERNEL_AVX2:
+    {
+        static const bool hasAVX2 = cpuHasAVX2();
+        return hasAVX2;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+FireflyKernel fireflyBestKernel()
+{
+    if (fireflyKernelSupported(FIREFLY_KERNEL_AVX2))
+        return FIREFLY_KERNEL_AVX2;
+    if (fireflyKernelSupported(FIREFLY_KERNEL_SSE2))
+        return FIREFLY_KERNEL_SSE2;
+    return FIREFLY_KERNEL_SCALAR;
+}
+
+const char* fireflyKernelName(FireflyKernel kernel)
+{
+    switch (kernel)
+    {
+    case FIREFLY_KERNEL_SSE2: return "SSE2";
+    case FIREFLY_KERNEL_AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+void updateFireflies(FireflyStore& store, size_t begin, size_t end, float deltaTime, const FireflyBounds& bounds, FireflyKernel kernel)
+{
+    if (!fireflyKernelSupported(kernel))
+        kernel = FIREFLY_KERNEL_SCALAR;
+    switch (kernel)
+    {
+#ifdef FIREFLY_X86
+    case FIREFLY_KERNEL_AVX2:
+        updateAVX2(store, begin, end, deltaTime, bounds);
+        break;
+    case FIREFLY_KERNEL_SSE2:
+        updateSSE2(store, begin, end, deltaTime, bounds);
+        break;
+#endif
+    default:
+        updateScalar(store, begin, end, deltaTime, bounds);
+        break;
+    }
+}
+
+void updateFireflies(FireflyStore& store, float deltaTime, const FireflyBounds& bounds)
+{
+    static const FireflyKernel best = fireflyBestKernel();
+    updateFireflies(store, 0, store.capacity(), deltaTime, bounds, best);
+}
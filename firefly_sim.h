@@ -0,0 +1,76 @@
+#pragma once
+#ifndef FIREFLY_SIM_H
+#define FIREFLY_SIM_H
+
+#include <cstddef>
+
+// Number of fireflies processed per step by the widest kernel. Every array in
+// FireflyStore is padded to a multiple of this, so kernels never need a tail loop.
+const size_t FIREFLY_LANES = 8;
+
+// Update kernels, from slowest to fastest. fireflyBestKernel() picks the best one
+// the running CPU supports.
+enum FireflyKernel
+{
+    FIREFLY_KERNEL_SCALAR,
+    FIREFLY_KERNEL_SSE2,
+    FIREFLY_KERNEL_AVX2
+};
+
+// Structure-of-arrays firefly storage. Each attribute lives in its own 32-byte
+// aligned array so the update kernels can load whole SIMD registers at once.
+// Every firefly carries its own xorshift32 random state, which makes the motion
+// independent of which kernel (or how many threads) advances it.
+class FireflyStore
+{
+public:
+    float* x;
+    float* y;
+    float* z;
+    float* speed;
+    float* size;
+    float* phase;
+    unsigned int* rng;
+
+    FireflyStore();
+    ~FireflyStore();
+
+    // reallocates for count fireflies; previous contents are discarded
+    void resize(size_t count);
+    // number of live fireflies
+    size_t count() const { return liveCount; }
+    // allocated length of every array (count rounded up to FIREFLY_LANES)
+    size_t capacity() const { return paddedCount; }
+
+private:
+    size_t liveCount;
+    size_t paddedCount;
+
+    void release();
+    FireflyStore(const FireflyStore&);
+    FireflyStore& operator=(const FireflyStore&);
+};
+
+// Region the fireflies move in: they drift around (centerX, centerY, centerZ) and
+// respawn at a random x whenever they fall below bottomY.
+struct FireflyBounds
+{
+    float centerX;
+    float centerY;
+    float centerZ;
+    float bottomY;
+};
+
+// fills the store with count fireflies spread over the unit cube around the bounds' center
+void generateFireflies(FireflyStore& store, size_t count, const FireflyBounds& bounds, unsigned int seed);
+
+// advances fireflies [begin, end) by deltaTime; begin and end must be multiples of
+// FIREFLY_LANES (end may also be store.capacity())
+void updateFireflies(FireflyStore& store, size_t begin, size_t end, float deltaTime, const FireflyBounds& bounds, FireflyKernel kernel);
+// advances every firefly with the best kernel for this CPU
+void updateFireflies(FireflyStore& store, float deltaTime, const FireflyBounds& bounds);
+
+FireflyKernel fireflyBestKernel();
+bool fireflyKernelSupported(FireflyKernel kernel);
+const char* fireflyKernelName(FireflyKernel kernel);
+#endif
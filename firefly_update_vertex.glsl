@@ -0,0 +1,47 @@
+#version 330 core
+// Advances one firefly per vertex; the outputs are captured with transform
+// feedback into the other state buffer. Mirrors the CPU kernels in
+// firefly_sim.cpp: one xorshift32 step per firefly picks the vertical and
+// horizontal direction and, on respawn, the new x.
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in float aSpeed;
+layout(location = 2) in float aSize;
+layout(location = 3) in float aPhase;
+layout(location = 4) in uint aRng;
+
+uniform float deltaTime;
+uniform float centerX;
+uniform float bottomY;
+
+out vec3 outPos;
+out float outSpeed;
+out float outSize;
+out float outPhase;
+flat out uint outRng;
+
+void main()
+{
+    uint r = aRng;
+    r ^= r << 13u;
+    r ^= r >> 17u;
+    r ^= r << 5u;
+
+    float step = aSpeed * deltaTime;
+    float signY = (r & 1u) != 0u ? -1.0 : 1.0;
+    float signX = (r & 2u) != 0u ? -1.0 : 1.0;
+    vec3 pos = aPos;
+    pos.y += signY * step;
+    pos.x += signX * (step * 0.5);
+    // below the bottom of the cube: move up by 0.5 and respawn at a random x
+    if (pos.y < bottomY)
+    {
+        pos.y += 0.5;
+        pos.x = (centerX + float(r >> 8u) * (1.0 / 16777216.0)) - 0.5;
+    }
+
+    outPos = pos;
+    outSpeed = aSpeed;
+    outSize = aSize;
+    outPhase = aPhase;
+    outRng = r;
+}
@@ -0,0 +1,107 @@
+#include "fixed_step.h"
+
+#include <cmath>
+
+FixedStepThread::FixedStepThread()
+    : epoch(std::chrono::steady_clock::now()), running(false), rate(60), maxSubsteps(4),
+      manual(false), manualTime(0.0), simulationTime(0.0), stepFunction(NULL), publishFunction(NULL), context(NULL)
+{
+}
+
+FixedStepThread::~FixedStepThread()
+{
+    stop();
+}
+
+void FixedStepThread::start(StepFunction step, PublishFunction publish, void* userContext)
+{
+    stop();
+    stepFunction = step;
+    publishFunction = publish;
+    context = userContext;
+    manual = false;
+    running = true;
+    thread = std::thread(&FixedStepThread::run, this);
+}
+
+void FixedStepThread::startManual(StepFunction step, PublishFunction publish, void* userContext)
+{
+    stop();
+    stepFunction = step;
+    publishFunction = publish;
+    context = userContext;
+    manual = true;
+    manualTime = 0.0;
+    simulationTime = 0.0;
+}
+
+void FixedStepThread::advance(double seconds)
+{
+    if (!manual)
+        return;
+    manualTime += seconds;
+    catchUp(manualTime);
+}
+
+void FixedStepThread::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+void FixedStepThread::setRate(int stepsPerSecond)
+{
+    rate = stepsPerSecond > 1 ? stepsPerSecond : 1;
+}
+
+void FixedStepThread::setMaxSubsteps(int substeps)
+{
+    maxSubsteps = substeps > 1 ? substeps : 1;
+}
+
+double FixedStepThread::now() const
+{
+    if (manual)
+        return manualTime;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void FixedStepThread::run()
+{
+    simulationTime = now();
+    while (running)
+    {
+        catchUp(now());
+
+        // sleep until the next step is due
+        std::chrono::duration<double> wait(simulationTime + 1.0 / rate.load() - now());
+        if (wait.count() > 0.0)
+            std::this_thread::sleep_for(wait);
+    }
+}
+
+void FixedStepThread::catchUp(double current)
+{
+    double step = 1.0 / rate.load();
+    // the tolerance keeps a frame time that is a whole number of steps (e.g. a
+    // fixed 1/60 s in manual mode) from losing a step to rounding
+    int steps = static_cast<int>(std::floor((current - simulationTime) / step + 1e-6));
+    int limit = maxSubsteps.load();
+    if (steps > limit)
+    {
+        simulationTime = current - limit * step;
+        steps = limit;
+    }
+
+    if (steps > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < steps; ++i)
+        {
+            stepFunction(context, static_cast<float>(step), i == steps - 1);
+            simulationTime += step;
+        }
+        publishFunction(context, simulationTime, static_cast<float>(step));
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#ifndef FIXED_STEP_H
+#define FIXED_STEP_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// Lock-free single-producer/single-consumer triple buffer. The producer fills
+// writeBuffer() and publishes it; the consumer acquires the most recently
+// published buffer and keeps reading it until it acquires again. Neither side
+// ever waits, and buffers are reused, so their contents (e.g. vectors) keep
+// their allocations.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : writeIndex(0), readIndex(1), ready(2) {}
+
+    // producer side
+    T& writeBuffer() { return buffers[writeIndex]; }
+    void publish() { writeIndex = ready.exchange(writeIndex | FRESH) & INDEX_MASK; }
+
+    // consumer side: returns false (and keeps the current buffer) if nothing new was published
+    bool acquire()
+    {
+        if (!(ready.load() & FRESH))
+            return false;
+        readIndex = ready.exchange(readIndex) & INDEX_MASK;
+        return true;
+    }
+    const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    enum { INDEX_MASK = 3, FRESH = 4 };
+    T buffers[3];
+    unsigned int writeIndex;
+    unsigned int readIndex;
+    // index of the buffer waiting for the consumer, plus FRESH if it was not read yet
+    std::atomic<unsigned int> ready;
+
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+};
+
+// Runs a simulation at a fixed rate on its own thread. Each wake-up advances
+// the simulation by as many whole steps as real time requires, capped at
+// maxSubsteps (the rest of the backlog is dropped so a hitch cannot snowball),
+// then calls publish once with the time of the last step. Steps and publish run
+// with stateMutex() held, so other threads lock it to change the state safely.
+//
+// For deterministic runs (offscreen captures, benchmarks) startManual() takes
+// the place of start(): no thread is created, the caller advances simulated
+// time with advance(), which steps on the calling thread, and now() reports
+// that simulated time instead of the real clock.
+class FixedStepThread
+{
+public:
+    // lastSubstep is true for the final step before publish
+    typedef void (*StepFunction)(void* context, float stepSeconds, bool lastSubstep);
+    typedef void (*PublishFunction)(void* context, double time, float stepSeconds);
+
+    FixedStepThread();
+    ~FixedStepThread();
+
+    void start(StepFunction step, PublishFunction publish, void* context);
+    void startManual(StepFunction step, PublishFunction publish, void* context);
+    void stop();
+    // manual mode only: moves simulated time forward by seconds and takes the steps that are due
+    void advance(double seconds);
+
+    void setRate(int stepsPerSecond);
+    void setMaxSubsteps(int substeps);
+    float stepSeconds() const { return 1.0f / rate.load(); }
+
+    // seconds since construction (simulated seconds in manual mode), on the
+    // clock the step times are measured with
+    double now() const;
+    std::mutex& stateMutex() { return mutex; }
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+    std::thread thread;
+    std::mutex mutex;
+    std::atomic<bool> running;
+    std::atomic<int> rate;
+    std::atomic<int> maxSubsteps;
+    bool manual;
+    double manualTime;
+    // time of the last step taken
+    double simulationTime;
+    StepFunction stepFunction;
+    PublishFunction publishFunction;
+    void* context;
+
+    void run();
+    void catchUp(double current);
+
+    FixedStepThread(const FixedStepThread&);
+    FixedStepThread& operator=(const FixedStepThread&);
+};
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gl_state.h"
+#include "shader.h"
+
+// Per-frame camera and light data, laid out to match the std140 "FrameData"
+// uniform block declared in the scene shaders (vec3s are padded to vec4).
+// lightPos and lightColor are the scene's main light; the point lights are
+// found through the light cluster grid that clusterScale and clusterSize
+// describe (see LightClusterGrid).
+struct FrameData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPos;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+    glm::vec4 clusterScale;
+    glm::vec4 clusterSize;
+};
+
+// Owns the uniform buffer backing the FrameData block. It is bound once to
+// FRAME_DATA_BINDING and rewritten once per frame, so every program that
+// declares the block sees the same data without any glUniform calls.
+class FrameUniformBuffer
+{
+public:
+    unsigned int ID;
+
+    FrameUniformBuffer()
+    {
+        glGenBuffers(1, &ID);
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+        GLState::bindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, ID);
+    }
+
+    // deletes the buffer; call while the context is still current
+    void release()
+    {
+        glDeleteBuffers(1, &ID);
+    }
+
+    // uploads this frame's data; call once before the first draw of the frame
+    void update(const FrameData& data) const
+    {
+        // stays bound, so the bind is elided from the second frame on
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+    }
+
+private:
+    FrameUniformBuffer(const FrameUniformBuffer&);
+    FrameUniformBuffer& operator=(const FrameUniformBuffer&);
+};
+#endif
@@ -0,0 +1,344 @@
+#include "frame_profiler.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+    double secondsBetween(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration<double>(end - begin).count();
+    }
+
+    ImU32 passColor(int pass, size_t passCount)
+    {
+        if (pass >= static_cast<int>(passCount))
+            return IM_COL32(110, 110, 110, 255); // "other"
+        return ImColor::HSV(static_cast<float>(pass) / passCount, 0.55f, 0.85f);
+    }
+}
+
+FrameProfiler::FrameProfiler(const std::vector<std::string>& passNames)
+    : names(passNames), history(HISTORY_FRAMES), frameNumber(-1), activePass(-1), frameOpen(false)
+{
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        history[i].number = -1;
+        history[i].cpuTotal = 0.0;
+        history[i].gpuValid = false;
+        history[i].cpu.assign(names.size(), 0.0);
+        history[i].gpu.assign(names.size(), 0.0);
+    }
+    for (int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+    {
+        sets[i].frame = -1;
+        sets[i].queries.resize(names.size());
+        sets[i].issued.assign(names.size(), false);
+        glGenQueries(static_cast<GLsizei>(names.size()), &sets[i].queries[0]);
+    }
+}
+
+void FrameProfiler::release()
+{
+    for (int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+    {
+        if (!sets[i].queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(sets[i].queries.size()), &sets[i].queries[0]);
+        sets[i].queries.clear();
+        sets[i].frame = -1;
+    }
+}
+
+void FrameProfiler::beginFrame()
+{
+    ++frameNumber;
+    // the set is reused now, so this is the last chance to read what it measured
+    QuerySet& set = sets[frameNumber % FRAMES_IN_FLIGHT];
+    collect(set);
+    set.frame = frameNumber;
+    set.issued.assign(names.size(), false);
+
+    Frame& frame = current();
+    frame.number = frameNumber;
+    frame.cpuTotal = 0.0;
+    frame.gpuValid = false;
+    frame.cpu.assign(names.size(), 0.0);
+    frame.gpu.assign(names.size(), 0.0);
+    frameOpen = true;
+    frameStart = Clock::now();
+}
+
+void FrameProfiler::endFrame()
+{
+    current().cpuTotal = secondsBetween(frameStart, Clock::now());
+    frameOpen = false;
+}
+
+void FrameProfiler::beginPass(int pass)
+{
+    QuerySet& set = sets[frameNumber % FRAMES_IN_FLIGHT];
+    if (set.queries.empty())
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, set.queries[pass]);
+    set.issued[pass] = true;
+    activePass = pass;
+    passStart = Clock::now();
+}
+
+void FrameProfiler::endPass(int pass)
+{
+    if (activePass != pass)
+        return;
+    current().cpu[pass] += secondsBetween(passStart, Clock::now());
+    glEndQuery(GL_TIME_ELAPSED);
+    activePass = -1;
+}
+
+void FrameProfiler::collect(QuerySet& set)
+{
+    if (set.frame < 0 || set.queries.empty())
+        return;
+    Frame& frame = history[set.frame % HISTORY_FRAMES];
+    if (frame.number != set.frame)
+        return;
+
+    // queries finish in the order they were issued, so the last one decides
+    int last = -1;
+    for (size_t pass = 0; pass < names.size(); ++pass)
+        if (set.issued[pass])
+            last = static_cast<int>(pass);
+    if (last >= 0)
+    {
+        GLuint available = 0;
+        glGetQueryObjectuiv(set.queries[last], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+    }
+    for (size_t pass = 0; pass < names.size(); ++pass)
+    {
+        GLuint64 nanoseconds = 0;
+        if (set.issued[pass])
+            glGetQueryObjectui64v(set.queries[pass], GL_QUERY_RESULT, &nanoseconds);
+        frame.gpu[pass] = nanoseconds * 1e-9;
+    }
+    frame.gpuValid = true;
+}
+
+void FrameProfiler::computeStats(std::vector<Stats>& stats, double& frameAverage, double& frameMax, int& frames, int& gpuFrames) const
+{
+    Stats zero = { 0.0, 0.0, 0.0, 0.0 };
+    stats.assign(names.size() + 1, zero);
+    frameAverage = frameMax = 0.0;
+    frames = gpuFrames = 0;
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        const Frame& frame = history[i];
+        if (frame.number < 0 || (frameOpen && frame.number == frameNumber))
+            continue;
+        ++frames;
+        frameAverage += frame.cpuTotal;
+        frameMax = std::max(frameMax, frame.cpuTotal);
+        double other = frame.cpuTotal;
+        for (size_t pass = 0; pass < names.size(); ++pass)
+        {
+            stats[pass].cpuAverage += frame.cpu[pass];
+            stats[pass].cpuMax = std::max(stats[pass].cpuMax, frame.cpu[pass]);
+            other -= frame.cpu[pass];
+            if (frame.gpuValid)
+            {
+                stats[pass].gpuAverage += frame.gpu[pass];
+                stats[pass].gpuMax = std::max(stats[pass].gpuMax, frame.gpu[pass]);
+            }
+        }
+        other = std::max(other, 0.0);
+        stats[names.size()].cpuAverage += other;
+        stats[names.size()].cpuMax = std::max(stats[names.size()].cpuMax, other);
+        gpuFrames += frame.gpuValid;
+    }
+    for (size_t pass = 0; pass < stats.size(); ++pass)
+    {
+        if (frames > 0)
+            stats[pass].cpuAverage /= frames;
+        if (gpuFrames > 0)
+            stats[pass].gpuAverage /= gpuFrames;
+    }
+    if (frames > 0)
+        frameAverage /= frames;
+}
+
+void FrameProfiler::printSummary(std::ostream& out) const
+{
+    std::vector<Stats> stats;
+    double frameAverage, frameMax;
+    int frames, gpuFrames;
+    computeStats(stats, frameAverage, frameMax, frames, gpuFrames);
+    out << "Per-pass times over the last " << frames << " frames (GPU: " << gpuFrames << " frames), avg / max in ms:" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (size_t pass = 0; pass < stats.size(); ++pass)
+    {
+        out << "  " << std::left << std::setw(12) << (pass < names.size() ? names[pass] : std::string("other")) << std::right
+            << " cpu " << std::setw(8) << stats[pass].cpuAverage * 1000.0 << " / " << std::setw(8) << stats[pass].cpuMax * 1000.0;
+        if (pass < names.size())
+            out << "   gpu " << std::setw(8) << stats[pass].gpuAverage * 1000.0 << " / " << std::setw(8) << stats[pass].gpuMax * 1000.0;
+        out << std::endl;
+    }
+}
+
+void FrameProfiler::drawWindow(bool* open)
+{
+    // first use only: to the right of the main panel
+    const ImVec2 display = ImGui::GetIO().DisplaySize;
+    ImGui::SetNextWindowPos(ImVec2(display.x - 450.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(440.0f, 460.0f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Frame profiler", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    std::vector<Stats> stats;
+    double frameAverage, frameMax;
+    int frames, gpuFrames;
+    computeStats(stats, frameAverage, frameMax, frames, gpuFrames);
+    ImGui::Text("Last %d frames: CPU %.3f ms avg, %.3f ms max", frames, frameAverage * 1000.0, frameMax * 1000.0);
+
+    if (ImGui::BeginTable("passes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+    {
+        ImGui::TableSetupColumn("pass");
+        ImGui::TableSetupColumn("CPU avg");
+        ImGui::TableSetupColumn("CPU max");
+        ImGui::TableSetupColumn("GPU avg");
+        ImGui::TableSetupColumn("GPU max");
+        ImGui::TableHeadersRow();
+        for (size_t pass = 0; pass < stats.size(); ++pass)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::PushID(static_cast<int>(pass));
+            ImGui::ColorButton("##color", ImColor(passColor(static_cast<int>(pass), names.size())),
+                ImGuiColorEditFlags_NoTooltip | ImGuiColorEditFlags_NoDragDrop, ImVec2(10.0f, 10.0f));
+            ImGui::SameLine();
+            ImGui::TextUnformatted(pass < names.size() ? names[pass].c_str() : "other");
+            ImGui::PopID();
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats[pass].cpuAverage * 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats[pass].cpuMax * 1000.0);
+            ImGui::TableNextColumn();
+            if (pass < names.size())
+                ImGui::Text("%.3f", stats[pass].gpuAverage * 1000.0);
+            ImGui::TableNextColumn();
+            if (pass < names.size())
+                ImGui::Text("%.3f", stats[pass].gpuMax * 1000.0);
+        }
+        ImGui::EndTable();
+    }
+
+    drawTimeline("CPU (ms)", false, 90.0f);
+    drawTimeline("GPU (ms)", true, 90.0f);
+    ImGui::End();
+}
+
+void FrameProfiler::drawTimeline(const char* label, bool gpu, float height)
+{
+    const int passes = static_cast<int>(names.size());
+    // stacked height of a frame; the CPU stack ends with "other" and so adds up to the frame time
+    struct Local
+    {
+        static double total(const Frame& frame, bool gpu, int passes)
+        {
+            if (!gpu)
+                return frame.cpuTotal;
+            double sum = 0.0;
+            for (int pass = 0; pass < passes; ++pass)
+                sum += frame.gpu[pass];
+            return sum;
+        }
+    };
+
+    // frames oldest first, skipping the one still being recorded
+    long long newest = frameOpen ? frameNumber - 1 : frameNumber;
+    double scale = 1e-3;
+    for (int i = 0; i < HISTORY_FRAMES; ++i)
+    {
+        const Frame& frame = history[i];
+        if (frame.number >= 0 && frame.number <= newest && (!gpu || frame.gpuValid))
+            scale = std::max(scale, Local::total(frame, gpu, passes));
+    }
+    scale *= 1.1;
+
+    ImGui::Text("%s, top = %.2f ms", label, scale * 1000.0);
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+    ImGui::InvisibleButton(label, ImVec2(width, height));
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height), IM_COL32(25, 25, 25, 255));
+
+    float barWidth = width / HISTORY_FRAMES;
+    float bottom = origin.y + height;
+    for (int i = 0; i < HISTORY_FRAMES; ++i)
+    {
+        long long number = newest - (HISTORY_FRAMES - 1) + i;
+        if (number < 0)
+            continue;
+        const Frame& frame = history[number % HISTORY_FRAMES];
+        if (frame.number != number || (gpu && !frame.gpuValid))
+            continue;
+        float x = origin.x + i * barWidth;
+        float y = bottom;
+        double other = frame.cpuTotal;
+        for (int pass = 0; pass <= passes; ++pass)
+        {
+            double seconds;
+            if (pass < passes)
+            {
+                seconds = gpu ? frame.gpu[pass] : frame.cpu[pass];
+                other -= frame.cpu[pass];
+            }
+            else
+            {
+                if (gpu)
+                    break;
+                seconds = std::max(other, 0.0);
+            }
+            float h = static_cast<float>(seconds / scale) * height;
+            if (h <= 0.0f)
+                continue;
+            draw->AddRectFilled(ImVec2(x, y - h), ImVec2(x + std::max(barWidth, 1.0f), y), passColor(pass, names.size()));
+            y -= h;
+        }
+    }
+
+    // 60 and 30 FPS frame budgets
+    const double budgets[2] = { 1.0 / 60.0, 1.0 / 30.0 };
+    for (int b = 0; b < 2; ++b)
+    {
+        if (budgets[b] >= scale)
+            continue;
+        float y = bottom - static_cast<float>(budgets[b] / scale) * height;
+        draw->AddLine(ImVec2(origin.x, y), ImVec2(origin.x + width, y), IM_COL32(255, 255, 255, 80));
+    }
+
+    if (ImGui::IsItemHovered())
+    {
+        int i = static_cast<int>((ImGui::GetIO().MousePos.x - origin.x) / barWidth);
+        long long number = newest - (HISTORY_FRAMES - 1) + i;
+        if (i >= 0 && i < HISTORY_FRAMES && number >= 0 && history[number % HISTORY_FRAMES].number == number)
+        {
+            const Frame& frame = history[number % HISTORY_FRAMES];
+            ImGui::BeginTooltip();
+            ImGui::Text("frame %lld", number);
+            if (gpu && !frame.gpuValid)
+                ImGui::TextUnformatted("GPU results were not ready");
+            else
+            {
+                for (int pass = 0; pass < passes; ++pass)
+                    ImGui::Text("%-12s %.3f ms", names[pass].c_str(), (gpu ? frame.gpu[pass] : frame.cpu[pass]) * 1000.0);
+                ImGui::Text("%-12s %.3f ms", "total", Local::total(frame, gpu, passes) * 1000.0);
+            }
+            ImGui::EndTooltip();
+        }
+    }
+}
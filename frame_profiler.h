@@ -0,0 +1,104 @@
+#pragma once
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-pass CPU and GPU timing of the render loop. Each pass is bracketed by a
+// steady_clock timer and a GL_TIME_ELAPSED query. Queries are cycled through
+// FRAMES_IN_FLIGHT sets and a set is only read back when it is about to be
+// reused, after checking GL_QUERY_RESULT_AVAILABLE, so the profiler never
+// waits for the GPU; a frame whose results are still pending by then just has
+// no GPU times. Passes must not overlap (GL allows one time-elapsed query at a
+// time), and a pass that is skipped in a frame counts as zero.
+//
+// The last HISTORY_FRAMES frames are kept in a ring buffer and shown by
+// drawWindow() as stacked CPU and GPU timelines with per-pass averages and
+// maxima.
+class FrameProfiler
+{
+public:
+    enum { FRAMES_IN_FLIGHT = 3, HISTORY_FRAMES = 300 };
+
+    // passes are identified by their index in passNames
+    explicit FrameProfiler(const std::vector<std::string>& passNames);
+    // deletes the queries; call while the context is still current
+    void release();
+
+    // bracket everything the render thread does for one frame
+    void beginFrame();
+    void endFrame();
+
+    void beginPass(int pass);
+    void endPass(int pass);
+
+    size_t passCount() const { return names.size(); }
+    const std::string& passName(int pass) const { return names[pass]; }
+
+    // per-pass averages and maxima over the frames in the history
+    void printSummary(std::ostream& out) const;
+    // the profiler window; call between ImGui::NewFrame() and ImGui::Render()
+    void drawWindow(bool* open);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Frame
+    {
+        long long number;     // -1 while the slot is unused
+        double cpuTotal;      // seconds from beginFrame() to endFrame()
+        bool gpuValid;
+        std::vector<double> cpu;
+        std::vector<double> gpu;
+    };
+    struct QuerySet
+    {
+        long long frame;      // frame the queries were issued in, -1 if none
+        std::vector<GLuint> queries;
+        std::vector<bool> issued;
+    };
+    struct Stats
+    {
+        double cpuAverage, cpuMax, gpuAverage, gpuMax;
+    };
+
+    std::vector<std::string> names;
+    std::vector<Frame> history;
+    QuerySet sets[FRAMES_IN_FLIGHT];
+    long long frameNumber;
+    int activePass;
+    bool frameOpen;       // between beginFrame() and endFrame()
+    Clock::time_point frameStart;
+    Clock::time_point passStart;
+
+    Frame& current() { return history[frameNumber % HISTORY_FRAMES]; }
+    void collect(QuerySet& set);
+    // stats has one entry per pass plus a last one for "other", the frame's CPU time outside every pass
+    void computeStats(std::vector<Stats>& stats, double& frameAverage, double& frameMax, int& frames, int& gpuFrames) const;
+    void drawTimeline(const char* label, bool gpu, float height);
+
+    FrameProfiler(const FrameProfiler&);
+    FrameProfiler& operator=(const FrameProfiler&);
+};
+
+// Times the enclosing block as one pass.
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler& profiler, int pass) : profiler(profiler), pass(pass) { profiler.beginPass(pass); }
+    ~ProfileScope() { profiler.endPass(pass); }
+
+private:
+    FrameProfiler& profiler;
+    int pass;
+
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+};
+#endif
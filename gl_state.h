@@ -0,0 +1,459 @@
+#pragma once
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <climits>
+
+// Shadow copy of the GL state the renderer changes. Every setter compares the
+// new value with the shadow and only calls into GL when it differs, so a pass
+// can set up exactly the state it needs without knowing what ran before it and
+// without paying for redundant binds. Values the shadow does not know (after
+// invalidate(), or before the first set) are always issued.
+//
+// The shadow is only right while every change of the tracked state goes
+// through here. Code that changes it behind the shadow's back, such as the
+// ImGui renderer, is bracketed with snapshot() and restore(), telling the
+// shadow in between what the code left behind with assume().
+//
+// Tracked: the program, the vertex array, the generic array, element array,
+// uniform and pixel unpack buffer bindings, the active texture unit and the 2D
+// and buffer texture bindings of the first MAX_TEXTURE_UNITS units, the
+// capabilities in Capability, blend equation and function, depth function and
+// mask, cull face, polygon mode, viewport and scissor box. Other targets and
+// capabilities are passed straight to GL.
+//
+// Header-only and meant for the one context of the render thread, so the
+// shadow lives in a function-local static, like ProgramBinaryCache.
+class GLState
+{
+public:
+    enum { MAX_TEXTURE_UNITS = 8 };
+    enum : GLuint { UNKNOWN = 0xFFFFFFFFu };  // an unknown binding, enum or flag
+    enum : GLint { UNKNOWN_RECT = INT_MIN };  // x of an unknown viewport or scissor box
+
+    enum Capability { BLEND, CULL_FACE, DEPTH_TEST, STENCIL_TEST, SCISSOR_TEST, PRIMITIVE_RESTART, RASTERIZER_DISCARD, PROGRAM_POINT_SIZE, CAPABILITY_COUNT };
+    enum BufferSlot { ARRAY_BUFFER_SLOT, ELEMENT_BUFFER_SLOT, UNIFORM_BUFFER_SLOT, PIXEL_UNPACK_BUFFER_SLOT, BUFFER_SLOT_COUNT };
+    enum TextureSlot { TEXTURE_2D_SLOT, TEXTURE_BUFFER_SLOT, TEXTURE_SLOT_COUNT };
+
+    struct Snapshot
+    {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint buffers[BUFFER_SLOT_COUNT];   // the element array buffer is that of vertexArray
+        GLenum activeTexture;
+        GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_SLOT_COUNT];
+        GLuint enabled[CAPABILITY_COUNT];    // GL_TRUE, GL_FALSE or UNKNOWN
+        GLenum blendEquation[2];             // rgb, alpha
+        GLenum blendFunc[4];                 // source rgb, destination rgb, source alpha, destination alpha
+        GLenum depthFunc;
+        GLuint depthMask;
+        GLenum cullFace;
+        GLenum polygonMode;
+        GLint viewport[4];
+        GLint scissorBox[4];
+    };
+
+    // calls that reached GL and calls that were dropped as redundant
+    struct Counters
+    {
+        unsigned long long issued;
+        unsigned long long elided;
+    };
+
+    // the state of a freshly created context; only the viewport and scissor
+    // box, which start out as the window size, are unknown
+    static void reset()
+    {
+        Snapshot& s = state().shadow;
+        s = unknownState();
+        s.program = 0;
+        s.vertexArray = 0;
+        for (int slot = 0; slot < BUFFER_SLOT_COUNT; ++slot)
+            s.buffers[slot] = 0;
+        s.activeTexture = GL_TEXTURE0;
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+            for (int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+                s.textures[unit][slot] = 0;
+        for (int cap = 0; cap < CAPABILITY_COUNT; ++cap)
+            s.enabled[cap] = GL_FALSE;
+        s.blendEquation[0] = s.blendEquation[1] = GL_FUNC_ADD;
+        s.blendFunc[0] = s.blendFunc[2] = GL_ONE;
+        s.blendFunc[1] = s.blendFunc[3] = GL_ZERO;
+        s.depthFunc = GL_LESS;
+        s.depthMask = GL_TRUE;
+        s.cullFace = GL_BACK;
+        s.polygonMode = GL_FILL;
+    }
+
+    // forgets everything, e.g. after code that changed state without the shadow
+    static void invalidate()
+    {
+        state().shadow = unknownState();
+    }
+
+    // a snapshot in which nothing is known, to fill in for assume()
+    static Snapshot unknownState()
+    {
+        Snapshot s;
+        s.program = UNKNOWN;
+        s.vertexArray = UNKNOWN;
+        for (int slot = 0; slot < BUFFER_SLOT_COUNT; ++slot)
+            s.buffers[slot] = UNKNOWN;
+        s.activeTexture = UNKNOWN;
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+            for (int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+                s.textures[unit][slot] = UNKNOWN;
+        for (int cap = 0; cap < CAPABILITY_COUNT; ++cap)
+            s.enabled[cap] = UNKNOWN;
+        s.blendEquation[0] = s.blendEquation[1] = UNKNOWN;
+        for (int i = 0; i < 4; ++i)
+            s.blendFunc[i] = UNKNOWN;
+        s.depthFunc = UNKNOWN;
+        s.depthMask = UNKNOWN;
+        s.cullFace = UNKNOWN;
+        s.polygonMode = UNKNOWN;
+        s.viewport[0] = UNKNOWN_RECT;
+        s.scissorBox[0] = UNKNOWN_RECT;
+        return s;
+    }
+
+    static Snapshot snapshot()
+    {
+        return state().shadow;
+    }
+
+    // takes s as what GL currently has, without calling GL
+    static void assume(const Snapshot& s)
+    {
+        state().shadow = s;
+    }
+
+    // sets everything saved knew through the setters below, so only what
+    // differs from the shadow reaches GL
+    static void restore(const Snapshot& saved)
+    {
+        if (saved.program != UNKNOWN)
+            useProgram(saved.program);
+        // the vertex array first, since the element array buffer belongs to it
+        if (saved.vertexArray != UNKNOWN)
+            bindVertexArray(saved.vertexArray);
+        for (int slot = 0; slot < BUFFER_SLOT_COUNT; ++slot)
+            if (saved.buffers[slot] != UNKNOWN)
+                bindBuffer(bufferTarget(slot), saved.buffers[slot]);
+        for (int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+            for (int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+                if (saved.textures[unit][slot] != UNKNOWN)
+                    bindTextureUnit(unit, textureTarget(slot), saved.textures[unit][slot]);
+        if (saved.activeTexture != UNKNOWN)
+            activeTexture(saved.activeTexture);
+        for (int cap = 0; cap < CAPABILITY_COUNT; ++cap)
+            if (saved.enabled[cap] != UNKNOWN)
+                setEnabled(capabilityName(cap), saved.enabled[cap] == GL_TRUE);
+        if (saved.blendEquation[0] != UNKNOWN)
+            blendEquationSeparate(saved.blendEquation[0], saved.blendEquation[1]);
+        if (saved.blendFunc[0] != UNKNOWN)
+            blendFuncSeparate(saved.blendFunc[0], saved.blendFunc[1], saved.blendFunc[2], saved.blendFunc[3]);
+        if (saved.depthFunc != UNKNOWN)
+            depthFunc(saved.depthFunc);
+        if (saved.depthMask != UNKNOWN)
+            depthMask(static_cast<GLboolean>(saved.depthMask));
+        if (saved.cullFace != UNKNOWN)
+            cullFace(saved.cullFace);
+        if (saved.polygonMode != UNKNOWN)
+            polygonMode(saved.polygonMode);
+        if (saved.viewport[0] != UNKNOWN_RECT)
+            viewport(saved.viewport[0], saved.viewport[1], saved.viewport[2], saved.viewport[3]);
+        if (saved.scissorBox[0] != UNKNOWN_RECT)
+            scissor(saved.scissorBox[0], saved.scissorBox[1], saved.scissorBox[2], saved.scissorBox[3]);
+    }
+
+    // call when a program that may be current is deleted, as GL may hand its name out again
+    static void forgetProgram(GLuint program)
+    {
+        if (state().shadow.program == program)
+            state().shadow.program = UNKNOWN;
+    }
+
+    // objects
+    // ------------------------------------------------------------------------
+    static void useProgram(GLuint program)
+    {
+        if (update(state().shadow.program, program))
+            glUseProgram(program);
+    }
+    static void bindVertexArray(GLuint vertexArray)
+    {
+        State& s = state();
+        if (update(s.shadow.vertexArray, vertexArray))
+        {
+            glBindVertexArray(vertexArray);
+            s.shadow.buffers[ELEMENT_BUFFER_SLOT] = UNKNOWN;
+        }
+    }
+    static void bindBuffer(GLenum target, GLuint buffer)
+    {
+        int slot = bufferSlot(target);
+        if (slot < 0)
+            passThrough();
+        else if (!update(state().shadow.buffers[slot], buffer))
+            return;
+        glBindBuffer(target, buffer);
+    }
+    // also binds the generic binding point, as glBindBufferBase() does; the
+    // indexed binding itself is not tracked
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        int slot = bufferSlot(target);
+        if (slot >= 0)
+            state().shadow.buffers[slot] = buffer;
+        passThrough();
+        glBindBufferBase(target, index, buffer);
+    }
+    static void activeTexture(GLenum unit)
+    {
+        if (update(state().shadow.activeTexture, unit))
+            glActiveTexture(unit);
+    }
+    // binds to the active unit
+    static void bindTexture(GLenum target, GLuint texture)
+    {
+        State& s = state();
+        int slot = textureSlot(target);
+        if (slot >= 0 && s.shadow.activeTexture == UNKNOWN)
+        {
+            // some unit changes, but not which one
+            for (int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit)
+                s.shadow.textures[unit][slot] = UNKNOWN;
+            slot = -1;
+        }
+        GLuint unit = s.shadow.activeTexture - GL_TEXTURE0;
+        if (slot < 0 || unit >= MAX_TEXTURE_UNITS)
+            passThrough();
+        else if (!update(s.shadow.textures[unit][slot], texture))
+            return;
+        glBindTexture(target, texture);
+    }
+    // binds to the given unit, switching the active unit only if the binding changes
+    static void bindTextureUnit(GLuint unit, GLenum target, GLuint texture)
+    {
+        State& s = state();
+        int slot = textureSlot(target);
+        if (slot >= 0 && unit < MAX_TEXTURE_UNITS && s.shadow.textures[unit][slot] == texture)
+        {
+            ++s.frame.elided;
+            return;
+        }
+        activeTexture(GL_TEXTURE0 + unit);
+        bindTexture(target, texture);
+    }
+
+    // fixed-function state
+    // ------------------------------------------------------------------------
+    static void enable(GLenum capability)
+    {
+        setEnabled(capability, true);
+    }
+    static void disable(GLenum capability)
+    {
+        setEnabled(capability, false);
+    }
+    static void setEnabled(GLenum capability, bool enabled)
+    {
+        int cap = capabilitySlot(capability);
+        if (cap < 0)
+            passThrough();
+        else if (!update(state().shadow.enabled[cap], enabled ? GL_TRUE : GL_FALSE))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+    static void blendEquation(GLenum mode)
+    {
+        blendEquationSeparate(mode, mode);
+    }
+    static void blendEquationSeparate(GLenum rgb, GLenum alpha)
+    {
+        const GLenum values[2] = { rgb, alpha };
+        if (updateArray(state().shadow.blendEquation, values, 2))
+            glBlendEquationSeparate(rgb, alpha);
+    }
+    static void blendFunc(GLenum source, GLenum destination)
+    {
+        blendFuncSeparate(source, destination, source, destination);
+    }
+    static void blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb, GLenum sourceAlpha, GLenum destinationAlpha)
+    {
+        const GLenum values[4] = { sourceRgb, destinationRgb, sourceAlpha, destinationAlpha };
+        if (updateArray(state().shadow.blendFunc, values, 4))
+            glBlendFuncSeparate(sourceRgb, destinationRgb, sourceAlpha, destinationAlpha);
+    }
+    static void depthFunc(GLenum func)
+    {
+        if (update(state().shadow.depthFunc, func))
+            glDepthFunc(func);
+    }
+    static void depthMask(GLboolean mask)
+    {
+        if (update(state().shadow.depthMask, mask ? GL_TRUE : GL_FALSE))
+            glDepthMask(mask);
+    }
+    static void cullFace(GLenum mode)
+    {
+        if (update(state().shadow.cullFace, mode))
+            glCullFace(mode);
+    }
+    // core profile only has GL_FRONT_AND_BACK
+    static void polygonMode(GLenum mode)
+    {
+        if (update(state().shadow.polygonMode, mode))
+            glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+    static void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        const GLint values[4] = { x, y, width, height };
+        if (updateArray(state().shadow.viewport, values, 4))
+            glViewport(x, y, width, height);
+    }
+    static void scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        const GLint values[4] = { x, y, width, height };
+        if (updateArray(state().shadow.scissorBox, values, 4))
+            glScissor(x, y, width, height);
+    }
+
+    // counters
+    // ------------------------------------------------------------------------
+    // starts counting a new frame
+    static void beginFrame()
+    {
+        State& s = state();
+        s.lastFrame = s.frame;
+        s.total.issued += s.frame.issued;
+        s.total.elided += s.frame.elided;
+        s.frame.issued = 0;
+        s.frame.elided = 0;
+        ++s.frames;
+    }
+    // the calls of the last complete frame
+    static Counters lastFrame()
+    {
+        return state().lastFrame;
+    }
+    // the calls of every complete frame so far, and how many frames that was
+    static Counters total(unsigned long long& frames)
+    {
+        State& s = state();
+        frames = s.frames > 0 ? s.frames - 1 : 0;
+        return s.total;
+    }
+
+private:
+    struct State
+    {
+        Snapshot shadow;
+        Counters frame;
+        Counters lastFrame;
+        Counters total;
+        unsigned long long frames;
+    };
+
+    // header-only, so the shared state lives in a function-local static
+    static State& state()
+    {
+        static State s = initialState();
+        return s;
+    }
+    static State initialState()
+    {
+        State s;
+        s.shadow = unknownState();
+        s.frame.issued = s.frame.elided = 0;
+        s.lastFrame = s.frame;
+        s.total = s.frame;
+        s.frames = 0;
+        return s;
+    }
+
+    // counts the call and returns true (after updating the shadow) if it has to reach GL
+    static bool update(GLuint& shadow, GLuint value)
+    {
+        Counters& counters = state().frame;
+        if (shadow == value)
+        {
+            ++counters.elided;
+            return false;
+        }
+        shadow = value;
+        ++counters.issued;
+        return true;
+    }
+    template <typename T>
+    static bool updateArray(T* shadow, const T* values, int count)
+    {
+        Counters& counters = state().frame;
+        bool same = true;
+        for (int i = 0; i < count; ++i)
+            same = same && shadow[i] == values[i];
+        if (same)
+        {
+            ++counters.elided;
+            return false;
+        }
+        for (int i = 0; i < count; ++i)
+            shadow[i] = values[i];
+        ++counters.issued;
+        return true;
+    }
+    static void passThrough()
+    {
+        ++state().frame.issued;
+    }
+
+    static int bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return ARRAY_BUFFER_SLOT;
+        case GL_ELEMENT_ARRAY_BUFFER: return ELEMENT_BUFFER_SLOT;
+        case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER_SLOT;
+        case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK_BUFFER_SLOT;
+        default: return -1;
+        }
+    }
+    static GLenum bufferTarget(int slot)
+    {
+        static const GLenum targets[BUFFER_SLOT_COUNT] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_UNPACK_BUFFER };
+        return targets[slot];
+    }
+    static int textureSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return TEXTURE_2D_SLOT;
+        case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER_SLOT;
+        default: return -1;
+        }
+    }
+    static GLenum textureTarget(int slot)
+    {
+        return slot == TEXTURE_2D_SLOT ? GL_TEXTURE_2D : GL_TEXTURE_BUFFER;
+    }
+    static int capabilitySlot(GLenum capability)
+    {
+        for (int cap = 0; cap < CAPABILITY_COUNT; ++cap)
+            if (capabilityName(cap) == capability)
+                return cap;
+        return -1;
+    }
+    static GLenum capabilityName(int cap)
+    {
+        static const GLenum names[CAPABILITY_COUNT] = { GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_STENCIL_TEST, GL_SCISSOR_TEST,
+                                                        GL_PRIMITIVE_RESTART, GL_RASTERIZER_DISCARD, GL_PROGRAM_POINT_SIZE };
+        return names[cap];
+    }
+};
+#endif
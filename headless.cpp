@@ -0,0 +1,354 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    bool parseInt(const char* text, int minimum, int& value)
+    {
+        char* end = NULL;
+        long parsed = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || parsed < minimum || parsed > 1000000000L)
+            return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    // "all", or comma separated frame numbers and FIRST-LAST ranges
+    bool parseFrameList(const char* text, HeadlessOptions& options)
+    {
+        if (std::strcmp(text, "all") == 0)
+        {
+            options.dumpAll = true;
+            return true;
+        }
+        std::stringstream list(text);
+        std::string item;
+        while (std::getline(list, item, ','))
+        {
+            std::string::size_type dash = item.find('-', 1);
+            int first = 0;
+            int last = 0;
+            if (dash == std::string::npos)
+            {
+                if (!parseInt(item.c_str(), 0, first))
+                    return false;
+                last = first;
+            }
+            else if (!parseInt(item.substr(0, dash).c_str(), 0, first) || !parseInt(item.substr(dash + 1).c_str(), first, last))
+            {
+                return false;
+            }
+            for (int frame = first; frame <= last; ++frame)
+                options.dumpFrames.push_back(frame);
+        }
+        std::sort(options.dumpFrames.begin(), options.dumpFrames.end());
+        return !options.dumpFrames.empty();
+    }
+
+    void putBigEndian(std::vector<unsigned char>& out, unsigned int value)
+    {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc)
+    {
+        static unsigned int table[256];
+        static bool tableReady = false;
+        if (!tableReady)
+        {
+            for (unsigned int n = 0; n < 256; ++n)
+            {
+                unsigned int c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            tableReady = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+    {
+        std::vector<unsigned char> header;
+        putBigEndian(header, static_cast<unsigned int>(data.size()));
+        header.insert(header.end(), type, type + 4);
+        unsigned int crc = crc32(&header[4], 4, 0);
+        if (!data.empty())
+            crc = crc32(&data[0], data.size(), crc);
+        std::vector<unsigned char> trailer;
+        putBigEndian(trailer, crc);
+
+        file.write(reinterpret_cast<const char*>(&header[0]), header.size());
+        if (!data.empty())
+            file.write(reinterpret_cast<const char*>(&data[0]), data.size());
+        file.write(reinterpret_cast<const char*>(&trailer[0]), trailer.size());
+    }
+
+    double percentile(const std::vector<double>& sorted, double fraction)
+    {
+        size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    void printStats(std::ostream& out, const char* name, std::vector<double> seconds)
+    {
+        std::sort(seconds.begin(), seconds.end());
+        double sum = 0.0;
+        for (size_t i = 0; i < seconds.size(); ++i)
+            sum += seconds[i];
+        out << "  " << std::left << std::setw(4) << name << std::right << std::fixed << std::setprecision(3)
+            << " min " << seconds.front() * 1000.0 << " ms, mean " << sum / seconds.size() * 1000.0
+            << " ms, median " << percentile(seconds, 0.5) * 1000.0 << " ms, p95 " << percentile(seconds, 0.95) * 1000.0
+            << " ms, max " << seconds.back() * 1000.0 << " ms" << std::endl;
+    }
+}
+
+bool HeadlessOptions::shouldDump(int frame) const
+{
+    return dumpAll || std::binary_search(dumpFrames.begin(), dumpFrames.end(), frame);
+}
+
+std::string HeadlessOptions::imagePath(int frame) const
+{
+    std::ostringstream path;
+    path << outputPrefix << '_' << std::setw(4) << std::setfill('0') << frame << '.' << format;
+    return path.str();
+}
+
+bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options, std::string& error)
+{
+    error.clear();
+    bool hasWarmup = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h")
+            return false;
+        if (option == "--headless")
+        {
+            options.enabled = true;
+            continue;
+        }
+        if (option == "--gpu-fireflies")
+        {
+            options.gpuFireflies = true;
+            continue;
+        }
+
+        const char* valueOptions[] = { "--size", "--frames", "--warmup", "--seed", "--dt", "--dump", "--out", "--format", "--timings", "--scene",
+                                       "--check-fireflies" };
+        if (std::find(valueOptions, valueOptions + sizeof(valueOptions) / sizeof(valueOptions[0]), option) ==
+            valueOptions + sizeof(valueOptions) / sizeof(valueOptions[0]))
+        {
+            error = "unknown option " + option;
+            return false;
+        }
+        if (i + 1 >= argc)
+        {
+            error = "missing value for " + option;
+            return false;
+        }
+        const char* value = argv[++i];
+        bool valid = true;
+        if (option == "--size")
+        {
+            int width = 0;
+            int height = 0;
+            char end = 0;
+            valid = std::sscanf(value, "%dx%d%c", &width, &height, &end) == 2 && width > 0 && height > 0 && width <= 16384 && height <= 16384;
+            options.width = width;
+            options.height = height;
+        }
+        else if (option == "--frames")
+            valid = parseInt(value, 1, options.frames);
+        else if (option == "--warmup")
+        {
+            valid = parseInt(value, 0, options.warmupFrames);
+            hasWarmup = true;
+        }
+        else if (option == "--seed")
+        {
+            int seed = 0;
+            valid = parseInt(value, 0, seed);
+            options.seed = static_cast<unsigned int>(seed);
+            options.hasSeed = true;
+        }
+        else if (option == "--dt")
+        {
+            char* end = NULL;
+            options.frameSeconds = std::strtod(value, &end);
+            valid = end != value && *end == '\0' && options.frameSeconds > 0.0 && options.frameSeconds <= 1.0;
+        }
+        else if (option == "--dump")
+            valid = parseFrameList(value, options);
+        else if (option == "--out")
+            options.outputPrefix = value;
+        else if (option == "--format")
+        {
+            options.format = value;
+            valid = options.format == "ppm" || options.format == "png";
+        }
+        else if (option == "--scene")
+            options.scenePath = value;
+        else if (option == "--check-fireflies")
+            valid = parseInt(value, 1, options.fireflyCheckSteps);
+        else
+            options.timingsPath = value;
+
+        if (!valid)
+        {
+            error = "invalid value '" + std::string(value) + "' for " + option;
+            return false;
+        }
+    }
+
+    // the timing summary needs at least one frame after the warm-up
+    if (options.warmupFrames >= options.frames)
+    {
+        if (hasWarmup)
+        {
+            error = "--warmup must be less than --frames";
+            return false;
+        }
+        options.warmupFrames = options.frames - 1;
+    }
+    return true;
+}
+
+void printHeadlessUsage(std::ostream& out, const char* program)
+{
+    out << "usage: " << program << " [--headless] [options]\n"
+        << "  --headless           render offscreen for a fixed number of frames, then exit\n"
+        << "  --size WxH           framebuffer size (default 1280x960)\n"
+        << "  --frames N           frames to render (default 300)\n"
+        << "  --warmup N           leading frames left out of the timing summary (default 10, or frames - 1)\n"
+        << "  --seed S             random seed of the fireflies and balls (default: the scene's)\n"
+        << "  --dt SECONDS         simulated time per frame (default 1/60)\n"
+        << "  --dump LIST          frames to save: all, or e.g. 0,10,50-59\n"
+        << "  --out PREFIX         saved frames go to PREFIX_<frame>.<format> (default frame)\n"
+        << "  --format ppm|png     image format of saved frames (default ppm)\n"
+        << "  --timings FILE       write per-frame timings as CSV\n"
+        << "  --scene FILE         scene description to load, also without --headless (default default.scene)\n"
+        << "  --gpu-fireflies      simulate the fireflies on the GPU from the start, also without --headless\n"
+        << "  --check-fireflies N  with --headless: advance the fireflies N steps of --dt on the CPU and on the GPU\n"
+        << "                       from the same state, compare them and exit (status 1 if they differ)" << std::endl;
+}
+
+bool writePPM(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    file << "P6\n" << width << ' ' << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(&rgb[0]), static_cast<std::streamsize>(width) * height * 3);
+    return static_cast<bool>(file);
+}
+
+bool writePNG(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, static_cast<unsigned int>(width));
+    putBigEndian(header, static_cast<unsigned int>(height));
+    header.push_back(8); // bit depth
+    header.push_back(2); // color type: RGB
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // not interlaced
+    writeChunk(file, "IHDR", header);
+
+    // every row starts with filter type 0 (none); the zlib stream holds the
+    // rows in stored blocks of at most 65535 bytes
+    size_t rowBytes = static_cast<size_t>(width) * 3;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + y * rowBytes, rgb.begin() + (y + 1) * rowBytes);
+    }
+
+    std::vector<unsigned char> data;
+    data.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    data.push_back(0x78); // deflate, 32K window
+    data.push_back(0x01); // no preset dictionary, fastest level
+    unsigned int a = 1;
+    unsigned int b = 0;
+    size_t offset = 0;
+    do
+    {
+        size_t size = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + size == raw.size();
+        data.push_back(last ? 1 : 0);
+        data.push_back(static_cast<unsigned char>(size));
+        data.push_back(static_cast<unsigned char>(size >> 8));
+        data.push_back(static_cast<unsigned char>(~size));
+        data.push_back(static_cast<unsigned char>(~size >> 8));
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+        for (size_t i = offset; i < offset + size; ++i)
+        {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        offset += size;
+    } while (offset < raw.size());
+    putBigEndian(data, (b << 16) | a);
+    writeChunk(file, "IDAT", data);
+    writeChunk(file, "IEND", std::vector<unsigned char>());
+    return static_cast<bool>(file);
+}
+
+bool writeImage(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb)
+{
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0)
+        return writePNG(path, width, height, rgb);
+    return writePPM(path, width, height, rgb);
+}
+
+void FrameTimings::add(double cpuSeconds, double gpuSeconds)
+{
+    cpu.push_back(cpuSeconds);
+    gpu.push_back(gpuSeconds);
+}
+
+void FrameTimings::printSummary(std::ostream& out, size_t skipFrames) const
+{
+    if (cpu.size() <= skipFrames)
+    {
+        out << "Frame timings: no frames after " << skipFrames << " warm-up frames" << std::endl;
+        return;
+    }
+    out << "Frame timings over " << cpu.size() - skipFrames << " frames (" << skipFrames << " warm-up frames skipped):" << std::endl;
+    printStats(out, "cpu", std::vector<double>(cpu.begin() + skipFrames, cpu.end()));
+    printStats(out, "gpu", std::vector<double>(gpu.begin() + skipFrames, gpu.end()));
+}
+
+bool FrameTimings::writeCsv(const std::string& path) const
+{
+    std::ofstream file(path.c_str());
+    if (!file)
+        return false;
+    file << "frame,cpu_ms,gpu_ms\n" << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < cpu.size(); ++i)
+        file << i << ',' << cpu[i] * 1000.0 << ',' << gpu[i] * 1000.0 << '\n';
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Settings of the offscreen mode, in which the scene is rendered into a
+// framebuffer object for a fixed number of frames and the program exits.
+// Simulated time advances by exactly frameSeconds per frame and all random
+// state comes from seed, so two runs with the same options produce the same
+// images; only the timings differ.
+struct HeadlessOptions
+{
+    bool enabled;                 // --headless
+    int width;                    // --size WIDTHxHEIGHT
+    int height;
+    int frames;                   // --frames N
+    int warmupFrames;             // --warmup N: rendered, but left out of the timing summary
+    unsigned int seed;            // --seed S: seeds the fireflies and the balls instead of the scene's seeds
+    bool hasSeed;
+    double frameSeconds;          // --dt SECONDS: simulated time per frame
+    std::vector<int> dumpFrames;  // --dump LIST: frame numbers to save, e.g. "0,10,50-59" or "all"
+    bool dumpAll;
+    std::string outputPrefix;     // --out PREFIX: images are written to PREFIX_<frame>.<format>
+    std::string format;           // --format ppm|png
+    std::string timingsPath;      // --timings FILE: per-frame timings as CSV
+    std::string scenePath;        // --scene FILE: the scene description, with or without --headless
+    bool gpuFireflies;            // --gpu-fireflies: simulate the fireflies with transform feedback, with or without --headless
+    int fireflyCheckSteps;        // --check-fireflies N: advance the fireflies N steps on the CPU and the GPU, compare and exit
+
+    HeadlessOptions()
+        : enabled(false), width(1280), height(960), frames(300), warmupFrames(10), seed(1u), hasSeed(false),
+          frameSeconds(1.0 / 60.0), dumpAll(false), outputPrefix("frame"), format("ppm"), scenePath("default.scene"),
+          gpuFireflies(false), fireflyCheckSteps(0) {}
+
+    bool shouldDump(int frame) const;
+    std::string imagePath(int frame) const;
+};
+
+// Parses the command line. Returns false and sets error on a bad option; error
+// stays empty when --help was given. Without --headless the other options are
+// still parsed but, apart from --scene and --gpu-fireflies, have no effect.
+bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options, std::string& error);
+void printHeadlessUsage(std::ostream& out, const char* program);
+
+// Write tightly packed 8-bit RGB pixels, top row first. writeImage() picks the
+// format from the extension of path (.png, anything else is binary PPM). The
+// PNG encoder only uses stored deflate blocks: files are large, but it needs no
+// compression library and writing is as fast as the disk.
+bool writePPM(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb);
+bool writePNG(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb);
+bool writeImage(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb);
+
+// Collects per-frame times and prints min, mean, median, 95th percentile and
+// max. cpu is the time spent issuing a frame, gpu the time until glFinish()
+// returned for it, so it includes the driver and the GPU.
+class FrameTimings
+{
+public:
+    void add(double cpuSeconds, double gpuSeconds);
+    size_t count() const { return cpu.size(); }
+
+    // skips the first skipFrames frames
+    void printSummary(std::ostream& out, size_t skipFrames) const;
+    bool writeCsv(const std::string& path) const;
+
+private:
+    std::vector<double> cpu;
+    std::vector<double> gpu;
+};
+#endif
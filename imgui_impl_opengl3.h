@@ -41,6 +41,19 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateDeviceObjects();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyDeviceObjects();
 
+// (Optional) Replace the GL state backup of RenderDrawData(). By default it queries ~25 pieces of state with glGet*()/glIsEnabled()
+// before drawing and sets them back afterwards. With hooks installed it makes none of these queries: Backup is called before any
+// state is changed and Restore once the lists are drawn, with the framebuffer size the viewport was set to. The state left for
+// Restore is the one set in ImGui_ImplOpenGL3_SetupRenderState(), with texture unit 0 active, and the backend's own vertex array still bound.
+// Pass nullptr to go back to querying.
+struct ImGui_ImplOpenGL3_StateHooks
+{
+    void    (*Backup)(void* user_data);
+    void    (*Restore)(void* user_data, int fb_width, int fb_height);
+    void*   UserData;
+};
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_SetStateHooks(const ImGui_ImplOpenGL3_StateHooks* hooks);
+
 // Configuration flags to add in your imconfig file:
 //#define IMGUI_IMPL_OPENGL_ES2     // Enable ES 2 (Auto-detected on Emscripten)
 //#define IMGUI_IMPL_OPENGL_ES3     // Enable ES 3 (Auto-detected on iOS/Android)
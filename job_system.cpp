@@ -0,0 +1,124 @@
+#include "job_system.h"
+
+unsigned int JobSystem::defaultWorkerCount()
+{
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+JobSystem::JobSystem(unsigned int workerCount)
+    : nextQueue(0), queuedJobs(0), quit(false)
+{
+    for (unsigned int i = 0; i <= workerCount; ++i)
+        queues.push_back(new Queue());
+    for (unsigned int i = 0; i < workerCount; ++i)
+        workers.push_back(std::thread(&JobSystem::workerLoop, this, static_cast<size_t>(i)));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    for (size_t i = 0; i < queues.size(); ++i)
+        delete queues[i];
+}
+
+void JobSystem::parallelFor(size_t count, size_t chunkSize, JobFunction function, void* context, JobCounter& counter)
+{
+    if (chunkSize == 0)
+        chunkSize = 1;
+    size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+    counter.pending += static_cast<int>(chunkCount);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        Job job;
+        job.function = function;
+        job.context = context;
+        job.begin = chunk * chunkSize;
+        job.end = job.begin + chunkSize < count ? job.begin + chunkSize : count;
+        job.chunkIndex = chunk;
+        job.counter = &counter;
+        push(job);
+    }
+}
+
+void JobSystem::run(JobFunction function, void* context, JobCounter& counter)
+{
+    parallelFor(1, 1, function, context, counter);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    // the waiting thread helps instead of blocking
+    size_t self = queues.size() - 1;
+    while (counter.pending.load() > 0)
+    {
+        if (!tryRunOne(self))
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::push(const Job& job)
+{
+    // spread jobs round-robin; idle workers steal from whoever has work left
+    Queue* queue = queues[nextQueue++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->jobs.push_back(job);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        ++queuedJobs;
+    }
+    wake.notify_one();
+}
+
+bool JobSystem::tryRunOne(size_t self)
+{
+    Job job;
+    bool found = false;
+    // own queue from the back (most recently pushed), others from the front
+    for (size_t i = 0; i < queues.size() && !found; ++i)
+    {
+        Queue* queue = queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->jobs.empty())
+            continue;
+        if (i == 0)
+        {
+            job = queue->jobs.back();
+            queue->jobs.pop_back();
+        }
+        else
+        {
+            job = queue->jobs.front();
+            queue->jobs.pop_front();
+        }
+        found = true;
+    }
+    if (!found)
+        return false;
+
+    --queuedJobs;
+    job.function(job.context, job.begin, job.end, job.chunkIndex);
+    --job.counter->pending;
+    return true;
+}
+
+void JobSystem::workerLoop(size_t self)
+{
+    for (;;)
+    {
+        if (tryRunOne(self))
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return quit || queuedJobs.load() > 0; });
+        if (quit)
+            return;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the jobs of one batch that have not finished yet; JobSystem::wait()
+// returns once it drops to zero.
+struct JobCounter
+{
+    std::atomic<int> pending;
+    JobCounter() : pending(0) {}
+};
+
+// Persistent worker pool with per-worker work-stealing queues. Threads are
+// created once; submitting work only pushes small job records. A batch is a
+// range split into fixed-size chunks, and every chunk gets its index, so a job
+// can derive anything random from (seed, chunk index) and produce the same
+// result no matter which thread runs it or in what order.
+class JobSystem
+{
+public:
+    typedef void (*JobFunction)(void* context, size_t begin, size_t end, size_t chunkIndex);
+
+    // one worker per hardware thread, leaving one for the thread that waits
+    static unsigned int defaultWorkerCount();
+
+    // workerCount may be zero, in which case wait() runs every job itself
+    explicit JobSystem(unsigned int workerCount = defaultWorkerCount());
+    ~JobSystem();
+
+    // splits [0, count) into chunks of chunkSize and queues one job per chunk
+    void parallelFor(size_t count, size_t chunkSize, JobFunction function, void* context, JobCounter& counter);
+    // queues a single job covering [0, 1)
+    void run(JobFunction function, void* context, JobCounter& counter);
+    // runs queued jobs on the calling thread until the counter reaches zero
+    void wait(JobCounter& counter);
+
+    unsigned int workerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    struct Job
+    {
+        JobFunction function;
+        void* context;
+        size_t begin;
+        size_t end;
+        size_t chunkIndex;
+        JobCounter* counter;
+    };
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    // one queue per worker, plus a last one for threads outside the pool
+    std::vector<Queue*> queues;
+    std::atomic<unsigned int> nextQueue;
+    std::atomic<int> queuedJobs;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool quit;
+
+    void push(const Job& job);
+    bool tryRunOne(size_t self);
+    void workerLoop(size_t self);
+
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+};
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef LIGHT_CLUSTER_TEXTURES_H
+#define LIGHT_CLUSTER_TEXTURES_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "light_clusters.h"
+#include "shader.h"
+
+#include <cstddef>
+#include <vector>
+
+// Owns the texture buffers the lit shaders read a LightClusterGrid from:
+// the light data, the (first index, count) pair of every cluster and the
+// light index list, each bound to its fixed unit in SharedTextureUnit. The
+// buffers are respecified with every update, so a frame's upload does not
+// wait for the draws of the last one.
+class LightClusterTextures
+{
+public:
+    LightClusterTextures()
+    {
+        glGenBuffers(BUFFER_COUNT, buffers);
+        glGenTextures(BUFFER_COUNT, textures);
+        static const GLenum formats[BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+        for (int i = 0; i < BUFFER_COUNT; ++i)
+        {
+            // a texture buffer needs storage before it is attached
+            GLState::bindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+            GLState::bindTextureUnit(unit(i), GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+    }
+
+    // deletes the buffers and textures; call while the context is still current
+    void release()
+    {
+        glDeleteTextures(BUFFER_COUNT, textures);
+        glDeleteBuffers(BUFFER_COUNT, buffers);
+    }
+
+    // uploads the grid and makes sure the textures are bound to their units
+    void update(const LightClusterGrid& grid)
+    {
+        upload(LIGHT_DATA, grid.lightData());
+        upload(CLUSTERS, grid.clusterData());
+        upload(INDICES, grid.lightIndices());
+        for (int i = 0; i < BUFFER_COUNT; ++i)
+            GLState::bindTextureUnit(unit(i), GL_TEXTURE_BUFFER, textures[i]);
+    }
+
+private:
+    enum { LIGHT_DATA, CLUSTERS, INDICES, BUFFER_COUNT };
+
+    GLuint buffers[BUFFER_COUNT];
+    GLuint textures[BUFFER_COUNT];
+
+    static GLuint unit(int buffer)
+    {
+        static const GLuint units[BUFFER_COUNT] = { LIGHT_DATA_UNIT, LIGHT_CLUSTER_UNIT, LIGHT_INDEX_UNIT };
+        return units[buffer];
+    }
+
+    // empty lists keep a little storage, as a texture buffer without any is incomplete
+    template <typename T>
+    void upload(int buffer, const std::vector<T>& data)
+    {
+        GLState::bindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        if (data.empty())
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        else
+            glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(T), data.data(), GL_STREAM_DRAW);
+    }
+
+    LightClusterTextures(const LightClusterTextures&);
+    LightClusterTextures& operator=(const LightClusterTextures&);
+};
+#endif
@@ -0,0 +1,215 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LIGHT_CLUSTERS_X86 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // distance from value to the range [low, high] along one axis, 0 inside
+    float axisDistance(float value, float low, float high)
+    {
+        return std::max(std::max(low - value, value - high), 0.0f);
+    }
+
+    // pads the light lists of a row to a multiple of four with
+    // lights that reach nothing
+    void padToFour(std::vector<float>& position, std::vector<float>& reach, std::vector<uint16_t>& index)
+    {
+        while (position.size() % 4 != 0)
+        {
+            position.push_back(0.0f);
+            reach.push_back(-1.0f);
+            index.push_back(0);
+        }
+    }
+}
+
+LightClusterGrid::LightClusterGrid()
+    : clusters(2 * CLUSTER_COUNT, 0), maxLights(0), sliceScale(0.0f), sliceBias(0.0f), tileScaleX(1.0f), tileScaleY(1.0f)
+{
+}
+
+void LightClusterGrid::build(JobSystem& jobs, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+                             const PointLight* pointLights, size_t count)
+{
+    count = std::min(count, static_cast<size_t>(MAX_LIGHTS));
+    lights.resize(8 * count);
+    viewLights.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const PointLight& light = pointLights[i];
+        float* data = &lights[8 * i];
+        data[0] = light.position.x;
+        data[1] = light.position.y;
+        data[2] = light.position.z;
+        data[3] = light.radius;
+        data[4] = light.color.x;
+        data[5] = light.color.y;
+        data[6] = light.color.z;
+        data[7] = 0.0f;
+        glm::vec4 position = view * glm::vec4(light.position, 1.0f);
+        viewLights[i] = glm::vec4(position.x, position.y, -position.z, light.radius);
+    }
+
+    // slice s spans depths near * (far / near)^(s / SLICES) to the next one
+    float depthRatio = std::log(farPlane / nearPlane);
+    sliceScale = SLICES / depthRatio;
+    sliceBias = -std::log(nearPlane) * sliceScale;
+    for (int s = 0; s < SLICES; ++s)
+    {
+        slices[s].nearDepth = nearPlane * std::exp(depthRatio * s / SLICES);
+        slices[s].farDepth = nearPlane * std::exp(depthRatio * (s + 1) / SLICES);
+    }
+    tileScaleX = 1.0f / projection[0][0];
+    tileScaleY = 1.0f / projection[1][1];
+
+    JobCounter counter;
+    jobs.parallelFor(SLICES, 1, sliceJob, this, counter);
+    jobs.wait(counter);
+
+    // the slices found their indices independently; concatenate them
+    size_t total = 0;
+    for (int s = 0; s < SLICES; ++s)
+        total += slices[s].indices.size();
+    indices.clear();
+    indices.reserve(total);
+    maxLights = 0;
+    for (int s = 0; s < SLICES; ++s)
+    {
+        const Slice& slice = slices[s];
+        uint32_t* cluster = &clusters[2 * s * TILES_X * TILES_Y];
+        uint32_t first = static_cast<uint32_t>(indices.size());
+        for (int tile = 0; tile < TILES_X * TILES_Y; ++tile)
+        {
+            cluster[2 * tile] = first;
+            cluster[2 * tile + 1] = slice.counts[tile];
+            first += slice.counts[tile];
+            maxLights = std::max(maxLights, static_cast<size_t>(slice.counts[tile]));
+        }
+        indices.insert(indices.end(), slice.indices.begin(), slice.indices.end());
+    }
+}
+
+glm::vec4 LightClusterGrid::clusterScale(int width, int height) const
+{
+    return glm::vec4(static_cast<float>(TILES_X) / static_cast<float>(std::max(width, 1)),
+                     static_cast<float>(TILES_Y) / static_cast<float>(std::max(height, 1)), sliceScale, sliceBias);
+}
+
+// one slice
+// ------------------------------------------------------------------------
+// The sphere-box distance is split by axis: the depth part is the same for
+// every cluster of the slice and the y part for every cluster of a row, so
+// what is left of the squared radius is carried along and only x is tested
+// per cluster.
+void LightClusterGrid::assignSlice(size_t s)
+{
+    Slice& slice = slices[s];
+    slice.indices.clear();
+
+    // lights that reach into the slice's depth range
+    slice.x.clear();
+    slice.y.clear();
+    slice.reach.clear();
+    slice.lightIndex.clear();
+    for (size_t i = 0; i < viewLights.size(); ++i)
+    {
+        const glm::vec4& light = viewLights[i];
+        float dz = axisDistance(light.z, slice.nearDepth, slice.farDepth);
+        float reach = light.w * light.w - dz * dz;
+        if (reach < 0.0f)
+            continue;
+        slice.x.push_back(light.x);
+        slice.y.push_back(light.y);
+        slice.reach.push_back(reach);
+        slice.lightIndex.push_back(static_cast<uint16_t>(i));
+    }
+
+    // the view space x and y of a tile edge are linear in depth, so a
+    // cluster's bounds are those of its edges at the slice's near and far depth
+    const float nearDepth = slice.nearDepth, farDepth = slice.farDepth;
+    const size_t sliceLights = slice.x.size();
+    for (int row = 0; row < TILES_Y; ++row)
+    {
+        uint32_t* counts = slice.counts + row * TILES_X;
+        float bottom = (-1.0f + 2.0f * row / TILES_Y) * tileScaleY;
+        float top = (-1.0f + 2.0f * (row + 1) / TILES_Y) * tileScaleY;
+        float low = std::min(bottom * nearDepth, bottom * farDepth);
+        float high = std::max(top * nearDepth, top * farDepth);
+
+        // written branch free like the clusters below
+        slice.rowX.resize(sliceLights);
+        slice.rowReach.resize(sliceLights);
+        slice.rowIndex.resize(sliceLights);
+        size_t kept = 0;
+        for (size_t k = 0; k < sliceLights; ++k)
+        {
+            float dy = axisDistance(slice.y[k], low, high);
+            float reach = slice.reach[k] - dy * dy;
+            slice.rowX[kept] = slice.x[k];
+            slice.rowReach[kept] = reach;
+            slice.rowIndex[kept] = slice.lightIndex[k];
+            kept += reach >= 0.0f ? 1 : 0;
+        }
+        if (kept == 0)
+        {
+            std::fill(counts, counts + TILES_X, 0u);
+            continue;
+        }
+        slice.rowX.resize(kept);
+        slice.rowReach.resize(kept);
+        slice.rowIndex.resize(kept);
+        padToFour(slice.rowX, slice.rowReach, slice.rowIndex);
+        const size_t rowLights = slice.rowX.size();
+
+        for (int column = 0; column < TILES_X; ++column)
+        {
+            float left = (-1.0f + 2.0f * column / TILES_X) * tileScaleX;
+            float right = (-1.0f + 2.0f * (column + 1) / TILES_X) * tileScaleX;
+            float xLow = std::min(left * nearDepth, left * farDepth);
+            float xHigh = std::max(right * nearDepth, right * farDepth);
+            // every light is written and the end only advanced past the ones
+            // that hit, which keeps unpredictable branches out of the loop
+            size_t before = slice.indices.size(), found = before;
+            slice.indices.resize(before + rowLights);
+            uint16_t* out = &slice.indices[0];
+#ifdef LIGHT_CLUSTERS_X86
+            const __m128 lowX = _mm_set1_ps(xLow);
+            const __m128 highX = _mm_set1_ps(xHigh);
+            const __m128 zero = _mm_setzero_ps();
+            for (size_t k = 0; k < rowLights; k += 4)
+            {
+                __m128 x = _mm_loadu_ps(&slice.rowX[k]);
+                __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(lowX, x), _mm_sub_ps(x, highX)), zero);
+                int hits = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), _mm_loadu_ps(&slice.rowReach[k])));
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    out[found] = slice.rowIndex[k + lane];
+                    found += (hits >> lane) & 1;
+                }
+            }
+#else
+            for (size_t k = 0; k < rowLights; ++k)
+            {
+                float dx = axisDistance(slice.rowX[k], xLow, xHigh);
+                out[found] = slice.rowIndex[k];
+                found += dx * dx <= slice.rowReach[k] ? 1 : 0;
+            }
+#endif
+            slice.indices.resize(found);
+            counts[column] = static_cast<uint32_t>(found - before);
+        }
+    }
+}
+
+void LightClusterGrid::sliceJob(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+{
+    LightClusterGrid* grid = static_cast<LightClusterGrid*>(context);
+    for (size_t slice = begin; slice < end; ++slice)
+        grid->assignSlice(slice);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+// A point light with a finite range: it lights nothing farther than radius
+// from its position. color already includes the intensity.
+struct PointLight
+{
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+};
+
+// Clustered light assignment for forward shading. The view frustum is cut
+// into TILES_X x TILES_Y screen tiles and SLICES depth slices whose
+// thickness grows exponentially with distance ("froxels"); every cluster
+// gets the list of lights whose sphere touches its view space bounding box.
+// A fragment then finds its cluster from its window position and view depth
+// and loops over that list only, so its cost depends on the lights near it
+// rather than on all the lights.
+//
+// The slices are built as jobs, each testing four lights at a time against
+// the clusters with SSE where available. Needs no GL context; the results
+// are laid out for texture buffers (see LightClusterTextures):
+//   lightData()     two RGBA32F texels per light: position and radius, colour
+//   clusterData()   two RG32UI values per cluster: first index and light count,
+//                   clusters ordered by slice, then row, then column
+//   lightIndices()  R16UI light indices, cluster after cluster
+class LightClusterGrid
+{
+public:
+    enum { TILES_X = 16, TILES_Y = 8, SLICES = 24, CLUSTER_COUNT = TILES_X * TILES_Y * SLICES };
+    enum { MAX_LIGHTS = 4096 };  // indices are 16 bits; lights beyond this are dropped
+
+    LightClusterGrid();
+
+    // assigns lights to the clusters of a symmetric perspective projection
+    // with the given near and far planes
+    void build(JobSystem& jobs, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+               const PointLight* lights, size_t count);
+
+    // (TILES_X / width, TILES_Y / height, slice scale, slice bias): a fragment's
+    // cluster is (gl_FragCoord.xy * xy, log(view depth) * z + w)
+    glm::vec4 clusterScale(int width, int height) const;
+
+    const std::vector<float>& lightData() const { return lights; }
+    const std::vector<uint32_t>& clusterData() const { return clusters; }
+    const std::vector<uint16_t>& lightIndices() const { return indices; }
+
+    size_t lightCount() const { return lights.size() / 8; }
+    size_t indexCount() const { return indices.size(); }
+    size_t maxClusterLights() const { return maxLights; }
+
+private:
+    // one depth slice: its depth range, the lights that reach into it with
+    // what is left of their squared radius there, the same for the row being
+    // assigned (padded to a multiple of four with lights that reach nothing),
+    // and the indices and counts it found, before merging
+    struct Slice
+    {
+        float nearDepth, farDepth;
+        std::vector<float> x, y, reach;
+        std::vector<uint16_t> lightIndex;
+        std::vector<float> rowX, rowReach;
+        std::vector<uint16_t> rowIndex;
+        std::vector<uint16_t> indices;
+        uint32_t counts[TILES_X * TILES_Y];
+    };
+
+    std::vector<float> lights;
+    std::vector<uint32_t> clusters;
+    std::vector<uint16_t> indices;
+    size_t maxLights;
+    float sliceScale, sliceBias;
+    float tileScaleX, tileScaleY;   // view space x and y per unit of depth at NDC +1
+
+    // the arguments of the build() in progress, for its jobs
+    std::vector<glm::vec4> viewLights;  // view space position (depth positive) and radius
+    Slice slices[SLICES];
+
+    void assignSlice(size_t slice);
+
+    static void sliceJob(void* context, size_t begin, size_t end, size_t chunkIndex);
+
+    LightClusterGrid(const LightClusterGrid&);
+    LightClusterGrid& operator=(const LightClusterGrid&);
+};
+#endif
@@ -2,14 +2,11 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
-uniform vec4 ourColor;
 out  vec4 color;
 
 void main()
 {
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	color = ourColor;
+	color = vec4(lightColor.rgb, 1.0);
 }
\ No newline at end of file
@@ -4,29 +4,32 @@ out vec4 FragColor;
 in vec3 Normal;  
 in vec3 FragPos;  
   
-uniform vec3 lightPos; 
-uniform vec3 viewPos; 
-uniform vec3 lightColor;
 uniform vec3 objectColor;
 
 void main()
 {
     // 
     float ambientStrength = 0.5;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * lightColor.rgb;
   	
     //  
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 lightDir = normalize(lightPos.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.rgb;
     
     // 淴
     float specularStrength = 0.7;
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;  
+    vec3 specular = specularStrength * spec * lightColor.rgb;  
+
+    // point lights
+    vec3 clusterDiffuse = vec3(0.0), clusterSpecular = vec3(0.0);
+    addClusterLights(FragPos, norm, viewDir, clusterDiffuse, clusterSpecular);
+    diffuse += clusterDiffuse;
+    specular += specularStrength * clusterSpecular;
         
     vec3 result = (ambient + diffuse + specular) * objectColor;
     FragColor = vec4(result, 1.0);
@@ -7,6 +7,27 @@
 
 #include "shader.h"
 #include "camera.h"
+#include "frame_data.h"
+#include "firefly_sim.h"
+#include "firefly_feedback.h"
+#include "job_system.h"
+#include "ball_sim.h"
+#include "fixed_step.h"
+#include "sphere_mesh.h"
+#include "scene_geometry.h"
+#include "scene_simulation.h"
+#include "shader_registry.h"
+#include "texture_loader.h"
+#include "offscreen_target.h"
+#include "headless.h"
+#include "frame_profiler.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "culling.h"
+#include "occlusion.h"
+#include "light_clusters.h"
+#include "light_cluster_textures.h"
+#include "scene_file.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -16,21 +37,44 @@
 #include "imgui_impl_opengl3.h"
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <vector>
 #include <cmath>
 #include <cstdlib>
+#include <cstddef>
+#include <cstring>
 #include <ctime>
+#include <string>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-void generateChalkboardVertices();
-void generateFrameVertices();
 void generateSnowflakes(int count);
-void updateSnowflakes();
-void updateBallPosition();
-std::vector<float> generateSphereVertices(float radius, int sectorCount, int stackCount);
+void updateSnowflakes(JobCounter& counter, float stepSeconds);
+FireflyBounds fireflyBounds();
+void setupFireflyBuffers(unsigned int flakeVAO, unsigned int flakePositionVBO, unsigned int flakeAttributeVBO);
+bool checkGpuFireflies(FireflyFeedback& feedback, int steps, float stepSeconds);
+BallBounds ballBounds();
+struct SimulationSnapshot;
+void kickSimulation(JobCounter& counter, float stepSeconds, bool updateFirefliesOnCpu);
+void simulationStep(void* context, float stepSeconds, bool lastSubstep);
+void simulationPublish(void* context, double time, float stepSeconds);
+void applyScene(const CompiledScene& scene);
+void gatherFireflyLights(const SimulationSnapshot& snapshot, float interpolation, std::vector<PointLight>& lights);
+struct SceneUniforms;
+void setupWalls(const DrawPacket& packet, void* context);
+void setupLightCube(const DrawPacket& packet, void* context);
+void setupChalkboard(const DrawPacket& packet, void* context);
+void setupFrame(const DrawPacket& packet, void* context);
+void setupWindmill(const DrawPacket& packet, void* context);
+void setupFireflies(const DrawPacket& packet, void* context);
+void setupBalls(const DrawPacket& packet, void* context);
+void saveStateForImGui(void* userData);
+void restoreStateAfterImGui(void* userData, int fbWidth, int fbHeight);
 
 // 
 const unsigned int SCR_WIDTH = 1280;
@@ -61,8 +105,67 @@ ImVec4 left_color = ImVec4(1.0f, 0.0f, 0.0f, 1.0f);
 ImVec4 front_color = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
 ImVec4 right_color = ImVec4(0.0f, 1.0f, 0.0f, 1.0f);
 ImVec4 windmill_color = ImVec4(0.314f, 0.902f, 0.192f, 1.0f);
-ImVec4 ball_color = ImVec4(1.0f, 0.0f, 0.0f, 1.0f);
+ImVec4 ball_color = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
 float scale = 2.0f;
+bool showProfiler = true;
+
+// ֡ͳƵȾ׶Σÿ׶ζ CPU ʱ GPU ʱѯ
+enum RenderPass {
+	PASS_WALLS,
+	PASS_LIGHT_CUBE,
+	PASS_CHALKBOARD,
+	PASS_FRAME,
+	PASS_WINDMILL,
+	PASS_FIREFLIES,
+	PASS_BALLS,
+	PASS_IMGUI,
+	PASS_COUNT
+};
+const char* renderPassNames[PASS_COUNT] = { "walls", "light cube", "chalkboard", "frame", "windmill", "fireflies", "balls", "imgui" };
+
+// Ⱦִʱ setup  uniform õݣÿ֡ύǰ
+struct SceneUniforms {
+	const Shader* roomShader;
+	const Shader* lightCubeShader;
+	const Shader* textureShader;
+	const Shader* lightingShader;
+	const Shader* snowflakeShader;
+	const Shader* ballShader;
+	glm::mat4 wallModel;
+	glm::vec3 wallColors[WALL_COUNT];
+	glm::mat4 lightCubeModel;
+	glm::mat4 chalkboardModel;
+	glm::mat4 frameModel;
+	glm::mat4 windmillModel;
+	glm::vec3 windmillColor;       // ɫǰɫ
+	float time;
+	float fireflyInterpolation;
+	float interpolation;
+	glm::vec3 ballTint;
+	unsigned int ballInstanceVBO;
+};
+const float nearPlane = 0.1f;
+const float farPlane = 100.0f;
+
+// ׶޳Ķţ̶ǰ֮ÿСռһ
+enum CullObject {
+	CULL_WALLS,
+	CULL_LIGHT_CUBE,
+	CULL_CHALKBOARD,
+	CULL_FRAME,
+	CULL_WINDMILL,
+	CULL_FIREFLIES,
+	CULL_FIRST_BALL
+};
+bool frustumCulling = true;
+// ڵ޳п׶ڵʱ޳Ĳʮ֮һʱͣ֡
+bool occlusionCulling = true;
+const size_t occlusionMinObjects = 64;
+const int occlusionRetryFrames = 8;
+
+// ǽã WallMaterial  scene_geometry.h
+std::vector<float> roomVertices;        // λá
+std::vector<unsigned int> roomIndices;
 
 // ڰ
 std::vector<float> chalkboardVertices;
@@ -72,6 +175,8 @@ glm::vec3 chalkboardPosition(0.0f, 0.3f, 1.51f); // Slightly in front of the fro
 std::vector<float> frameVertices;
 glm::vec3 frameSize(1.05f, 0.65f, 0.05f); // ȺڰԴ
 glm::vec3 frameThickness(0.05f, 0.05f, 0.05f); // ߿ĺ
+std::string chalkboardTexturePath = "board_texture.jpg";
+std::string frameTexturePath = "frame_texture.jpg";
 
 // 糵
 // 糵ͼεĶ
@@ -115,33 +220,105 @@ bool drawWindmill = false;
 float currentAngle = 0.0f;
 bool drawColor = false;
 
-// Snowflake structure
-struct Snowflake {
-	float x, y, z; // Position of the snowflake
-	float size; // Size of the snowflake
-	float speed; // Falling speed of the snowflake
-};
-// Vector to hold snowflakes
-std::vector<Snowflake> snowflakes;
+// ө棨SoA Ӵ洢 SIMD ں˸£
+FireflyStore fireflies;
+int fireflyCount = 100;
+unsigned int fireflySeed = 1u;
+bool gpuFireflies = false; // ʹñ任 GPU ģө
 bool drawSnow = true;
-
-struct Ball {
-	glm::vec3 position;
-	glm::vec3 velocity;
-	float radius;
-};
-Ball ball = {
-		glm::vec3(0.0f, 0.3f, 2.0f),  // Initial position at the center
-		glm::vec3(0.1f, 0.2f, 0.3f), // Initial velocity
-		0.3f // Ball radius
-};
+// өΪԴΧֻȡǰִֻعÿƬֻڴڵĹԴ
+bool fireflyLights = true;
+const size_t maxFireflyLights = 512;
+const float fireflyLightRadius = 0.3f;
+const glm::vec3 fireflyLightColor(0.49f, 0.29f, 0.049f); // өɫһ
+
+// פ̳߳أģ̰߳ө水̶Сֿ飬Сһи
+JobSystem jobSystem;
+FireflyStep fireflyStep;
+
+// СϵͳÿСиԵİ뾶ɫ˴˵ײ
+BallSystem balls;
+int ballCount = 16;
+// һɵСֻȾ̶߳дballs.count() ᱻģ̸߳Ķܲȡ
+int generatedBallCount = 0;
+unsigned int ballSeed = 1u;
 bool drawBall = true;
-void updateBallPosition(Ball& ball);
-
-int main()
+// С LOD 𣨾߶ x γ߶ɴֵϸ
+const int sphereLodLevels[][2] = { { 8, 4 }, { 16, 8 }, { 32, 16 }, { 64, 32 }, { 128, 64 } };
+const float sphereLodEdgePixels = 8.0f; // α߳Ļϲ
+BallStep ballStep;
+
+// ̶ģ⣺̶̰߳Ƶƽө桢С糵ÿ󷢲һݿգ
+// Ⱦ߳ڿյһһֵ֮Ⱦ֡ģƵʻӰ
+struct SimulationSnapshot {
+	double time;               // һʱ䣨FixedStepThread::now ʱӣ
+	float stepSeconds;
+	float previousAngle;
+	float currentAngle;
+	bool firefliesOnCpu;       // Ϊ false ʱө GPU ģ⣬ûөλ
+	unsigned int fireflyGeneration;
+	std::vector<float> fireflyPositions; // µ xyz Σ֮һ xyz 
+	size_t ballCount;
+	size_t ballContacts;
+	std::vector<float> ballInstances;    // λá뾶ɫһλĶ
+	SimulationSnapshot()
+		: time(0.0), stepSeconds(1.0f), previousAngle(0.0f), currentAngle(0.0f), firefliesOnCpu(false),
+		  fireflyGeneration(0), ballCount(0), ballContacts(0) {}
+};
+FixedStepThread simulation;
+TripleBuffer<SimulationSnapshot> snapshots;
+int simulationRate = 60;
+int maxSubsteps = 4;
+// ״̬Ⱦ߳ڳ simulation.stateMutex() ʱ޸
+bool firefliesOnCpu = true;
+unsigned int fireflyGeneration = 1; // ÿɼһжϿǷ뵱ǰ岼һ
+// Ⱦ߳ÿ֡д롢ģ̶߳ȡķ糵
+std::atomic<bool> windmillSpinning(false);
+std::atomic<float> windmillSpeed(1.0f);
+
+int main(int argc, char* argv[])
 {
+	// в--headless ʱȾ֡壬̶֡֡ʱ䲢˳
+	// ------------------------------
+	HeadlessOptions headless;
+	std::string optionError;
+	if (!parseHeadlessOptions(argc, argv, headless, optionError))
+	{
+		if (!optionError.empty())
+			std::cout << optionError << std::endl;
+		printHeadlessUsage(std::cout, argv[0]);
+		return optionError.empty() ? 0 : 1;
+	}
+
+	// ӳõ .cscene ֱʹãıʱ±룻ʱó
+	// ϸȫֱĳʼֵó
+	// ------------------------------
+	CompiledScene scene;
+	std::string sceneError;
+	std::chrono::steady_clock::time_point sceneStart = std::chrono::steady_clock::now();
+	bool sceneLoaded = loadScene(headless.scenePath.c_str(), scene, sceneError);
+	if (sceneLoaded)
+		applyScene(scene);
+	else
+		std::cout << "SCENE::LOAD_FAILED " << sceneError << ", using the built-in scene" << std::endl;
+	const double sceneSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sceneStart).count();
+	if (headless.hasSeed)
+	{
+		fireflySeed = headless.seed;
+		ballSeed = headless.seed;
+	}
+	if (headless.gpuFireflies)
+		gpuFireflies = true; // һ֡л GPU ģ⣬빴ѡϵѡͬ
+
 	// ʼglfw
 	// ------------------------------
+	bool surfaceless = false;
+#if defined(GLFW_PLATFORM_NULL) && defined(__linux__)
+	// ģʽûʾʱû GPU Ĺ GLFW 3.4 Ŀƽ̨ EGL ޱģMesa llvmpipe
+	surfaceless = headless.enabled && !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY") && glfwPlatformSupported(GLFW_PLATFORM_NULL);
+	if (surfaceless)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -150,10 +327,19 @@ int main()
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+	// ģʽֻҪģڱأȾ̶С֡
+	if (headless.enabled)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#if defined(GLFW_PLATFORM_NULL) && defined(__linux__)
+	if (surfaceless)
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
 
 	// glfw
 	// --------------------
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+	const int renderWidth = headless.enabled ? headless.width : static_cast<int>(SCR_WIDTH);
+	const int renderHeight = headless.enabled ? headless.height : static_cast<int>(SCR_HEIGHT);
+	GLFWwindow* window = glfwCreateWindow(renderWidth, renderHeight, "LearnOpenGL", NULL, NULL);
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -175,31 +361,61 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	// ֮Ⱦ״̬״̬Ӱãظĵòᵽ
+	GLState::reset();
 
 	//imgui init
 	// Setup Dear ImGui context
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
+	if (headless.enabled)
+		io.IniFilename = NULL; // вд imgui.ini
 	// Setup Dear ImGui style
 	ImGui::StyleColorsDark();
 	// Setup Platform/Renderer backends
 	ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init(glsl_version);
+	// imgui ˲ glGet ״̬Ϊ״̬Ӱӱָ
+	GLState::Snapshot stateBeforeImGui;
+	ImGui_ImplOpenGL3_StateHooks imguiStateHooks = { saveStateForImGui, restoreStateAfterImGui, &stateBeforeImGui };
+	ImGui_ImplOpenGL3_SetStateHooks(&imguiStateHooks);
 
 	// ȫ OpenGL ״̬
 	// -----------------------------
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_PROGRAM_POINT_SIZE);
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::enable(GL_PROGRAM_POINT_SIZE);
 
-	// shader
+	// shaderӺõĳƻڴϣٴʱֱ
 	// ------------------------------------
+	ProgramBinaryCache::setDirectory("shader_cache");
 	Shader lightingShader("lighting_vertex.glsl", "lighting_fragment.glsl");
+	Shader roomShader("room_vertex.glsl", "room_fragment.glsl");
 	Shader lightCubeShader("lightcube_vertex.glsl", "lightcube_fragment.glsl");
 	Shader textureShader("board_vertex.glsl", "board_fragment.glsl");
 	Shader snowflakeShader("snowflake_vertex.glsl", "snowflake_fragment.glsl");
 	Shader ballShader("ball_vertex.glsl", "ball_fragment.glsl");
 
+	// ɫÿ֡ƹ
+	FrameUniformBuffer frameUniforms;
+	// ִعգ׶ĻֿȷƬɴأÿ֡ CPU ÿЩԴӰ죬
+	// ԴݡصΧУƬɫֻڴصĹԴ
+	LightClusterGrid lightClusters;
+	LightClusterTextures lightClusterTextures;
+	std::vector<PointLight> pointLights;
+	double lightClusterSeconds = 0.0;
+	// ׶ε CPU/GPU ֡ʱ
+	FrameProfiler profiler(std::vector<std::string>(renderPassNames, renderPassNames + PASS_COUNT));
+	// ÿ֡Ļٵ״̬лִ
+	RenderQueue renderQueue;
+	SceneUniforms sceneUniforms;
+	sceneUniforms.roomShader = &roomShader;
+	sceneUniforms.lightCubeShader = &lightCubeShader;
+	sceneUniforms.textureShader = &textureShader;
+	sceneUniforms.lightingShader = &lightingShader;
+	sceneUniforms.snowflakeShader = &snowflakeShader;
+	sceneUniforms.ballShader = &ballShader;
+
 	// ͳһõϢ(ÿһǰΪ꣬Ϊ)
 	// ------------------------------------------------------------------
 	float vertices[] = {
@@ -247,133 +463,45 @@ int main()
 		-0.5f * scale,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
 	};
 
-	//ȡƽ
-	// ------------------------------------------------------------------
-	float CeilingVertices[36];
-	std::copy(vertices + 180, vertices + 216, CeilingVertices);
-	float FloorVertices[36];
-	std::copy(vertices + 144, vertices + 180, FloorVertices);
-	float LWallVertices[36];
-	std::copy(vertices + 72, vertices + 108, LWallVertices);
-	float RWallVertices[36];
-	std::copy(vertices + 108, vertices + 144, RWallVertices);
-	float FWallVertices[36];
-	std::copy(vertices + 0, vertices + 36, FWallVertices);
-
-	// 컨ĶϢ
-	// ------------------------------------------------------------------
-	unsigned int VBO1, CeilingVAO;
-	{
-		glGenVertexArrays(1, &CeilingVAO);
-		glGenBuffers(1, &VBO1);
-
-		glBindBuffer(GL_ARRAY_BUFFER, VBO1);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(CeilingVertices), CeilingVertices, GL_STATIC_DRAW);
-
-		glBindVertexArray(CeilingVAO);
-
-		// λ
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-		// 뷨
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-	}
-
-	//ذĶϢ
-	// ------------------------------------------------------------------
-	unsigned int VBO2, FloorVAO;
-	{
-		glGenVertexArrays(1, &FloorVAO);
-		glGenBuffers(1, &VBO2);
-
-		glBindBuffer(GL_ARRAY_BUFFER, VBO2);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(FloorVertices), FloorVertices, GL_STATIC_DRAW);
-
-		glBindVertexArray(FloorVAO);
-
-		// λ
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-		// 뷨
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-	}
-
-	//ǽĶϢ
-	// ------------------------------------------------------------------
-	unsigned int VBO3, LWallVAO;
-	{
-		glGenVertexArrays(1, &LWallVAO);
-		glGenBuffers(1, &VBO3);
-
-		glBindBuffer(GL_ARRAY_BUFFER, VBO3);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(LWallVertices), LWallVertices, GL_STATIC_DRAW);
-
-		glBindVertexArray(LWallVAO);
-
-		// λ
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-		// 뷨
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-	}
-
-	//ǽĶϢ
+	// ǽϲΪһľ̬ÿǽ
 	// ------------------------------------------------------------------
-	unsigned int VBO4, RWallVAO;
+	unsigned int roomVAO, roomVBO, roomEBO;
 	{
-		glGenVertexArrays(1, &RWallVAO);
-		glGenBuffers(1, &VBO4);
-
-		glBindBuffer(GL_ARRAY_BUFFER, VBO4);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(RWallVertices), RWallVertices, GL_STATIC_DRAW);
+		generateRoomMesh(vertices, roomVertices, roomIndices);
+		glGenVertexArrays(1, &roomVAO);
+		glGenBuffers(1, &roomVBO);
+		glGenBuffers(1, &roomEBO);
 
-		glBindVertexArray(RWallVAO);
+		GLState::bindVertexArray(roomVAO);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, roomVBO);
+		glBufferData(GL_ARRAY_BUFFER, roomVertices.size() * sizeof(float), roomVertices.data(), GL_STATIC_DRAW);
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, roomEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, roomIndices.size() * sizeof(unsigned int), roomIndices.data(), GL_STATIC_DRAW);
 
 		// λ
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0 * sizeof(float)));
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(0 * sizeof(float)));
 		glEnableVertexAttribArray(0);
 		// 뷨
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-	}
-
-	//ǰǽĶϢ
-	// ------------------------------------------------------------------
-	unsigned int VBO5, FWallVAO;
-	{
-		glGenVertexArrays(1, &FWallVAO);
-		glGenBuffers(1, &VBO5);
-
-		glBindBuffer(GL_ARRAY_BUFFER, VBO5);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(FWallVertices), FWallVertices, GL_STATIC_DRAW);
-
-		glBindVertexArray(FWallVAO);
-
-		// λ
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-		// 뷨
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
 		glEnableVertexAttribArray(1);
+		// 
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(6 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+		GLState::bindVertexArray(0);
 	}
 
-
-
 	// 뷽ƵĶϢ
 	unsigned int VBO6, lightCubeVAO;
 	{
 		glGenVertexArrays(1, &lightCubeVAO);
 		glGenBuffers(1, &VBO6);
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO6);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, VBO6);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-		glBindVertexArray(lightCubeVAO);
+		GLState::bindVertexArray(lightCubeVAO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO6);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, VBO6);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
 	}
@@ -384,8 +512,8 @@ int main()
 		glGenVertexArrays(1, &windmillVAO);
 		glGenBuffers(1, &windmillVBO);
 
-		glBindVertexArray(windmillVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, windmillVBO);
+		GLState::bindVertexArray(windmillVAO);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, windmillVBO);
 		glBufferData(GL_ARRAY_BUFFER, windmillVertices.size() * sizeof(float), windmillVertices.data(), GL_STATIC_DRAW);
 
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -396,12 +524,12 @@ int main()
 	// ------------------------------------------------------------------
 	unsigned int chalkboardVAO, chalkboardVBO;
 	{
-		generateChalkboardVertices();
+		chalkboardVertices = generateChalkboardVertices(chalkboardSize);
 		glGenVertexArrays(1, &chalkboardVAO);
 		glGenBuffers(1, &chalkboardVBO);
 
-		glBindVertexArray(chalkboardVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, chalkboardVBO);
+		GLState::bindVertexArray(chalkboardVAO);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, chalkboardVBO);
 		glBufferData(GL_ARRAY_BUFFER, chalkboardVertices.size() * sizeof(float), chalkboardVertices.data(), GL_STATIC_DRAW);
 
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0); // λ
@@ -416,12 +544,12 @@ int main()
 	unsigned int frameVAO, frameVBO;
 	{
 		// ɱ߿򶥵
-		generateFrameVertices();
+		frameVertices = generateFrameVertices(frameSize, frameThickness.x);
 		glGenVertexArrays(1, &frameVAO);
 		glGenBuffers(1, &frameVBO);
 
-		glBindVertexArray(frameVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, frameVBO);
+		GLState::bindVertexArray(frameVAO);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, frameVBO);
 		glBufferData(GL_ARRAY_BUFFER, frameVertices.size() * sizeof(float), frameVertices.data(), GL_STATIC_DRAW);
 
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -432,100 +560,183 @@ int main()
 		glEnableVertexAttribArray(2);
 	}
 
-	// 
-	unsigned int frameTexture;
-	glGenTextures(1, &frameTexture);
-	glBindTexture(GL_TEXTURE_2D, frameTexture);
-	// ƺ͹˷ʽ
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// ͼ񣬴mipmap
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(true); // תص
-	unsigned char* data = stbi_load("frame_texture.jpg", &width, &height, &nrChannels, 0);
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-	{
-		std::cout << "Failed to load texture" << std::endl;
-	}
-	stbi_image_free(data);
-
-	unsigned int chalkboardTexture;
-	glGenTextures(1, &chalkboardTexture);
-	glBindTexture(GL_TEXTURE_2D, chalkboardTexture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	unsigned char* chalkboardData = stbi_load("board_texture.jpg", &width, &height, &nrChannels, 0);
-	if (chalkboardData)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, chalkboardData);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-	{
-		std::cout << "Failed to load chalkboard texture" << std::endl;
-	}
-	stbi_image_free(chalkboardData);
+	// ̨߳̽룬ػ廷ϴǰ󶨵 1x1 ռλ
+	TextureLoader textureLoader;
+	TextureLoader::Handle frameTexture = textureLoader.load(frameTexturePath.c_str());
+	TextureLoader::Handle chalkboardTexture = textureLoader.load(chalkboardTexturePath.c_str());
+	// ģʽҪÿеĻһ£һ֡ȡڽ
+	if (headless.enabled)
+		textureLoader.finish();
 
-	generateSnowflakes(100); //  100 ѩ
+	generateSnowflakes(fireflyCount); // ө
 
-	unsigned int flakeVAO, flakeVBO;
+	// өʵȾÿөһʵÿʵ 3 㣨塢ΡΣ
+	// λÿ֡£С˸λֻʱϴ
+	unsigned int flakeVAO, flakePositionVBO, flakeAttributeVBO;
 	{
 		glGenVertexArrays(1, &flakeVAO);
-		glGenBuffers(1, &flakeVBO);
-
-		glBindVertexArray(flakeVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, flakeVBO);
-		glBufferData(GL_ARRAY_BUFFER, snowflakes.size() * sizeof(Snowflake), snowflakes.data(), GL_STATIC_DRAW);
-
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(1 * sizeof(float)));
-		glEnableVertexAttribArray(2);
+		glGenBuffers(1, &flakePositionVBO);
+		glGenBuffers(1, &flakeAttributeVBO);
+		setupFireflyBuffers(flakeVAO, flakePositionVBO, flakeAttributeVBO);
 	}
-
-	unsigned int ballVAO, ballVBO;
+	// GPU ģģʽ״̬ʹõĻУɱ任ƽ
+	FireflyFeedback fireflyFeedback("firefly_update_vertex.glsl");
+	float gpuFireflyTime = 0.0f; // GPU ģδƽʱ
+	double uploadedFireflyTime = -1.0; // ϴʵĿʱ
+	double uploadedBallTime = -1.0;
+	glm::mat4 uploadedBallViewProjection(0.0f); // ϴΰ LOD ʱͼͶӰ
+	int uploadedBallCulling = -1;                // ʱ޳ʽ1 Ϊ׶޳2 Ϊڵ޳
+
+	// ׶޳ÿһΧУɶݵľֲΧоģ;任õ
+	// СİΧո£ΰΧÿ֡ϣ˻ؽ
+	BoundingBox localBounds[CULL_FIRST_BALL];
+	localBounds[CULL_WALLS] = vertexBounds(roomVertices.data(), roomVertices.size() / 7, 7);
+	localBounds[CULL_LIGHT_CUBE] = vertexBounds(vertices, sizeof(vertices) / (6 * sizeof(float)), 6);
+	localBounds[CULL_CHALKBOARD] = vertexBounds(chalkboardVertices.data(), chalkboardVertices.size() / 8, 8);
+	localBounds[CULL_FRAME] = vertexBounds(frameVertices.data(), frameVertices.size() / 8, 8);
+	localBounds[CULL_WINDMILL] = vertexBounds(windmillVertices.data(), windmillVertices.size() / 3, 3);
+	std::vector<BoundingBox> cullBoxes(CULL_FIRST_BALL);
+	std::vector<uint32_t> visibleObjects;
+	std::vector<unsigned char> objectVisible;
+	BoundingVolumeHierarchy cullHierarchy;
+	double boundedBallTime = -1.0;
+	int drawnObjects = 0, culledObjects = 0;
+
+	// ڵ޳ǽڰΪڵ壬 CPU ϹդͷֱȻ
+	OcclusionBuffer occlusion;
+	bool occlusionPaysOff = true;
+	int occlusionIdleFrames = 0;
+	int occludedObjects = 0;
+	double occlusionSeconds = 0.0;
+
+	// СʵȾ LOD ĵλһ㻺һ壬
+	// ʵݰ LOD 齻ţÿһʵ
+	balls.generate(static_cast<size_t>(ballCount), ballBounds(), ballSeed++);
+	generatedBallCount = ballCount;
+	SphereMesh sphereMesh = generateSphereLods(sphereLodLevels, sizeof(sphereLodLevels) / sizeof(sphereLodLevels[0]));
+	std::vector<float> ballLodInstances;
+	std::vector<size_t> ballLodCounts(sphereMesh.lods.size(), 0);
+	std::vector<unsigned char> ballLods; // ʱÿС LOD 
+	size_t ballTriangles = 0; // һ֡ƵС
+	unsigned int ballVAO, ballVBO, ballEBO, ballInstanceVBO;
 	{
-		std::vector<float> sphereVertices = generateSphereVertices(ball.radius, 36, 18); // 36 sectors and 18 stacks
 		glGenVertexArrays(1, &ballVAO);
 		glGenBuffers(1, &ballVBO);
-		glBindVertexArray(ballVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, ballVBO);
-		glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), &sphereVertices[0], GL_STATIC_DRAW);
+		glGenBuffers(1, &ballEBO);
+		glGenBuffers(1, &ballInstanceVBO);
+		GLState::bindVertexArray(ballVAO);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, ballVBO);
+		glBufferData(GL_ARRAY_BUFFER, sphereMesh.vertices.size() * sizeof(float), &sphereMesh.vertices[0], GL_STATIC_DRAW);
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ballEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereMesh.indices.size() * sizeof(unsigned int), &sphereMesh.indices[0], GL_STATIC_DRAW);
 		// Position attribute
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
-		glBindVertexArray(0);
+		// Normal attribute
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+		// ʵԣλá뾶ɫһλãָڻÿ LOD ʱ
+		for (int attribute = 2; attribute <= 5; ++attribute)
+		{
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribDivisor(attribute, 1);
+		}
+		GLState::bindVertexArray(0);
 	}
 
+	// ɫأ޸ glsl ļں̨±룬ӳɹ滻
+	ShaderRegistry shaderRegistry(window);
+	shaderRegistry.add(lightingShader, "lighting_vertex.glsl", "lighting_fragment.glsl");
+	shaderRegistry.add(roomShader, "room_vertex.glsl", "room_fragment.glsl");
+	shaderRegistry.add(lightCubeShader, "lightcube_vertex.glsl", "lightcube_fragment.glsl");
+	shaderRegistry.add(textureShader, "board_vertex.glsl", "board_fragment.glsl");
+	shaderRegistry.add(snowflakeShader, "snowflake_vertex.glsl", "snowflake_fragment.glsl");
+	shaderRegistry.add(ballShader, "ball_vertex.glsl", "ball_fragment.glsl");
+	shaderRegistry.add(fireflyFeedback.shader(), "firefly_update_vertex.glsl", FireflyFeedback::feedbackVaryings());
+
+	// ʱ棺glfwGetTime  glfwInit ʼʱ
+	const double startupSeconds = glfwGetTime();
+	const ProgramBinaryCache::Stats& programStats = ProgramBinaryCache::stats();
+	std::cout << "Startup: " << startupSeconds * 1000.0 << " ms, shader programs: "
+		<< programStats.loaded << " from cache, " << programStats.compiled << " compiled in "
+		<< programStats.seconds * 1000.0 << " ms (cache " << (ProgramBinaryCache::enabled() ? "on" : "off") << ")" << std::endl;
+	if (sceneLoaded)
+		std::cout << "Scene " << headless.scenePath << ": " << scene.roomCount() << " rooms, " << scene.boardCount() << " boards, "
+			<< scene.lightCount() << " lights, " << scene.emitterCount() << " firefly emitters, " << scene.ballSetCount()
+			<< " ball sets in " << sceneSeconds * 1000.0 << " ms" << std::endl;
+
+	// ģʽ֡֡ʱͼ
+	OffscreenTarget* offscreen = NULL;
+	FrameTimings frameTimings;
+	std::vector<unsigned char> framePixels;
+	int frameIndex = 0;
+	bool headlessFailed = false;
+	if (headless.enabled)
+	{
+		offscreen = new OffscreenTarget(renderWidth, renderHeight);
+		std::cout << "Headless: " << renderWidth << "x" << renderHeight << ", " << headless.frames << " frames, seed "
+			<< headless.seed << ", dt " << headless.frameSeconds * 1000.0 << " ms, "
+			<< (surfaceless ? "surfaceless EGL" : "hidden window") << ", " << glGetString(GL_RENDERER) << std::endl;
+		if (!offscreen->isComplete())
+		{
+			std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+			headless.frames = 0;
+			headlessFailed = true;
+		}
+		// ֻ CPU  GPU өģĶԱȣȾ
+		if (headless.fireflyCheckSteps > 0)
+		{
+			headlessFailed = headlessFailed || !checkGpuFireflies(fireflyFeedback, headless.fireflyCheckSteps, static_cast<float>(headless.frameSeconds));
+			headless.frames = 0;
+		}
+	}
 
+	// ʼ״̬ģ̣߳ģʽ̣߳Ⱦ߳ÿ̶֡ʱƽ
+	simulation.setRate(simulationRate);
+	simulation.setMaxSubsteps(maxSubsteps);
+	if (headless.enabled)
+		simulation.startManual(simulationStep, simulationPublish, NULL);
+	else
+		simulation.start(simulationStep, simulationPublish, NULL);
 
 	// Ⱦѭ
 	// -----------
-	while (!glfwWindowShouldClose(window))
+	while (headless.enabled ? frameIndex < headless.frames : !glfwWindowShouldClose(window))
 	{
 		// ʱ߼
 		// --------------------
-		float currentFrame = static_cast<float>(glfwGetTime());
-		deltaTime = currentFrame - lastFrame;
+		double frameStart = glfwGetTime();
+		profiler.beginFrame();
+		GLState::beginFrame();
+		float currentFrame;
+		if (headless.enabled)
+		{
+			// ̶ʱ䲽ģͬƽ޹
+			simulation.advance(headless.frameSeconds);
+			currentFrame = static_cast<float>(simulation.now());
+			deltaTime = static_cast<float>(headless.frameSeconds);
+		}
+		else
+		{
+			currentFrame = static_cast<float>(frameStart);
+			deltaTime = currentFrame - lastFrame;
+		}
 		lastFrame = currentFrame;
 
+		// Ѿõɫȴڱ
+		shaderRegistry.update();
+		textureLoader.update();
+
 		// 
 		// -----
 		processInput(window);
 
+		// ȡµģգ˿λڿһһ֮λ
+		snapshots.acquire();
+		const SimulationSnapshot& snapshot = snapshots.readBuffer();
+		float interpolation = static_cast<float>((simulation.now() - snapshot.time) / snapshot.stepSeconds);
+		interpolation = glm::clamp(interpolation, 0.0f, 1.0f);
+
 		// Start the Dear ImGui frame
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -533,12 +744,45 @@ int main()
 		ImGui::Begin("panel");// Create a window called "panel" and append into it.
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
 		ImGui::Text("Cornell bos is scaled by %f times", scale);
+		ImGui::Text("Startup %.1f ms, programs: %d cached / %d compiled (%.1f ms)", startupSeconds * 1000.0,
+			programStats.loaded, programStats.compiled, programStats.seconds * 1000.0);
+		ImGui::Text("Shader reloads: %d, failed: %d, compiling: %d (%s)", shaderRegistry.reloadCount(), shaderRegistry.failureCount(),
+			shaderRegistry.pendingCount(), shaderRegistry.parallelCompile() ? "driver threads" : shaderRegistry.deferredReloads() ? "deferred" : "shared context");
+		// ûк̨ʱ޸ĹɫҪֶ¼أῨһ֡
+		if (shaderRegistry.deferredReloads() && shaderRegistry.pendingCount() > 0 && ImGui::Button("Reload shaders"))
+			shaderRegistry.reloadDeferred();
+		if (sceneLoaded)
+			ImGui::Text("Scene: %d entities, loaded in %.2f ms", static_cast<int>(scene.roomCount() + scene.boardCount() + scene.lightCount() +
+				scene.emitterCount() + scene.ballSetCount()), sceneSeconds * 1000.0);
+		ImGui::Text("Textures resident: %d / %d (%d cooked)", static_cast<int>(textureLoader.residentCount()), static_cast<int>(textureLoader.count()),
+			static_cast<int>(textureLoader.cookedCount()));
+		GLState::Counters stateCalls = GLState::lastFrame();
+		ImGui::Text("GL state calls: %llu issued, %llu elided", stateCalls.issued, stateCalls.elided);
+		ImGui::Text("Render queue: %d draws, %d state changes", static_cast<int>(renderQueue.size()), static_cast<int>(renderQueue.stateChanges()));
+		ImGui::Checkbox("Frustum culling", &frustumCulling);
+		ImGui::Text("Objects: %d drawn, %d culled (BVH %d nodes, %d builds)", drawnObjects, culledObjects,
+			static_cast<int>(cullHierarchy.nodeCount()), static_cast<int>(cullHierarchy.buildCount()));
+		ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+		ImGui::Text("Occluded: %d objects, %.3f ms (%s)", occludedObjects, occlusionSeconds * 1000.0,
+			!occlusionCulling ? "off" : occlusionIdleFrames > 0 ? "idle" : "running");
+		ImGui::Checkbox("Firefly lights", &fireflyLights);
+		ImGui::Text("Point lights: %d, up to %d per cluster, %.3f ms", static_cast<int>(lightClusters.lightCount()),
+			static_cast<int>(lightClusters.maxClusterLights()), lightClusterSeconds * 1000.0);
 		ImGui::Checkbox("Lock Cursor(Shortcut: L)", &lockCursor);
+		ImGui::Checkbox("Show profiler", &showProfiler);
 		ImGui::Checkbox("Draw firefly", &drawSnow);
+		ImGui::SliderInt("firefly count", &fireflyCount, SCENE_MIN_FIREFLIES, SCENE_MAX_FIREFLIES, "%d", ImGuiSliderFlags_Logarithmic);
+		ImGui::Checkbox("Simulate firefly on GPU", &gpuFireflies);
+		ImGui::Text("Firefly update: %s", gpuFireflies ? "GPU transform feedback" : fireflyKernelName(fireflyBestKernel()));
+		ImGui::Text("Worker threads: %u", jobSystem.workerCount());
+		ImGui::SliderInt("simulation rate (Hz)", &simulationRate, 10, 240);
+		ImGui::SliderInt("max substeps", &maxSubsteps, 1, 16);
 		ImGui::Checkbox("Draw Ball", &drawBall);
+		ImGui::SliderInt("ball count", &ballCount, SCENE_MIN_BALLS, SCENE_MAX_BALLS, "%d", ImGuiSliderFlags_Logarithmic);
+		ImGui::Text("Ball contacts: %d, triangles: %d", static_cast<int>(snapshot.ballContacts), static_cast<int>(ballTriangles));
 		ImGui::SliderFloat("rotate speed", &rotateSpeed, 0.0f, 10.0f);
 		ImGui::ColorEdit3("windmill color", (float*)&windmill_color);
-		ImGui::ColorEdit3("ball color", (float*)&ball_color);
+		ImGui::ColorEdit3("ball tint", (float*)&ball_color);
 		ImGui::ColorEdit3("background color", (float*)&clear_color);
 		ImGui::ColorEdit3("light color", (float*)&light_color);
 		ImGui::ColorEdit3("celling color", (float*)&celling_color);
@@ -547,386 +791,443 @@ int main()
 		ImGui::ColorEdit3("front color", (float*)&front_color);
 		ImGui::ColorEdit3("right color", (float*)&right_color);
 		ImGui::End();
+		if (showProfiler)
+			profiler.drawWindow(&showProfiler);
 
-		// ѩλ
-		updateSnowflakes();
+		simulation.setRate(simulationRate);
+		simulation.setMaxSubsteps(maxSubsteps);
+		windmillSpinning = drawWindmill && ifRotate;
+		windmillSpeed = rotateSpeed;
 
-		updateBallPosition();
+		// ģģʽıʱҪ޸ģ״̬ģ֮߳ͣ
+		if (ballCount != generatedBallCount || fireflyCount != static_cast<int>(fireflies.count()) || gpuFireflies == firefliesOnCpu)
+		{
+			std::lock_guard<std::mutex> lock(simulation.stateMutex());
+
+			// Сıʱ
+			if (ballCount != generatedBallCount)
+			{
+				balls.generate(static_cast<size_t>(ballCount), ballBounds(), ballSeed++);
+				generatedBallCount = ballCount;
+			}
+
+			// өıʱ
+			if (fireflyCount != static_cast<int>(fireflies.count()))
+			{
+				generateSnowflakes(fireflyCount);
+				setupFireflyBuffers(flakeVAO, flakePositionVBO, flakeAttributeVBO);
+				++fireflyGeneration;
+				if (!firefliesOnCpu)
+					fireflyFeedback.upload(fireflies);
+			}
+
+			// лģģʽʱ CPU  GPU ֮תө״̬
+			if (gpuFireflies == firefliesOnCpu)
+			{
+				if (gpuFireflies)
+					fireflyFeedback.upload(fireflies);
+				else
+					fireflyFeedback.download(fireflies);
+				firefliesOnCpu = !gpuFireflies;
+				gpuFireflyTime = 0.0f;
+			}
+		}
+
+		// GPU ģȾ߳ϰͬĹ̶ƽʣ²һʱڲֵ
+		float fireflyInterpolation = interpolation;
+		if (!firefliesOnCpu)
+		{
+			float step = simulation.stepSeconds();
+			gpuFireflyTime += deltaTime;
+			for (int i = 0; i < maxSubsteps && gpuFireflyTime >= step; ++i)
+			{
+				fireflyFeedback.update(step, fireflyBounds());
+				gpuFireflyTime -= step;
+			}
+			if (gpuFireflyTime >= step)
+				gpuFireflyTime = std::fmod(gpuFireflyTime, step); // ĻѹֱӶ
+			fireflyInterpolation = gpuFireflyTime / step;
+		}
 
 		// ʼȾ
 		// ------
+		if (offscreen)
+			offscreen->bind();
 		glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// ȷ Uniforms/Drawing ʱ Shader
 		//---------------------------------------------------------------------
-		lightingShader.use();
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)renderWidth / (float)renderHeight, nearPlane, farPlane);
 		glm::mat4 view = camera.GetViewMatrix();
 		glm::mat4 model = glm::mat4(1.0f);
 
-		//컨
-		{
-			//ùղ
-			lightingShader.setVec3("objectColor", celling_color.x, celling_color.y, celling_color.z);
-			lightingShader.setVec3("lightColor", light_color.x, light_color.y, light_color.z);
-			lightingShader.setVec3("lightPos", lightPos);
-			lightingShader.setVec3("viewPos", camera.Position);
-
-			// view/projection 任
-			lightingShader.setMat4("projection", projection);
-			lightingShader.setMat4("view", view);
-
-			// 任
-			model = glm::translate(model, cubePos);
-			model = glm::scale(model, glm::vec3(1.0f));
-			lightingShader.setMat4("model", model);
+		// ÿֻ֡ϴһƹ
+		FrameData frameData;
+		frameData.projection = projection;
+		frameData.view = view;
+		frameData.viewPos = glm::vec4(camera.Position, 1.0f);
+		frameData.lightPos = glm::vec4(lightPos, 1.0f);
+		frameData.lightColor = glm::vec4(light_color.x, light_color.y, light_color.z, 1.0f);
 
-			// Ⱦ
-			glBindVertexArray(CeilingVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		// ԴִأGPU ģөʱ CPU ûǵλãΪԴ
+		{
+			double clusterStart = glfwGetTime();
+			pointLights.clear();
+			bool fireflySnapshotReady = snapshot.firefliesOnCpu && snapshot.fireflyGeneration == fireflyGeneration;
+			if (fireflyLights && drawSnow && firefliesOnCpu && fireflySnapshotReady)
+				gatherFireflyLights(snapshot, interpolation, pointLights);
+			lightClusters.build(jobSystem, view, projection, nearPlane, farPlane, pointLights.data(), pointLights.size());
+			lightClusterTextures.update(lightClusters);
+			frameData.clusterScale = lightClusters.clusterScale(renderWidth, renderHeight);
+			frameData.clusterSize = glm::vec4(LightClusterGrid::TILES_X, LightClusterGrid::TILES_Y, LightClusterGrid::SLICES, 0.0f);
+			lightClusterSeconds = glfwGetTime() - clusterStart;
 		}
+		frameUniforms.update(frameData);
 
-		// Ƶذ
+		// 任
 		{
-			//ùղ
-			lightingShader.setVec3("objectColor", floor_color.x, floor_color.y, floor_color.z);
-			lightingShader.setVec3("lightColor", light_color.x, light_color.y, light_color.z);
-			lightingShader.setVec3("lightPos", lightPos);
-			lightingShader.setVec3("viewPos", camera.Position);
-
-			// view/projection 任
-			lightingShader.setMat4("projection", projection);
-			lightingShader.setMat4("view", view);
-
-			// 任
-			model = glm::mat4(1.0f);
 			model = glm::translate(model, cubePos);
 			model = glm::scale(model, glm::vec3(1.0f));
-			lightingShader.setMat4("model", model);
+			sceneUniforms.wallModel = model;
 
-			// Ⱦ
-			glBindVertexArray(FloorVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
-
-		// ǽ
-		{
-			//ùղ
-			lightingShader.setVec3("objectColor", left_color.x, left_color.y, left_color.z);
-			lightingShader.setVec3("lightColor", light_color.x, light_color.y, light_color.z);
-			lightingShader.setVec3("lightPos", lightPos);
-			lightingShader.setVec3("viewPos", camera.Position);
+			model = glm::mat4(1.0f);
+			model = glm::translate(model, lightPos);
+			model = glm::scale(model, glm::vec3(0.1f)); // a smaller cube
+			sceneUniforms.lightCubeModel = model;
 
-			// view/projection 任
-			lightingShader.setMat4("projection", projection);
-			lightingShader.setMat4("view", view);
+			model = glm::mat4(1.0f);
+			model = glm::translate(model, chalkboardPosition);
+			model = glm::scale(model, chalkboardSize);
+			sceneUniforms.chalkboardModel = model;
 
-			// 任
 			model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePos);
-			model = glm::scale(model, glm::vec3(1.0f));
-			lightingShader.setMat4("model", model);
+			model = glm::translate(model, chalkboardPosition);
+			model = glm::scale(model, frameSize);
+			sceneUniforms.frameModel = model;
 
-			// Ⱦ
-			glBindVertexArray(LWallVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			// 糵Ƕģ߳ƽֵֻ֮
+			float angle = glm::mix(snapshot.previousAngle, snapshot.currentAngle, interpolation);
+			model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(chalkboardPosition.x, chalkboardPosition.y, chalkboardPosition.z + 0.01f));
+			model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
+			sceneUniforms.windmillModel = model;
 		}
 
-		// ǽ
+		// ׶޳¸İΧвϲΰΧУ׶ƽ֡ɼ壻
+		// δõհΧУȲɼҲ޳
 		{
-			//ùղ
-			lightingShader.setVec3("objectColor", right_color.x, right_color.y, right_color.z);
-			lightingShader.setVec3("lightColor", light_color.x, light_color.y, light_color.z);
-			lightingShader.setVec3("lightPos", lightPos);
-			lightingShader.setVec3("viewPos", camera.Position);
-
-			// view/projection 任
-			lightingShader.setMat4("projection", projection);
-			lightingShader.setMat4("view", view);
-
-			// 任
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePos);
-			model = glm::scale(model, glm::vec3(1.0f));
-			lightingShader.setMat4("model", model);
+			size_t ballObjects = drawBall ? snapshot.ballCount : 0;
+			bool drawFireflies = drawSnow && (!firefliesOnCpu || (snapshot.firefliesOnCpu && snapshot.fireflyGeneration == fireflyGeneration));
+			cullBoxes.resize(CULL_FIRST_BALL + ballObjects);
+			cullBoxes[CULL_WALLS] = transformBounds(sceneUniforms.wallModel, localBounds[CULL_WALLS]);
+			cullBoxes[CULL_LIGHT_CUBE] = transformBounds(sceneUniforms.lightCubeModel, localBounds[CULL_LIGHT_CUBE]);
+			cullBoxes[CULL_CHALKBOARD] = transformBounds(sceneUniforms.chalkboardModel, localBounds[CULL_CHALKBOARD]);
+			cullBoxes[CULL_FRAME] = transformBounds(sceneUniforms.frameModel, localBounds[CULL_FRAME]);
+			cullBoxes[CULL_WINDMILL] = drawWindmill ? transformBounds(sceneUniforms.windmillModel, localBounds[CULL_WINDMILL]) : emptyBounds();
+			// өߣûȷеķΧȡİΧλ
+			BallBounds room = ballBounds();
+			cullBoxes[CULL_FIREFLIES] = drawFireflies ? mergeBounds(sphereBounds(room.min, 0.5f), sphereBounds(room.max, 0.5f)) : emptyBounds();
+			if (ballObjects > 0 && snapshot.time != boundedBallTime)
+			{
+				ballBoundingBoxes(snapshot.ballInstances.data(), ballObjects, &cullBoxes[CULL_FIRST_BALL]);
+				boundedBallTime = snapshot.time;
+			}
+			else if (ballObjects == 0)
+			{
+				boundedBallTime = -1.0;
+			}
+			cullHierarchy.update(cullBoxes.data(), cullBoxes.size());
 
-			// Ⱦ
-			glBindVertexArray(RWallVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			visibleObjects.clear();
+			if (frustumCulling)
+			{
+				cullHierarchy.cull(Frustum(projection * view), visibleObjects);
+			}
+			else
+			{
+				for (size_t i = 0; i < cullBoxes.size(); ++i)
+					if (cullBoxes[i].min.x <= cullBoxes[i].max.x)
+						visibleObjects.push_back(static_cast<uint32_t>(i));
+			}
+			objectVisible.assign(cullBoxes.size(), 0);
+			for (size_t i = 0; i < visibleObjects.size(); ++i)
+				objectVisible[visibleObjects[i]] = 1;
 		}
 
-		// ǰǽ
+		// ڵ޳ǽڰդɵͷֱȻ岢/ԶȽ
+		// ׶ڵڵ֮ͲٻƣդԶֿ齻߳
+		bool occlusionRan = false;
+		if (occlusionCulling && visibleObjects.size() >= occlusionMinObjects && (occlusionPaysOff || occlusionIdleFrames >= occlusionRetryFrames))
 		{
-			//ùղ
-			lightingShader.setVec3("objectColor", front_color.x, front_color.y, front_color.z);
-			lightingShader.setVec3("lightColor", light_color.x, light_color.y, light_color.z);
-			lightingShader.setVec3("lightPos", lightPos);
-			lightingShader.setVec3("viewPos", camera.Position);
+			double occlusionStart = glfwGetTime();
+			occlusion.begin(projection * view);
+			occlusion.addOccluder(roomVertices.data(), 7, roomIndices.data(), roomIndices.size(), sceneUniforms.wallModel);
+			occlusion.addOccluder(chalkboardVertices.data(), 8, NULL, chalkboardVertices.size() / 8, sceneUniforms.chalkboardModel);
+			occlusion.render(jobSystem);
+			size_t occluded = occlusion.cull(jobSystem, cullBoxes.data(), visibleObjects.data(), visibleObjects.size(), objectVisible.data());
+			occlusionSeconds = glfwGetTime() - occlusionStart;
+			occludedObjects = static_cast<int>(occluded);
+			occlusionPaysOff = occluded * 16 >= visibleObjects.size();
+			occlusionIdleFrames = 0;
+			occlusionRan = true;
+		}
+		else
+		{
+			occludedObjects = 0;
+			occlusionSeconds = 0.0;
+			++occlusionIdleFrames;
+		}
 
-			// view/projection 任
-			lightingShader.setMat4("projection", projection);
-			lightingShader.setMat4("view", view);
+		// δõǿհΧУ
+		drawnObjects = static_cast<int>(visibleObjects.size()) - occludedObjects;
+		culledObjects = 0;
+		for (size_t i = 0; i < cullBoxes.size(); ++i)
+			if (cullBoxes[i].min.x <= cullBoxes[i].max.x && !objectVisible[i])
+				++culledObjects;
+		culledObjects -= occludedObjects;
 
-			// 任
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePos);
-			model = glm::scale(model, glm::vec3(1.0f));
-			lightingShader.setMat4("model", model);
+		// ȷŽȾУ 64 λͳһִУ͸尴ɫ VAO 
+		// ɽԶǰȲԣ͸өԶ
+		renderQueue.clear();
 
-			// Ⱦ
-			glBindVertexArray(FWallVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		// ǽλƣɫԲɫ
+		if (objectVisible[CULL_WALLS])
+		{
+			// ǽɫ
+			sceneUniforms.wallColors[WALL_CEILING] = glm::vec3(celling_color.x, celling_color.y, celling_color.z);
+			sceneUniforms.wallColors[WALL_FLOOR] = glm::vec3(floor_color.x, floor_color.y, floor_color.z);
+			sceneUniforms.wallColors[WALL_LEFT] = glm::vec3(left_color.x, left_color.y, left_color.z);
+			sceneUniforms.wallColors[WALL_RIGHT] = glm::vec3(right_color.x, right_color.y, right_color.z);
+			sceneUniforms.wallColors[WALL_FRONT] = glm::vec3(front_color.x, front_color.y, front_color.z);
+
+			DrawPacket packet = DrawPacket::elements(roomShader.ID, roomVAO, GL_TRIANGLES, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(roomIndices.size()));
+			packet.profilePass = PASS_WALLS;
+			packet.setup = setupWalls;
+			packet.context = &sceneUniforms;
+			renderQueue.submit(packet, RenderQueue::OPAQUE_LAYER, RenderQueue::viewDepth(view, cubePos, farPlane));
 		}
 
-		// ƵƷ
+		// Ʒ
+		if (objectVisible[CULL_LIGHT_CUBE])
 		{
-			lightCubeShader.use();
-			lightCubeShader.setMat4("projection", projection);
-			lightCubeShader.setMat4("view", view);
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, lightPos);
-			model = glm::scale(model, glm::vec3(0.1f)); // a smaller cube
-			lightCubeShader.setMat4("model", model);
-			lightCubeShader.setVec4("ourColor", glm::vec4(light_color.x, light_color.y, light_color.z, 1.0f));
-
-
-			glBindVertexArray(lightCubeVAO);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			DrawPacket packet = DrawPacket::arrays(lightCubeShader.ID, lightCubeVAO, GL_TRIANGLES, 0, 36);
+			packet.profilePass = PASS_LIGHT_CUBE;
+			packet.setup = setupLightCube;
+			packet.context = &sceneUniforms;
+			renderQueue.submit(packet, RenderQueue::OPAQUE_LAYER, RenderQueue::viewDepth(view, lightPos, farPlane));
 		}
 
-		// ƺڰ
+		// ڰ壨Ԫ 0
+		if (objectVisible[CULL_CHALKBOARD])
 		{
-			// Ԫ0󶨺ڰ
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, chalkboardTexture);
-			textureShader.use();
-			textureShader.setInt("texture1", 0); // Ԫݸɫ
-			textureShader.setBool("useTexture1", true); // ʹúڰ
-			textureShader.setVec3("lightColor", light_color.x, light_color.y, light_color.z);
-			textureShader.setVec3("lightPos", lightPos);
-			textureShader.setVec3("viewPos", camera.Position);
-
-			textureShader.setMat4("projection", projection);
-			textureShader.setMat4("view", view);
-
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, chalkboardPosition);
-			model = glm::scale(model, chalkboardSize);
-			textureShader.setMat4("model", model);
-
-			glBindTexture(GL_TEXTURE_2D, chalkboardTexture);
-			glBindVertexArray(chalkboardVAO);
-			glDrawArrays(GL_TRIANGLES, 0, chalkboardVertices.size() / 8);
+			DrawPacket packet = DrawPacket::arrays(textureShader.ID, chalkboardVAO, GL_TRIANGLES, 0, static_cast<GLsizei>(chalkboardVertices.size() / 8));
+			packet.texture = textureLoader.get(chalkboardTexture);
+			packet.textureUnit = 0;
+			packet.profilePass = PASS_CHALKBOARD;
+			packet.setup = setupChalkboard;
+			packet.context = &sceneUniforms;
+			renderQueue.submit(packet, RenderQueue::OPAQUE_LAYER, RenderQueue::viewDepth(view, chalkboardPosition, farPlane));
 		}
 
-		// Ⱦ߿
+		// ߿Ԫ 1
+		if (objectVisible[CULL_FRAME])
 		{
-			// Ԫ0󶨺ڰ
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, frameTexture);
-			textureShader.use();
-			textureShader.setInt("texture2", 1); // Ԫݸɫ
-			textureShader.setBool("useTexture1", false); // ʹúڰ
-			textureShader.setVec3("lightColor", light_color.x, light_color.y, light_color.z);
-			textureShader.setVec3("lightPos", lightPos);
-			textureShader.setVec3("viewPos", camera.Position);
-
-			textureShader.setMat4("projection", projection);
-			textureShader.setMat4("view", view);
-
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, chalkboardPosition);
-			model = glm::scale(model, frameSize);
-			textureShader.setMat4("model", model);
-
-			glBindTexture(GL_TEXTURE_2D, frameTexture);
-			glBindVertexArray(frameVAO);
-			glDrawArrays(GL_TRIANGLES, 0, frameVertices.size() / 8);
+			DrawPacket packet = DrawPacket::arrays(textureShader.ID, frameVAO, GL_TRIANGLES, 0, static_cast<GLsizei>(frameVertices.size() / 8));
+			packet.texture = textureLoader.get(frameTexture);
+			packet.textureUnit = 1;
+			packet.profilePass = PASS_FRAME;
+			packet.setup = setupFrame;
+			packet.context = &sceneUniforms;
+			renderQueue.submit(packet, RenderQueue::OPAQUE_LAYER, RenderQueue::viewDepth(view, chalkboardPosition, farPlane));
 		}
 
-		// Ʒ糵
-		if (drawWindmill)
+		// 糵ͬύ˳
+		if (drawWindmill && objectVisible[CULL_WINDMILL])
 		{
-			lightingShader.use();
-			lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f); // ɫ
-			lightingShader.setMat4("projection", projection);
-			lightingShader.setMat4("view", view);
-
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, glm::vec3(chalkboardPosition.x, chalkboardPosition.y, chalkboardPosition.z + 0.01f));
+			glm::vec3 windmillPosition(chalkboardPosition.x, chalkboardPosition.y, chalkboardPosition.z + 0.01f);
+			sceneUniforms.windmillColor = glm::vec3(windmill_color.x, windmill_color.y, windmill_color.z);
+
+			GLsizei vertexCount = static_cast<GLsizei>(windmillVertices.size() / 3);
+			float depth = RenderQueue::viewDepth(view, windmillPosition, farPlane);
+			DrawPacket packet = DrawPacket::arrays(lightingShader.ID, windmillVAO, GL_TRIANGLES, 0, vertexCount);
+			packet.profilePass = PASS_WINDMILL;
+			packet.setup = setupWindmill;
+			packet.context = &sceneUniforms;
+			if (drawColor)
+				renderQueue.submit(packet, RenderQueue::OPAQUE_LAYER, depth);
+			packet.mode = GL_LINE_LOOP;
+			packet.argument = 1;
+			renderQueue.submit(packet, RenderQueue::OPAQUE_LAYER, depth);
+		}
 
-			if (ifRotate) {
-				currentAngle += 50.0f * deltaTime * rotateSpeed; // Update the angle only if rotating
+		// ө
+		// CPU ģʱֻп뵱ǰ岼һ²Żƣɺһ֡
+		bool fireflySnapshotReady = snapshot.firefliesOnCpu && snapshot.fireflyGeneration == fireflyGeneration;
+		if (drawSnow && (!firefliesOnCpu || fireflySnapshotReady) && objectVisible[CULL_FIREFLIES])
+		{
+			sceneUniforms.time = currentFrame;
+			sceneUniforms.fireflyInterpolation = firefliesOnCpu ? interpolation : fireflyInterpolation;
+			// ÿݿֻϴһΣȶɴ洢ȴһ֡Ļ
+			if (firefliesOnCpu && snapshot.time != uploadedFireflyTime)
+			{
+				GLState::bindBuffer(GL_ARRAY_BUFFER, flakePositionVBO);
+				glBufferData(GL_ARRAY_BUFFER, snapshot.fireflyPositions.size() * sizeof(float), snapshot.fireflyPositions.data(), GL_STREAM_DRAW);
+				uploadedFireflyTime = snapshot.time;
 			}
-			model = glm::rotate(model, glm::radians(currentAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-
-			lightingShader.setMat4("model", model);
+			// ÿʵһ㣺Ȼȫө壬ٻΣΣΪ gl_InstanceID  argument
+			// ͸εһҲдȣ⵲סө棻ͬύ˳
+			FireflyBounds bounds = fireflyBounds();
+			float fireflyDepth = RenderQueue::viewDepth(view, glm::vec3(bounds.centerX, bounds.centerY, bounds.centerZ), farPlane);
+			DrawPacket packet = DrawPacket::arrays(snowflakeShader.ID, firefliesOnCpu ? flakeVAO : fireflyFeedback.currentRenderVAO(),
+				GL_POINTS, 0, static_cast<GLsizei>(fireflies.count()));
+			packet.instanceCount = 2;
+			packet.blend = RenderQueue::BLEND_ALPHA;
+			packet.profilePass = PASS_FIREFLIES;
+			packet.setup = setupFireflies;
+			packet.context = &sceneUniforms;
+			renderQueue.submit(packet, RenderQueue::TRANSLUCENT_LAYER, fireflyDepth);
+			packet.instanceCount = 1;
+			packet.argument = 2;
+			packet.depthWrite = false;
+			renderQueue.submit(packet, RenderQueue::TRANSLUCENT_LAYER, fireflyDepth);
+		}
 
-			glBindVertexArray(windmillVAO);
-			glLineWidth(2.5f);
-			if (drawColor) {
-				lightingShader.setVec3("objectColor", windmill_color.x, windmill_color.y, windmill_color.z);
-				glDrawArrays(GL_TRIANGLES, 0, windmillVertices.size() / 3);
-				lightingShader.setVec3("objectColor", 1.0f, 1.0f, 1.0f); // ɫ
-				glDrawArrays(GL_LINE_LOOP, 0, windmillVertices.size() / 3);
+		// Render the balls
+		if (drawBall && snapshot.ballCount > 0)
+		{
+			sceneUniforms.ballTint = glm::vec3(ball_color.x, ball_color.y, ball_color.z);
+			sceneUniforms.interpolation = interpolation;
+			sceneUniforms.ballInstanceVBO = ballInstanceVBO;
+			// աӽǻ޳ʽ仯ʱֻΪδ޳СͶӰ뾶ѡ LOD ϴ
+			glm::mat4 viewProjection = projection * view;
+			int ballCulling = (frustumCulling ? 1 : 0) | (occlusionRan ? 2 : 0);
+			if (snapshot.time != uploadedBallTime || viewProjection != uploadedBallViewProjection || ballCulling != uploadedBallCulling)
+			{
+				float pixelsPerUnit = projection[1][1] * 0.5f * renderHeight; // λ봦һλȶӦ
+				groupBallsByLod(snapshot.ballInstances.data(), snapshot.ballCount, sphereMesh, camera.Position, pixelsPerUnit, sphereLodEdgePixels,
+					ballLodInstances, ballLodCounts, ballLods, &objectVisible[CULL_FIRST_BALL]);
+				GLState::bindBuffer(GL_ARRAY_BUFFER, ballInstanceVBO);
+				glBufferData(GL_ARRAY_BUFFER, ballLodInstances.size() * sizeof(float), ballLodInstances.data(), GL_STREAM_DRAW);
+				uploadedBallTime = snapshot.time;
+				uploadedBallViewProjection = viewProjection;
+				uploadedBallCulling = ballCulling;
 			}
-			else
+			// ÿ LOD һʵͬһȣɴֵϸύ˳
+			BallBounds bounds = ballBounds();
+			float depth = RenderQueue::viewDepth(view, (bounds.min + bounds.max) * 0.5f, farPlane);
+			size_t firstInstance = 0;
+			ballTriangles = 0;
+			for (size_t lod = 0; lod < sphereMesh.lods.size(); ++lod)
 			{
-				glDrawArrays(GL_LINE_LOOP, 0, windmillVertices.size() / 3);
+				if (ballLodCounts[lod] == 0)
+					continue;
+				const SphereLod& mesh = sphereMesh.lods[lod];
+				DrawPacket packet = DrawPacket::elements(ballShader.ID, ballVAO, GL_TRIANGLES, GL_UNSIGNED_INT,
+					static_cast<GLint>(mesh.firstIndex), static_cast<GLsizei>(mesh.indexCount));
+				packet.instanceCount = static_cast<GLsizei>(ballLodCounts[lod]);
+				packet.profilePass = PASS_BALLS;
+				packet.setup = setupBalls;
+				packet.context = &sceneUniforms;
+				packet.argument = static_cast<unsigned int>(firstInstance);
+				renderQueue.submit(packet, RenderQueue::OPAQUE_LAYER, depth);
+				firstInstance += ballLodCounts[lod];
+				ballTriangles += ballLodCounts[lod] * mesh.indexCount / 3;
 			}
 		}
 
-		// ѩ
-		if (drawSnow)
+		renderQueue.sort();
+		renderQueue.execute(&profiler);
+
+		// Ⱦ imguiģʽ壬ϵ֡ÿжͬ
 		{
-			snowflakeShader.use();
-			snowflakeShader.setMat4("projection", projection);
-			snowflakeShader.setMat4("view", view);
-			//  VBO еѩ
-			glBindBuffer(GL_ARRAY_BUFFER, flakeVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, snowflakes.size() * sizeof(Snowflake), snowflakes.data());
-			// ÿѩ
-			glBindVertexArray(flakeVAO);
-			for (auto& snowflake : snowflakes) {
-				glm::mat4 model = glm::mat4(1.0f);
-				model = glm::translate(model, glm::vec3(snowflake.x, snowflake.y, snowflake.z));
-				model = glm::scale(model, glm::vec3(snowflake.size));
-				snowflakeShader.setMat4("model", model);
-			}
-			// ʹ GL_POINTS һȾѩ
-			snowflakeShader.setVec4("objectColor", 0.0f, 0.0f, 0.0f, 1.0f);
-			snowflakeShader.setFloat("pointSize", 5.0f);
-			glDrawArrays(GL_POINTS, 0, snowflakes.size());
-			snowflakeShader.setVec4("objectColor", 0.98f, 0.58f, 0.098f, 1.0f);
-			snowflakeShader.setFloat("pointSize", 15.0f);
-			glDrawArrays(GL_POINTS, 0, snowflakes.size());
-			snowflakeShader.setVec4("objectColor", 0.969f, 0.89f, 0.455f, 0.5f);
-			snowflakeShader.setFloat("pointSize", 30.0f);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glDrawArrays(GL_POINTS, 0, snowflakes.size());
-			glDisable(GL_BLEND);
+			ProfileScope pass(profiler, PASS_IMGUI);
+			ImGui::Render();
+			if (!headless.enabled)
+				ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
+		profiler.endFrame();
 
-		// Render the ball
-		if (drawBall)
+		if (headless.enabled)
 		{
-			ballShader.use();
-			ballShader.setMat4("projection", projection);
-			ballShader.setMat4("view", view);
-			// ģ;
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, ball.position); // ƶСλ
-			model = glm::scale(model, glm::vec3(ball.radius)); // ŵСİ뾶
-			ballShader.setMat4("model", model);
-			ballShader.setVec3("objectColor", glm::vec3(ball_color.x, ball_color.y, ball_color.z)); // СɫΪɫ
-			//  VAO 
-			glBindVertexArray(ballVAO);
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, 36 * 18); // Ķ㣨ջ
-			glBindVertexArray(0);
+			// ¼ύʱ GPU ɵʱ䣬ٰزһ֡
+			double issued = glfwGetTime();
+			glFinish();
+			frameTimings.add(issued - frameStart, glfwGetTime() - frameStart);
+			if (headless.shouldDump(frameIndex))
+			{
+				offscreen->readPixels(framePixels);
+				std::string path = headless.imagePath(frameIndex);
+				if (!writeImage(path, renderWidth, renderHeight, framePixels))
+				{
+					std::cout << "Failed to write " << path << std::endl;
+					headlessFailed = true;
+				}
+			}
+			++frameIndex;
+			glfwPollEvents();
+			continue;
 		}
 
-		// Ⱦ imgui		
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
 		// glfwѯ IO ¼/ͷżƶȣ
 		// -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
+	if (headless.enabled && frameTimings.count() > 0)
+	{
+		frameTimings.printSummary(std::cout, static_cast<size_t>(headless.warmupFrames));
+		profiler.printSummary(std::cout);
+		unsigned long long stateFrames = 0;
+		GLState::Counters stateCalls = GLState::total(stateFrames);
+		if (stateFrames > 0)
+			std::cout << "GL state calls per frame: " << stateCalls.issued / stateFrames << " issued, " << stateCalls.elided / stateFrames << " elided" << std::endl;
+		if (!headless.timingsPath.empty() && !frameTimings.writeCsv(headless.timingsPath))
+		{
+			std::cout << "Failed to write " << headless.timingsPath << std::endl;
+			headlessFailed = true;
+		}
+	}
+
 	// ѡһԴ;ȡԴ
 	// ------------------------------------------------------------------------
-	glDeleteVertexArrays(1, &CeilingVAO);
-	glDeleteVertexArrays(1, &FloorVAO);
-	glDeleteVertexArrays(1, &RWallVAO);
-	glDeleteVertexArrays(1, &LWallVAO);
-	glDeleteVertexArrays(1, &FWallVAO);
+	simulation.stop();
+	shaderRegistry.release();
+	glDeleteVertexArrays(1, &roomVAO);
 	glDeleteVertexArrays(1, &lightCubeVAO);
 	glDeleteVertexArrays(1, &chalkboardVAO);
 	glDeleteVertexArrays(1, &windmillVAO);
 	glDeleteVertexArrays(1, &frameVAO);
 	glDeleteVertexArrays(1, &flakeVAO);
-	glDeleteBuffers(1, &VBO1);
-	glDeleteBuffers(1, &VBO2);
-	glDeleteBuffers(1, &VBO3);
-	glDeleteBuffers(1, &VBO4);
-	glDeleteBuffers(1, &VBO5);
+	glDeleteBuffers(1, &roomVBO);
+	glDeleteBuffers(1, &roomEBO);
 	glDeleteBuffers(1, &VBO6);
 	glDeleteBuffers(1, &chalkboardVBO);
 	glDeleteBuffers(1, &windmillVBO);
 	glDeleteBuffers(1, &frameVBO);
-	glDeleteBuffers(1, &flakeVBO);
-	glDeleteTextures(1, &frameTexture);
-	glDeleteTextures(1, &chalkboardTexture);
+	glDeleteBuffers(1, &flakePositionVBO);
+	glDeleteBuffers(1, &flakeAttributeVBO);
+	glDeleteVertexArrays(1, &ballVAO);
+	glDeleteBuffers(1, &ballVBO);
+	glDeleteBuffers(1, &ballEBO);
+	glDeleteBuffers(1, &ballInstanceVBO);
+	textureLoader.release();
+	fireflyFeedback.release();
+	frameUniforms.release();
+	lightClusterTextures.release();
+	profiler.release();
+	if (offscreen)
+	{
+		offscreen->release();
+		delete offscreen;
+	}
 
 
 	// glfwֹǰ GLFW Դ
 	// ------------------------------------------------------------------
 	glfwTerminate();
-	return 0;
-}
-
-//ɺڰĶϢ
-void generateChalkboardVertices()
-{
-	float width = chalkboardSize.x;
-	float height = chalkboardSize.y;
-	float depth = chalkboardSize.z;
-
-	// Front face with texture coordinates
-	chalkboardVertices = {
-		// Positions          // Normals         // Texture Coords
-		// Front face
-		-width / 2, -height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-		 width / 2, -height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
-		 width / 2,  height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
-		 width / 2,  height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
-		-width / 2,  height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
-		-width / 2, -height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
-
-		// Back face
-		-width / 2, -height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-		 width / 2, -height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-		 width / 2,  height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-		 width / 2,  height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-		-width / 2,  height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-		-width / 2, -height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-
-		// Left face
-		-width / 2,  height / 2,  depth / 2, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		-width / 2,  height / 2, -depth / 2, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-		-width / 2, -height / 2, -depth / 2, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-		-width / 2, -height / 2, -depth / 2, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-		-width / 2, -height / 2,  depth / 2, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-		-width / 2,  height / 2,  depth / 2, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-
-		// Right face
-		 width / 2,  height / 2,  depth / 2,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-		 width / 2,  height / 2, -depth / 2,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-		 width / 2, -height / 2, -depth / 2,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-		 width / 2, -height / 2, -depth / 2,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-		 width / 2, -height / 2,  depth / 2,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-		 width / 2,  height / 2,  depth / 2,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-
-		 // Bottom face
-		 -width / 2, -height / 2, -depth / 2,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-		  width / 2, -height / 2, -depth / 2,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-		  width / 2, -height / 2,  depth / 2,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-		  width / 2, -height / 2,  depth / 2,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-		 -width / 2, -height / 2,  depth / 2,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-		 -width / 2, -height / 2, -depth / 2,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-
-		 // Top face
-		 -width / 2,  height / 2, -depth / 2,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-		  width / 2,  height / 2, -depth / 2,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-		  width / 2,  height / 2,  depth / 2,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-		  width / 2,  height / 2,  depth / 2,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-		 -width / 2,  height / 2,  depth / 2,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-		 -width / 2,  height / 2, -depth / 2,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
-	};
+	return headlessFailed ? 1 : 0;
 }
 
 //ѯ GLFW Ƿ/ͷ˸֡ؼӦķӦ
@@ -975,56 +1276,12 @@ void processInput(GLFWwindow* window)
 	}
 }
 
-//ɱ߿Ϣ
-void generateFrameVertices()
-{
-	float width = frameSize.x;
-	float height = frameSize.y;
-	float depth = frameSize.z;
-	float thickness = frameThickness.x;
-
-	// ߿ǰ棬
-	frameVertices = {
-		// ϱ߿
-		-width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-		 width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-		 width / 2, height / 2 - thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.9f,
-		 width / 2, height / 2 - thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.9f,
-		-width / 2, height / 2 - thickness, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.9f,
-		-width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-
-		// ±߿
-		-width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-		 width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-		 width / 2, -height / 2 + thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.1f,
-		 width / 2, -height / 2 + thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.1f,
-		-width / 2, -height / 2 + thickness, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.1f,
-		-width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-
-		// ߿
-		-width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-		-width / 2 + thickness, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.1f, 1.0f,
-		-width / 2 + thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.1f, 0.0f,
-		-width / 2 + thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.1f, 0.0f,
-		-width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-		-width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-
-		// ұ߿
-		 width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-		 width / 2 - thickness, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.9f, 1.0f,
-		 width / 2 - thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.9f, 0.0f,
-		 width / 2 - thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.9f, 0.0f,
-		 width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-		 width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-	};
-}
-
 // glfwÿڴС仯ͨϵͳûСʱ˻صִ
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	// ȷµĴڳߴƥ;ע⣬widthheightԴ Retina ʾָĸ߶
-	glViewport(0, 0, width, height);
+	GLState::viewport(0, 0, width, height);
 }
 
 
@@ -1063,90 +1320,335 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	}
 }
 
+// өĻΧ cube Ϊ׼ cube ײʱ
+FireflyBounds fireflyBounds()
+{
+	return roomFireflyBounds(cubePos);
+}
+
 // ѩϵͳ
 void generateSnowflakes(int count) {
-	srand(static_cast<unsigned>(time(0))); // 
-	for (int i = 0; i < count; ++i) {
-		Snowflake flake;
-		flake.x = cubePos.x + static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5f; // x Χ cube  [-0.5, 0.5]
-		flake.y = cubePos.y + static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 1.5f; // y Χ cube  [-0.5, 0.5]
-		flake.z = static_cast<float>(rand()) / static_cast<float>(RAND_MAX); // z Χ cube  [-0.5, 0.5]
-		flake.size = static_cast<float>(rand() % 5 + 1); // size Χ 1  5
-		flake.speed = static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 0.1f; // ѩٶ
-		snowflakes.push_back(flake);
-	}
+	generateFireflies(fireflies, static_cast<size_t>(count), fireflyBounds(), fireflySeed++);
 }
 
-// Ⱦ͸ѩλ
-void updateSnowflakes() {
-	srand(static_cast<unsigned>(time(0)));
-	for (auto& snowflake : snowflakes) {
-		if (static_cast<float>(rand()) / static_cast<float>(RAND_MAX) >= 0.5f) {
-			snowflake.y -= snowflake.speed * deltaTime; // ѩ
-		}
-		else {
-			snowflake.y += snowflake.speed * deltaTime; // ѩ
-		}
-		if (static_cast<float>(rand()) / static_cast<float>(RAND_MAX) >= 0.5f) {
-			snowflake.x += snowflake.speed * deltaTime * 0.5f;
-		}
-		else {
-			snowflake.x -= snowflake.speed * deltaTime * 0.5f;
-		}
-		// ѩײʱõ嶥
-		if (snowflake.y < cubePos.y - 0.5f) { // ײ
-			snowflake.y += 0.5f; // õ嶥
-			snowflake.x = cubePos.x + static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5f; //  x λ
+// ѩλãߣײʱ
+// ÿֻөԴ״̬˽ֿĸ̡߳Ժ˳ִ޹
+void updateSnowflakes(JobCounter& counter, float stepSeconds) {
+	fireflyStep.store = &fireflies;
+	fireflyStep.deltaTime = stepSeconds;
+	fireflyStep.bounds = fireflyBounds();
+	fireflyStep.kernel = fireflyBestKernel();
+	kickFireflyStep(jobSystem, fireflyStep, counter);
+}
+
+// ύһ CPU ģөֿ飨δ GPU ģʱСĻַֿ顣
+// Сײ counter ɵ balls.resolveContacts(bounds) 
+void kickSimulation(JobCounter& counter, float stepSeconds, bool updateFirefliesOnCpu)
+{
+	if (updateFirefliesOnCpu)
+		updateSnowflakes(counter, stepSeconds);
+	ballStep.balls = &balls;
+	ballStep.deltaTime = stepSeconds;
+	ballStep.bounds = ballBounds();
+	kickBallIntegration(jobSystem, ballStep, counter);
+}
+
+// ģ̵߳һһеһ֮ǰȼө糵״̬
+// ΪյġһȾֵСһλ BallSystem Լ棩
+void simulationStep(void* /*context*/, float stepSeconds, bool lastSubstep)
+{
+	SimulationSnapshot& snapshot = snapshots.writeBuffer();
+	if (lastSubstep)
+	{
+		snapshot.previousAngle = currentAngle;
+		if (firefliesOnCpu)
+		{
+			size_t capacity = fireflies.capacity();
+			snapshot.fireflyPositions.resize(6 * capacity);
+			memcpy(&snapshot.fireflyPositions[3 * capacity], fireflies.x, capacity * sizeof(float));
+			memcpy(&snapshot.fireflyPositions[4 * capacity], fireflies.y, capacity * sizeof(float));
+			memcpy(&snapshot.fireflyPositions[5 * capacity], fireflies.z, capacity * sizeof(float));
 		}
 	}
+
+	JobCounter jobs;
+	kickSimulation(jobs, stepSeconds, firefliesOnCpu);
+	jobSystem.wait(jobs);
+	balls.resolveContacts(ballStep.bounds);
+
+	if (windmillSpinning)
+		currentAngle += 50.0f * stepSeconds * windmillSpeed;
 }
 
-// Сλ
-void updateBallPosition() {
-	ball.position += ball.velocity * deltaTime;
-	if (ball.position.x - ball.radius <= -1.2f) {
-		ball.velocity.x = fabs(ball.velocity.x); // Reverse X direction
-	}
-	if (ball.position.x + ball.radius >= 1.2f) {
-		ball.velocity.x = -fabs(ball.velocity.x); // Reverse X direction
+// һ״̬дղȾ߳
+void simulationPublish(void* /*context*/, double time, float stepSeconds)
+{
+	SimulationSnapshot& snapshot = snapshots.writeBuffer();
+	snapshot.time = time;
+	snapshot.stepSeconds = stepSeconds;
+	snapshot.currentAngle = currentAngle;
+
+	snapshot.firefliesOnCpu = firefliesOnCpu;
+	snapshot.fireflyGeneration = fireflyGeneration;
+	if (firefliesOnCpu)
+	{
+		size_t capacity = fireflies.capacity();
+		snapshot.fireflyPositions.resize(6 * capacity);
+		memcpy(&snapshot.fireflyPositions[0 * capacity], fireflies.x, capacity * sizeof(float));
+		memcpy(&snapshot.fireflyPositions[1 * capacity], fireflies.y, capacity * sizeof(float));
+		memcpy(&snapshot.fireflyPositions[2 * capacity], fireflies.z, capacity * sizeof(float));
 	}
-	if (ball.position.y - ball.radius <= -0.4f) {
-		ball.velocity.y = fabs(ball.velocity.y); // Reverse Y direction
+
+	size_t count = balls.count();
+	snapshot.ballCount = count;
+	snapshot.ballContacts = balls.contactCount();
+	snapshot.ballInstances.resize(10 * count);
+	memcpy(&snapshot.ballInstances[0], &balls.position[0], count * sizeof(glm::vec3));
+	memcpy(&snapshot.ballInstances[3 * count], &balls.radius[0], count * sizeof(float));
+	memcpy(&snapshot.ballInstances[4 * count], &balls.color[0], count * sizeof(glm::vec3));
+	memcpy(&snapshot.ballInstances[7 * count], &balls.previousPosition[0], count * sizeof(glm::vec3));
+
+	snapshots.publish();
+}
+
+// ǰ maxFireflyLights ֻөֵλΪԴ
+void gatherFireflyLights(const SimulationSnapshot& snapshot, float interpolation, std::vector<PointLight>& lights)
+{
+	size_t capacity = snapshot.fireflyPositions.size() / 6;
+	size_t count = std::min(std::min(fireflies.count(), capacity), maxFireflyLights);
+	const float* latest = snapshot.fireflyPositions.data();
+	const float* previous = latest + 3 * capacity;
+	lights.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::vec3 from(previous[i], previous[capacity + i], previous[2 * capacity + i]);
+		glm::vec3 to(latest[i], latest[capacity + i], latest[2 * capacity + i]);
+		lights[i].position = glm::mix(from, to, interpolation);
+		lights[i].radius = fireflyLightRadius;
+		lights[i].color = fireflyLightColor;
 	}
-	if (ball.position.y + ball.radius >= 1.0f) {
-		ball.velocity.y = -fabs(ball.velocity.y); // Reverse Y direction
+}
+
+// ǰөʵ壬ϴСλʵ
+void setupFireflyBuffers(unsigned int flakeVAO, unsigned int flakePositionVBO, unsigned int flakeAttributeVBO)
+{
+	size_t flakeBytes = fireflies.capacity() * sizeof(float);
+	GLState::bindVertexArray(flakeVAO);
+
+	// һ xyz ţÿݿд
+	GLState::bindBuffer(GL_ARRAY_BUFFER, flakePositionVBO);
+	glBufferData(GL_ARRAY_BUFFER, 6 * flakeBytes, NULL, GL_STREAM_DRAW);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		glVertexAttribPointer(axis, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)(axis * flakeBytes));
+		glEnableVertexAttribArray(axis);
+		glVertexAttribPointer(5 + axis, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)((3 + axis) * flakeBytes));
+		glEnableVertexAttribArray(5 + axis);
 	}
-	if (ball.position.z + ball.radius >= 2.7f) {
-		ball.velocity.z = -fabs(ball.velocity.z); // Reverse Z direction
+
+	// Сλֻʱϴһ
+	GLState::bindBuffer(GL_ARRAY_BUFFER, flakeAttributeVBO);
+	glBufferData(GL_ARRAY_BUFFER, 2 * flakeBytes, NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, flakeBytes, fireflies.size);
+	glBufferSubData(GL_ARRAY_BUFFER, flakeBytes, flakeBytes, fireflies.phase);
+	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)flakeBytes);
+	glEnableVertexAttribArray(4);
+
+	GLState::bindVertexArray(0);
+}
+
+// ӵǰө״̬CPU  GPU ƽ steps Ƚλ״̬
+// ߵͬ״̬ȫһ£λֻ˳
+// ֮ CPU өѱƽֻ˳ǰļ
+bool checkGpuFireflies(FireflyFeedback& feedback, int steps, float stepSeconds)
+{
+	const float tolerance = 1e-4f;
+	FireflyBounds bounds = fireflyBounds();
+	feedback.upload(fireflies);
+	for (int i = 0; i < steps; ++i)
+	{
+		feedback.update(stepSeconds, bounds);
+		updateFireflies(fireflies, stepSeconds, bounds);
 	}
-	if (ball.position.z - ball.radius <= 1.3f) {
-		ball.velocity.z = fabs(ball.velocity.z); // Reverse Z direction
+	FireflyStore gpu;
+	gpu.resize(fireflies.count());
+	feedback.download(gpu);
+
+	size_t mismatches = 0;
+	float maxError = 0.0f;
+	for (size_t i = 0; i < fireflies.count(); ++i)
+	{
+		float error = std::max(std::max(std::fabs(gpu.x[i] - fireflies.x[i]), std::fabs(gpu.y[i] - fireflies.y[i])), std::fabs(gpu.z[i] - fireflies.z[i]));
+		maxError = std::max(maxError, error);
+		if (error > tolerance || gpu.rng[i] != fireflies.rng[i])
+		{
+			if (mismatches < 5)
+				std::cout << "  firefly " << i << ": cpu (" << fireflies.x[i] << ", " << fireflies.y[i] << ", " << fireflies.z[i] << ") rng " << fireflies.rng[i]
+					<< ", gpu (" << gpu.x[i] << ", " << gpu.y[i] << ", " << gpu.z[i] << ") rng " << gpu.rng[i] << std::endl;
+			++mismatches;
+		}
 	}
+	std::cout << "Firefly check: " << fireflies.count() << " fireflies, " << steps << " steps of " << stepSeconds * 1000.0f << " ms, "
+		<< mismatches << " differ, max position error " << maxError << " (" << fireflyKernelName(fireflyBestKernel()) << " vs transform feedback)" << std::endl;
+	return mismatches == 0;
 }
 
-std::vector<float> generateSphereVertices(float radius, int sectorCount, int stackCount) {
-	std::vector<float> vertices;
-	float x, y, z, xy; // Position
-	float sectorStep = 2 * acos(-1.0) / sectorCount;
-	float stackStep = acos(-1.0) / stackCount;
-	float sectorAngle, stackAngle;
-
-	for (int i = 0; i <= stackCount; ++i) {
-		stackAngle = acos(-1.0) / 2 - i * stackStep; // Starting from pi/2 to -pi/2
-		xy = radius * cosf(stackAngle);        // r * cos(u)
-		y = radius * sinf(stackAngle);         // r * sin(u)
-
-		// Add (sectorCount+1) vertices per stack
-		for (int j = 0; j <= sectorCount; ++j) {
-			sectorAngle = j * sectorStep;
-
-			// Vertex position
-			x = xy * cosf(sectorAngle); // r * cos(u) * cos(v)
-			z = xy * sinf(sectorAngle); // r * cos(u) * sin(v)
-			vertices.push_back(x);
-			vertices.push_back(y);
-			vertices.push_back(z);
-		}
+// СĻΧ Cornell box ڱһ£ cubePos  scale 仯
+BallBounds ballBounds()
+{
+	return roomBallBounds(cubePos, scale);
+}
+
+// ó滻óȾֻһӡһڰһյƣֻõһ
+// өСȡһɫڵӾһ䡣
+// 򿪳ʱѼţҲڻķΧ
+void applyScene(const CompiledScene& scene)
+{
+	if (scene.roomCount() > 0)
+	{
+		const SceneRoom& room = scene.rooms()[0];
+		cubePos = glm::make_vec3(room.center);
+		scale = room.scale;
+		ImVec4* wallColors[WALL_COUNT];
+		wallColors[WALL_CEILING] = &celling_color;
+		wallColors[WALL_FLOOR] = &floor_color;
+		wallColors[WALL_LEFT] = &left_color;
+		wallColors[WALL_RIGHT] = &right_color;
+		wallColors[WALL_FRONT] = &front_color;
+		for (int wall = 0; wall < WALL_COUNT; ++wall)
+			*wallColors[wall] = ImVec4(room.wallColors[wall][0], room.wallColors[wall][1], room.wallColors[wall][2], 1.0f);
+	}
+	if (scene.boardCount() > 0)
+	{
+		const SceneBoard& board = scene.boards()[0];
+		chalkboardPosition = glm::make_vec3(board.position);
+		chalkboardSize = glm::make_vec3(board.size);
+		frameSize = glm::make_vec3(board.frameSize);
+		frameThickness = glm::vec3(board.frameThickness);
+		chalkboardTexturePath = scene.string(board.texture);
+		frameTexturePath = scene.string(board.frameTexture);
+	}
+	if (scene.lightCount() > 0)
+	{
+		const SceneLight& light = scene.lights()[0];
+		lightPos = glm::make_vec3(light.position);
+		light_color = ImVec4(light.color[0], light.color[1], light.color[2], 1.0f);
 	}
-	return vertices;
-}
\ No newline at end of file
+	if (scene.emitterCount() > 0)
+	{
+		const SceneEmitter& emitter = scene.emitters()[0];
+		fireflyCount = static_cast<int>(emitter.count);
+		fireflySeed = emitter.seed;
+	}
+	if (scene.ballSetCount() > 0)
+	{
+		const SceneBallSet& ballSet = scene.ballSets()[0];
+		ballCount = static_cast<int>(ballSet.count);
+		ballSeed = ballSet.seed;
+		ball_color = ImVec4(ballSet.tint[0], ballSet.tint[1], ballSet.tint[2], 1.0f);
+	}
+}
+
+// Ⱦִиǰ uniformɫѾɶа
+void setupWalls(const DrawPacket& /*packet*/, void* context)
+{
+	const SceneUniforms& scene = *static_cast<const SceneUniforms*>(context);
+	scene.roomShader->setMat4(UNIFORM("model"), scene.wallModel);
+	scene.roomShader->setVec3Array(UNIFORM("wallColors"), WALL_COUNT, scene.wallColors);
+}
+
+void setupLightCube(const DrawPacket& /*packet*/, void* context)
+{
+	const SceneUniforms& scene = *static_cast<const SceneUniforms*>(context);
+	scene.lightCubeShader->setMat4(UNIFORM("model"), scene.lightCubeModel);
+}
+
+void setupChalkboard(const DrawPacket& packet, void* context)
+{
+	const SceneUniforms& scene = *static_cast<const SceneUniforms*>(context);
+	scene.textureShader->setInt(UNIFORM("texture1"), static_cast<int>(packet.textureUnit)); // Ԫݸɫ
+	scene.textureShader->setBool(UNIFORM("useTexture1"), true); // ʹúڰ
+	scene.textureShader->setMat4(UNIFORM("model"), scene.chalkboardModel);
+}
+
+void setupFrame(const DrawPacket& packet, void* context)
+{
+	const SceneUniforms& scene = *static_cast<const SceneUniforms*>(context);
+	scene.textureShader->setInt(UNIFORM("texture2"), static_cast<int>(packet.textureUnit));
+	scene.textureShader->setBool(UNIFORM("useTexture1"), false); // ʹñ߿
+	scene.textureShader->setMat4(UNIFORM("model"), scene.frameModel);
+}
+
+// argument Ϊ 0 ʱ䣬Ϊ 1 ʱɫ
+void setupWindmill(const DrawPacket& packet, void* context)
+{
+	const SceneUniforms& scene = *static_cast<const SceneUniforms*>(context);
+	scene.lightingShader->setMat4(UNIFORM("model"), scene.windmillModel);
+	scene.lightingShader->setVec3(UNIFORM("objectColor"), packet.argument == 0 ? scene.windmillColor : glm::vec3(1.0f)); // Ϊɫ
+	glLineWidth(2.5f);
+}
+
+void setupFireflies(const DrawPacket& packet, void* context)
+{
+	const SceneUniforms& scene = *static_cast<const SceneUniforms*>(context);
+	scene.snowflakeShader->setFloat(UNIFORM("time"), scene.time);
+	scene.snowflakeShader->setFloat(UNIFORM("interpolation"), scene.fireflyInterpolation);
+	scene.snowflakeShader->setInt(UNIFORM("firstLayer"), static_cast<int>(packet.argument));
+}
+
+// ÿ LOD һargument ΪһʵGL 3.3 û base instanceΪƶʵԵ
+void setupBalls(const DrawPacket& packet, void* context)
+{
+	const SceneUniforms& scene = *static_cast<const SceneUniforms*>(context);
+	scene.ballShader->setVec3(UNIFORM("objectColor"), scene.ballTint); // Сɫɫ
+	scene.ballShader->setFloat(UNIFORM("interpolation"), scene.interpolation);
+	const GLsizei stride = 10 * sizeof(float);
+	size_t base = packet.argument * stride;
+	GLState::bindBuffer(GL_ARRAY_BUFFER, scene.ballInstanceVBO);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)base);
+	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(base + 3 * sizeof(float)));
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)(base + 4 * sizeof(float)));
+	glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, stride, (void*)(base + 7 * sizeof(float)));
+}
+
+// imgui Ⱦǰ״̬ӰӼǵ userData ָ GLState::Snapshot 
+void saveStateForImGui(void* userData)
+{
+	*static_cast<GLState::Snapshot*>(userData) = GLState::snapshot();
+}
+
+// imgui ȾȸӰӺ˸Ķʲô ImGui_ImplOpenGL3_SetupRenderState
+// ٻָ֮ǰ״ֻ̬вͬĲֲŻ GL
+void restoreStateAfterImGui(void* userData, int fbWidth, int fbHeight)
+{
+	const GLState::Snapshot& stateBeforeImGui = *static_cast<const GLState::Snapshot*>(userData);
+	GLState::Snapshot left = stateBeforeImGui;
+	// ɫ㻺塢0 ŵԪüȡһ
+	left.program = GLState::UNKNOWN;
+	left.buffers[GLState::ARRAY_BUFFER_SLOT] = GLState::UNKNOWN;
+	left.buffers[GLState::ELEMENT_BUFFER_SLOT] = GLState::UNKNOWN;
+	left.textures[0][GLState::TEXTURE_2D_SLOT] = GLState::UNKNOWN;
+	left.scissorBox[0] = GLState::UNKNOWN_RECT;
+	left.vertexArray = GLState::UNKNOWN; // Լ VAO Ȼ
+	left.activeTexture = GL_TEXTURE0;
+	left.enabled[GLState::BLEND] = GL_TRUE;
+	left.enabled[GLState::CULL_FACE] = GL_FALSE;
+	left.enabled[GLState::DEPTH_TEST] = GL_FALSE;
+	left.enabled[GLState::STENCIL_TEST] = GL_FALSE;
+	left.enabled[GLState::SCISSOR_TEST] = GL_TRUE;
+	left.enabled[GLState::PRIMITIVE_RESTART] = GL_FALSE;
+	left.blendEquation[0] = left.blendEquation[1] = GL_FUNC_ADD;
+	left.blendFunc[0] = GL_SRC_ALPHA;
+	left.blendFunc[1] = GL_ONE_MINUS_SRC_ALPHA;
+	left.blendFunc[2] = GL_ONE;
+	left.blendFunc[3] = GL_ONE_MINUS_SRC_ALPHA;
+	left.polygonMode = GL_FILL;
+	left.viewport[0] = 0;
+	left.viewport[1] = 0;
+	left.viewport[2] = fbWidth;
+	left.viewport[3] = fbHeight;
+	GLState::assume(left);
+	GLState::restore(stateBeforeImGui);
+}
@@ -0,0 +1,140 @@
+#include "mapped_file.h"
+
+#include <fstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    bool statFile(const char* path, uint64_t& size, int64_t& time)
+    {
+        struct stat status;
+        if (stat(path, &status) != 0)
+            return false;
+        size = static_cast<uint64_t>(status.st_size);
+        time = static_cast<int64_t>(status.st_mtime);
+        return true;
+    }
+
+    bool hashFile(const char* path, uint64_t& hash)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        hash = 14695981039346656037ull;
+        char buffer[65536];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+        {
+            for (std::streamsize i = 0; i < file.gcount(); ++i)
+                hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+        }
+        return true;
+    }
+}
+
+MappedFile::MappedFile()
+    : bytes(NULL), length(0)
+#ifdef _WIN32
+    , file(INVALID_HANDLE_VALUE), mapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path, size_t minimumSize)
+{
+    close();
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)minimumSize || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
+        bytes = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int descriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+        return false;
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size < (off_t)minimumSize || status.st_size == 0)
+    {
+        ::close(descriptor);
+        return false;
+    }
+    length = static_cast<size_t>(status.st_size);
+    void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    // the mapping keeps the file alive
+    ::close(descriptor);
+    if (view != MAP_FAILED)
+    {
+        // start reading ahead now, so the first reads do not wait on page faults
+        madvise(view, length, MADV_WILLNEED);
+        bytes = static_cast<const unsigned char*>(view);
+    }
+#endif
+    if (!bytes)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (bytes)
+        munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+    bytes = NULL;
+    length = 0;
+}
+
+bool stampSource(const char* path, SourceStamp& stamp)
+{
+    return statFile(path, stamp.size, stamp.time) && hashFile(path, stamp.hash);
+}
+
+bool isSourceCurrent(const char* path, const SourceStamp& stamp)
+{
+    uint64_t size;
+    int64_t time;
+    if (!statFile(path, size, time))
+        return true;
+    if (size != stamp.size)
+        return false;
+    if (time == stamp.time)
+        return true;
+    uint64_t hash;
+    return hashFile(path, hash) && hash == stamp.hash;
+}
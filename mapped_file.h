@@ -0,0 +1,52 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <stdint.h>
+
+// Read-only mapping of a whole file: mmap, or a file mapping on Windows. The
+// pages are only read from disk when they are touched, so opening a large
+// file costs about as much as opening a small one.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // fails for files smaller than minimumSize
+    bool open(const char* path, size_t minimumSize);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes;
+    size_t length;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+// What a cooked or compiled file records about the source it was made from.
+struct SourceStamp
+{
+    uint64_t size;
+    int64_t time;
+    uint64_t hash; // FNV-1a of the file
+};
+
+// size, time and hash of path; false if it cannot be read
+bool stampSource(const char* path, SourceStamp& stamp);
+
+// true if path is still the file stamp was taken from. A missing source counts
+// as current, so cooked files can ship alone. Sizes and times are compared
+// first; the source is only hashed when its time changed but its size did not
+// (e.g. after a fresh checkout).
+bool isSourceCurrent(const char* path, const SourceStamp& stamp);
+#endif
@@ -0,0 +1,367 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCCLUSION_X86 1
+#include <emmintrin.h>
+#endif
+
+OcclusionBuffer::OcclusionBuffer()
+    : viewProjection(1.0f), testBoxes(NULL), testObjects(NULL), testVisible(NULL)
+{
+    for (int level = 0; level < LEVEL_COUNT; ++level)
+    {
+        size_t texels = static_cast<size_t>(WIDTH >> level) * static_cast<size_t>(HEIGHT >> level);
+        nearest[level].assign(texels, 1.0f);
+        if (level > 0)
+            farthest[level].assign(texels, 1.0f);
+    }
+}
+
+void OcclusionBuffer::begin(const glm::mat4& newViewProjection)
+{
+    viewProjection = newViewProjection;
+    triangles.clear();
+}
+
+// occluders
+// ------------------------------------------------------------------------
+void OcclusionBuffer::addOccluder(const float* vertices, size_t stride, const unsigned int* indices, size_t count, const glm::mat4& model)
+{
+    glm::mat4 transform = viewProjection * model;
+    for (size_t i = 0; i + 2 < count; i += 3)
+    {
+        glm::vec4 clip[3];
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const float* position = vertices + stride * (indices ? indices[i + corner] : i + corner);
+            clip[corner] = transform * glm::vec4(position[0], position[1], position[2], 1.0f);
+        }
+        addTriangle(clip);
+    }
+}
+
+void OcclusionBuffer::addTriangle(const glm::vec4* clip)
+{
+    // clip against the near plane (z >= -w), which also keeps w positive;
+    // a triangle loses at most one corner and becomes a quad
+    glm::vec4 polygon[4];
+    int corners = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const glm::vec4& from = clip[i];
+        const glm::vec4& to = clip[(i + 1) % 3];
+        float fromDistance = from.z + from.w;
+        float toDistance = to.z + to.w;
+        if (fromDistance >= 0.0f)
+            polygon[corners++] = from;
+        if ((fromDistance >= 0.0f) != (toDistance >= 0.0f))
+        {
+            float t = fromDistance / (fromDistance - toDistance);
+            polygon[corners++] = from + (to - from) * t;
+        }
+    }
+    if (corners < 3)
+        return;
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < corners; ++i)
+    {
+        float inverseW = 1.0f / polygon[i].w;
+        screen[i] = glm::vec3((polygon[i].x * inverseW * 0.5f + 0.5f) * WIDTH, (polygon[i].y * inverseW * 0.5f + 0.5f) * HEIGHT,
+                              polygon[i].z * inverseW * 0.5f + 0.5f);
+    }
+    addScreenTriangle(screen);
+    if (corners == 4)
+    {
+        glm::vec3 second[3] = { screen[0], screen[2], screen[3] };
+        addScreenTriangle(second);
+    }
+}
+
+void OcclusionBuffer::addScreenTriangle(const glm::vec3* screen)
+{
+    glm::vec3 v[3] = { screen[0], screen[1], screen[2] };
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+    if (std::fabs(area) < 1e-6f)
+        return;
+    if (area < 0.0f)
+    {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+
+    // pixel (x, y) is sampled at (x + 0.5, y + 0.5)
+    float minX = std::min(std::min(v[0].x, v[1].x), v[2].x), maxX = std::max(std::max(v[0].x, v[1].x), v[2].x);
+    float minY = std::min(std::min(v[0].y, v[1].y), v[2].y), maxY = std::max(std::max(v[0].y, v[1].y), v[2].y);
+    Triangle triangle;
+    triangle.minX = static_cast<int>(std::ceil(glm::clamp(minX - 0.5f, 0.0f, static_cast<float>(WIDTH))));
+    triangle.maxX = static_cast<int>(std::floor(glm::clamp(maxX - 0.5f, -1.0f, WIDTH - 1.0f)));
+    triangle.minY = static_cast<int>(std::ceil(glm::clamp(minY - 0.5f, 0.0f, static_cast<float>(HEIGHT))));
+    triangle.maxY = static_cast<int>(std::floor(glm::clamp(maxY - 0.5f, -1.0f, HEIGHT - 1.0f)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    // counter-clockwise, so the inside is to the left of every edge
+    for (int i = 0; i < 3; ++i)
+    {
+        const glm::vec3& from = v[i];
+        const glm::vec3& to = v[(i + 1) % 3];
+        triangle.edgeA[i] = from.y - to.y;
+        triangle.edgeB[i] = to.x - from.x;
+        triangle.edgeC[i] = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+    }
+    glm::vec3 d1 = v[1] - v[0];
+    glm::vec3 d2 = v[2] - v[0];
+    triangle.depthA = (d1.z * d2.y - d2.z * d1.y) / area;
+    triangle.depthB = (d2.z * d1.x - d1.z * d2.x) / area;
+    triangle.depthC = v[0].z - triangle.depthA * v[0].x - triangle.depthB * v[0].y;
+    triangles.push_back(triangle);
+}
+
+// rasterization
+// ------------------------------------------------------------------------
+void OcclusionBuffer::rasterizeJob(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+{
+    OcclusionBuffer* buffer = static_cast<OcclusionBuffer*>(context);
+    for (size_t band = begin; band < end; ++band)
+        buffer->rasterizeBand(band);
+}
+
+void OcclusionBuffer::render(JobSystem& jobs)
+{
+    JobCounter counter;
+    jobs.parallelFor(HEIGHT / BAND_ROWS, 1, rasterizeJob, this, counter);
+    jobs.wait(counter);
+    for (int level = BAND_LEVELS + 1; level < LEVEL_COUNT; ++level)
+        buildLevel(level, 0, HEIGHT >> level);
+}
+
+void OcclusionBuffer::rasterizeBand(size_t band)
+{
+    const int firstRow = static_cast<int>(band) * BAND_ROWS;
+    const int endRow = firstRow + BAND_ROWS;
+    float* depth = &nearest[0][0];
+    std::fill(depth + firstRow * WIDTH, depth + endRow * WIDTH, 1.0f);
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        const Triangle& t = triangles[i];
+        int y0 = std::max(t.minY, firstRow);
+        int y1 = std::min(t.maxY, endRow - 1);
+        int x0 = t.minX & ~3; // WIDTH is a multiple of four, so whole groups stay in the row
+#ifdef OCCLUSION_X86
+        const __m128 columns = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 firstX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x0)), columns);
+        __m128 edgeStep[3];
+        for (int e = 0; e < 3; ++e)
+            edgeStep[e] = _mm_set1_ps(4.0f * t.edgeA[e]);
+        const __m128 depthStep = _mm_set1_ps(4.0f * t.depthA);
+        for (int y = y0; y <= y1; ++y)
+        {
+            float py = y + 0.5f;
+            __m128 edge[3];
+            for (int e = 0; e < 3; ++e)
+                edge[e] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.edgeA[e]), firstX), _mm_set1_ps(t.edgeB[e] * py + t.edgeC[e]));
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.depthA), firstX), _mm_set1_ps(t.depthB * py + t.depthC));
+            float* row = depth + y * WIDTH;
+            for (int x = x0; x <= t.maxX; x += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)), _mm_cmpge_ps(edge[2], zero));
+                if (_mm_movemask_ps(inside))
+                {
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 closer = _mm_min_ps(old, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+                }
+                for (int e = 0; e < 3; ++e)
+                    edge[e] = _mm_add_ps(edge[e], edgeStep[e]);
+                z = _mm_add_ps(z, depthStep);
+            }
+        }
+#else
+        for (int y = y0; y <= y1; ++y)
+        {
+            float py = y + 0.5f;
+            float* row = depth + y * WIDTH;
+            for (int x = x0; x <= t.maxX; ++x)
+            {
+                float px = x + 0.5f;
+                if (t.edgeA[0] * px + t.edgeB[0] * py + t.edgeC[0] >= 0.0f && t.edgeA[1] * px + t.edgeB[1] * py + t.edgeC[1] >= 0.0f &&
+                    t.edgeA[2] * px + t.edgeB[2] * py + t.edgeC[2] >= 0.0f)
+                    row[x] = std::min(row[x], t.depthA * px + t.depthB * py + t.depthC);
+            }
+        }
+#endif
+    }
+
+    // the band's rows of the levels that fit in it
+    for (int level = 1; level <= BAND_LEVELS; ++level)
+        buildLevel(level, firstRow >> level, endRow >> level);
+}
+
+void OcclusionBuffer::buildLevel(int level, int firstRow, int endRow)
+{
+    const int width = WIDTH >> level;
+    const int childWidth = width * 2;
+    const float* childNearest = &nearest[level - 1][0];
+    const float* childFarthest = level == 1 ? childNearest : &farthest[level - 1][0];
+    float* levelNearest = &nearest[level][0];
+    float* levelFarthest = &farthest[level][0];
+    for (int y = firstRow; y < endRow; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            size_t a = static_cast<size_t>(2 * y) * childWidth + 2 * x;
+            size_t b = a + childWidth;
+            levelNearest[y * width + x] = std::min(std::min(childNearest[a], childNearest[a + 1]), std::min(childNearest[b], childNearest[b + 1]));
+            levelFarthest[y * width + x] = std::max(std::max(childFarthest[a], childFarthest[a + 1]), std::max(childFarthest[b], childFarthest[b + 1]));
+        }
+    }
+}
+
+// tests
+// ------------------------------------------------------------------------
+bool OcclusionBuffer::isOccluded(const BoundingBox& box) const
+{
+    // the corners in clip space are the min corner plus any of the three
+    // scaled matrix columns, so projecting them takes additions only
+    glm::vec4 origin = viewProjection * glm::vec4(box.min, 1.0f);
+    glm::vec3 size = box.max - box.min;
+    glm::vec4 stepX = viewProjection[0] * size.x;
+    glm::vec4 stepY = viewProjection[1] * size.y;
+    glm::vec4 stepZ = viewProjection[2] * size.z;
+    float minX, minY, maxX, maxY, depth;
+#ifdef OCCLUSION_X86
+    // four corners per register, one register per coordinate
+    const __m128 alongX = _mm_setr_ps(0.0f, 1.0f, 0.0f, 1.0f);
+    const __m128 alongY = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    __m128 low[3], high[3], nearestDepth = _mm_set1_ps(FLT_MAX);
+    for (int half = 0; half < 2; ++half)
+    {
+        __m128 clip[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            float base = origin[c] + (half ? stepZ[c] : 0.0f);
+            clip[c] = _mm_add_ps(_mm_set1_ps(base), _mm_add_ps(_mm_mul_ps(alongX, _mm_set1_ps(stepX[c])), _mm_mul_ps(alongY, _mm_set1_ps(stepY[c]))));
+        }
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(clip[2], clip[3]), _mm_setzero_ps())))
+            return false; // reaches past the near plane
+        __m128 halfInverseW = _mm_div_ps(_mm_set1_ps(0.5f), clip[3]);
+        __m128 x = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(clip[0], halfInverseW), _mm_set1_ps(0.5f)), _mm_set1_ps(static_cast<float>(WIDTH)));
+        __m128 y = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(clip[1], halfInverseW), _mm_set1_ps(0.5f)), _mm_set1_ps(static_cast<float>(HEIGHT)));
+        __m128 z = _mm_add_ps(_mm_mul_ps(clip[2], halfInverseW), _mm_set1_ps(0.5f));
+        low[0] = half ? _mm_min_ps(low[0], x) : x;
+        high[0] = half ? _mm_max_ps(high[0], x) : x;
+        low[1] = half ? _mm_min_ps(low[1], y) : y;
+        high[1] = half ? _mm_max_ps(high[1], y) : y;
+        nearestDepth = _mm_min_ps(nearestDepth, z);
+    }
+    float lanes[4][4];
+    _mm_storeu_ps(lanes[0], low[0]);
+    _mm_storeu_ps(lanes[1], high[0]);
+    _mm_storeu_ps(lanes[2], low[1]);
+    _mm_storeu_ps(lanes[3], high[1]);
+    float depths[4];
+    _mm_storeu_ps(depths, nearestDepth);
+    minX = std::min(std::min(lanes[0][0], lanes[0][1]), std::min(lanes[0][2], lanes[0][3]));
+    maxX = std::max(std::max(lanes[1][0], lanes[1][1]), std::max(lanes[1][2], lanes[1][3]));
+    minY = std::min(std::min(lanes[2][0], lanes[2][1]), std::min(lanes[2][2], lanes[2][3]));
+    maxY = std::max(std::max(lanes[3][0], lanes[3][1]), std::max(lanes[3][2], lanes[3][3]));
+    depth = std::min(std::min(depths[0], depths[1]), std::min(depths[2], depths[3]));
+#else
+    minX = minY = depth = FLT_MAX;
+    maxX = maxY = -FLT_MAX;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec4 clip = origin;
+        if (corner & 1)
+            clip = clip + stepX;
+        if (corner & 2)
+            clip = clip + stepY;
+        if (corner & 4)
+            clip = clip + stepZ;
+        if (clip.z < -clip.w)
+            return false; // reaches past the near plane
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * WIDTH;
+        float y = (clip.y * inverseW * 0.5f + 0.5f) * HEIGHT;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        depth = std::min(depth, clip.z * inverseW * 0.5f + 0.5f);
+    }
+#endif
+
+    // the texels the box reaches, one more on every side (truncating after
+    // the shift by 2 rounds down, as the coordinates are clamped to at least -2)
+    int x0 = std::max(static_cast<int>(glm::clamp(minX, -2.0f, WIDTH + 1.0f) + 2.0f) - 3, 0);
+    int x1 = std::min(static_cast<int>(glm::clamp(maxX, -2.0f, WIDTH + 1.0f) + 2.0f) - 1, WIDTH - 1);
+    int y0 = std::max(static_cast<int>(glm::clamp(minY, -2.0f, HEIGHT + 1.0f) + 2.0f) - 3, 0);
+    int y1 = std::min(static_cast<int>(glm::clamp(maxY, -2.0f, HEIGHT + 1.0f) + 2.0f) - 1, HEIGHT - 1);
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    // start at the finest level where the rectangle spans at most 2x2 texels
+    int level = 0;
+    while (level < LEVEL_COUNT - 1 && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        ++level;
+    for (int y = y0 >> level; y <= (y1 >> level); ++y)
+        for (int x = x0 >> level; x <= (x1 >> level); ++x)
+            if (isVisibleIn(level, x, y, x0, y0, x1, y1, depth))
+                return false;
+    return true;
+}
+
+// Whether a box whose nearest depth is depth could be seen anywhere in texel
+// (x, y) of level, within the level 0 rectangle (minX, minY)-(maxX, maxY).
+// Descends only into texels where the occluders are partly in front of it.
+bool OcclusionBuffer::isVisibleIn(int level, int x, int y, int minX, int minY, int maxX, int maxY, float depth) const
+{
+    size_t index = static_cast<size_t>(y) * (WIDTH >> level) + x;
+    if (level == 0)
+        return depth <= nearest[0][index];
+    if (depth > farthest[level][index])
+        return false;
+    if (depth <= nearest[level][index])
+        return true;
+    int child = level - 1;
+    for (int cy = std::max(2 * y, minY >> child); cy <= std::min(2 * y + 1, maxY >> child); ++cy)
+        for (int cx = std::max(2 * x, minX >> child); cx <= std::min(2 * x + 1, maxX >> child); ++cx)
+            if (isVisibleIn(child, cx, cy, minX, minY, maxX, maxY, depth))
+                return true;
+    return false;
+}
+
+void OcclusionBuffer::testJob(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+{
+    OcclusionBuffer* buffer = static_cast<OcclusionBuffer*>(context);
+    for (size_t i = begin; i < end; ++i)
+    {
+        uint32_t object = buffer->testObjects[i];
+        if (buffer->testVisible[object] && buffer->isOccluded(buffer->testBoxes[object]))
+            buffer->testVisible[object] = 0;
+    }
+}
+
+size_t OcclusionBuffer::cull(JobSystem& jobs, const BoundingBox* boxes, const uint32_t* objects, size_t count, unsigned char* visible)
+{
+    size_t before = 0;
+    for (size_t i = 0; i < count; ++i)
+        before += visible[objects[i]] ? 1 : 0;
+    testBoxes = boxes;
+    testObjects = objects;
+    testVisible = visible;
+    JobCounter counter;
+    jobs.parallelFor(count, TEST_CHUNK_SIZE, testJob, this, counter);
+    jobs.wait(counter);
+    size_t after = 0;
+    for (size_t i = 0; i < count; ++i)
+        after += visible[objects[i]] ? 1 : 0;
+    return before - after;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "job_system.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+// Software occlusion culling. A few large occluders (the walls, the
+// chalkboard) are rasterized on the CPU into a small depth buffer, from which
+// a pyramid of the nearest and farthest depth in every 2x2 block is built.
+// Bounding boxes that survived frustum culling are then tested against the
+// pyramid: a box is occluded when its nearest point lies behind the farthest
+// occluder everywhere its screen rectangle reaches.
+//
+// Rasterization is split into bands of rows that run as jobs, four pixels at
+// a time with SSE where available; each band also builds its part of the
+// first pyramid levels. The tests are split into chunks of boxes.
+//
+// The buffer samples occluders at texel centres, so an occluder edge may
+// claim a texel it only partly covers; tests widen the box rectangle by one
+// texel to stay conservative. Occluders must be opaque and closed from every
+// side they are seen from: both faces of a triangle occlude.
+class OcclusionBuffer
+{
+public:
+    enum { WIDTH = 256, HEIGHT = 128, LEVEL_COUNT = 8 };  // top level is 2x1
+    enum { BAND_ROWS = 16, BAND_LEVELS = 4 };              // levels 1 to 4 are built per band
+    enum { TEST_CHUNK_SIZE = 512 };
+
+    OcclusionBuffer();
+
+    // clears the depth buffer and the occluder list for a new view
+    void begin(const glm::mat4& viewProjection);
+    // adds the triangles of a mesh: positions are the first three floats of
+    // every vertex, stride floats apart; indices may be NULL for a plain triangle list
+    void addOccluder(const float* vertices, size_t stride, const unsigned int* indices, size_t count, const glm::mat4& model);
+    // rasterizes the occluders and builds the depth pyramid
+    void render(JobSystem& jobs);
+
+    bool isOccluded(const BoundingBox& box) const;
+    // clears visible[objects[i]] for every occluded boxes[objects[i]] that is
+    // still visible; returns how many it cleared
+    size_t cull(JobSystem& jobs, const BoundingBox* boxes, const uint32_t* objects, size_t count, unsigned char* visible);
+
+    size_t triangleCount() const { return triangles.size(); }
+
+private:
+    // screen space triangle: edge functions a * x + b * y + c, positive inside,
+    // and depth as a plane over the screen
+    struct Triangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    glm::mat4 viewProjection;
+    std::vector<Triangle> triangles;
+    std::vector<float> nearest[LEVEL_COUNT];   // level 0 is the depth buffer itself
+    std::vector<float> farthest[LEVEL_COUNT];  // from level 1 on
+
+    // the arguments of the cull() in progress, for its jobs
+    const BoundingBox* testBoxes;
+    const uint32_t* testObjects;
+    unsigned char* testVisible;
+
+    void addTriangle(const glm::vec4* clip);
+    void addScreenTriangle(const glm::vec3* screen);
+    void rasterizeBand(size_t band);
+    void buildLevel(int level, int firstRow, int endRow);
+    bool isVisibleIn(int level, int x, int y, int minX, int minY, int maxX, int maxY, float depth) const;
+
+    static void rasterizeJob(void* context, size_t begin, size_t end, size_t chunkIndex);
+    static void testJob(void* context, size_t begin, size_t end, size_t chunkIndex);
+
+    OcclusionBuffer(const OcclusionBuffer&);
+    OcclusionBuffer& operator=(const OcclusionBuffer&);
+};
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// A framebuffer object with an RGBA8 color and a 24-bit depth renderbuffer,
+// used in place of the window's default framebuffer when rendering offscreen.
+// Its size is independent of any window, so captures have the same resolution
+// on every machine.
+class OffscreenTarget
+{
+public:
+    unsigned int ID;
+
+    OffscreenTarget(int width, int height) : ID(0), colorBuffer(0), depthBuffer(0), targetWidth(width), targetHeight(height)
+    {
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &ID);
+        glBindFramebuffer(GL_FRAMEBUFFER, ID);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // deletes the framebuffer and its attachments; call while the context is still current
+    void release()
+    {
+        glDeleteFramebuffers(1, &ID);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        ID = colorBuffer = depthBuffer = 0;
+    }
+
+    bool isComplete() const { return complete; }
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+
+    // makes this the draw and read framebuffer and sets the viewport to cover it
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, ID);
+        GLState::viewport(0, 0, targetWidth, targetHeight);
+    }
+
+    // reads the color buffer back as tightly packed RGB rows, top row first;
+    // waits for the frame to finish rendering
+    void readPixels(std::vector<unsigned char>& rgb) const
+    {
+        size_t rowBytes = static_cast<size_t>(targetWidth) * 3;
+        rgb.resize(rowBytes * targetHeight);
+        std::vector<unsigned char> row(rowBytes);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, ID);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, targetWidth, targetHeight, GL_RGB, GL_UNSIGNED_BYTE, &rgb[0]);
+        // GL returns the bottom row first
+        for (int y = 0; y < targetHeight / 2; ++y)
+        {
+            unsigned char* top = &rgb[y * rowBytes];
+            unsigned char* bottom = &rgb[(targetHeight - 1 - y) * rowBytes];
+            std::copy(top, top + rowBytes, row.begin());
+            std::copy(bottom, bottom + rowBytes, top);
+            std::copy(row.begin(), row.end(), bottom);
+        }
+    }
+
+private:
+    unsigned int colorBuffer;
+    unsigned int depthBuffer;
+    int targetWidth;
+    int targetHeight;
+    bool complete;
+
+    OffscreenTarget(const OffscreenTarget&);
+    OffscreenTarget& operator=(const OffscreenTarget&);
+};
+#endif
@@ -0,0 +1,192 @@
+#pragma once
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// glProgramBinary is core since GL 4.1 and otherwise needs ARB_get_program_binary;
+// with a loader generated for plain 3.3 the cache compiles to nothing.
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+#define PROGRAM_CACHE_SUPPORTED 1
+#endif
+
+// On-disk cache of linked program binaries. A program is keyed by a 64-bit
+// FNV-1a hash of its sources (and anything else that changes the link result)
+// together with the driver's vendor, renderer and version strings, so a driver
+// update simply misses. A binary the driver rejects falls back to compiling
+// from source and is overwritten.
+class ProgramBinaryCache
+{
+public:
+    // counters for the startup report
+    struct Stats
+    {
+        int loaded;
+        int compiled;
+        double seconds; // total time spent creating programs
+    };
+
+    // cache files go to directory, which is created if needed; empty disables the cache
+    static void setDirectory(const std::string& directory)
+    {
+        state().directory = directory;
+        if (!directory.empty())
+        {
+#ifdef _WIN32
+            _mkdir(directory.c_str());
+#else
+            mkdir(directory.c_str(), 0755);
+#endif
+        }
+    }
+
+    // true once a directory is set and the context can save and load binaries
+    static bool enabled()
+    {
+#ifdef PROGRAM_CACHE_SUPPORTED
+        State& s = state();
+        if (s.directory.empty())
+            return false;
+        if (s.formatCount < 0)
+        {
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            while (glGetError() != GL_NO_ERROR) {}
+            s.formatCount = formats;
+        }
+        return s.formatCount > 0;
+#else
+        return false;
+#endif
+    }
+
+    // hash of the given strings plus the driver identification
+    static std::string key(const std::vector<std::string>& parts)
+    {
+        unsigned long long hash = 14695981039346656037ull;
+        for (size_t i = 0; i < parts.size(); ++i)
+            hash = hashString(hash, parts[i].c_str(), parts[i].size());
+        const GLenum driverStrings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (int i = 0; i < 3; ++i)
+        {
+            const char* value = reinterpret_cast<const char*>(glGetString(driverStrings[i]));
+            std::string text = value ? value : "";
+            hash = hashString(hash, text.c_str(), text.size());
+        }
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", hash);
+        return hex;
+    }
+
+    // tries to fill program from the cache; returns true if it is linked and usable
+    static bool load(GLuint program, const std::string& key)
+    {
+#ifdef PROGRAM_CACHE_SUPPORTED
+        if (!enabled())
+            return false;
+        std::ifstream file(path(key).c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        FileHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != MAGIC || header.length <= 0)
+            return false;
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), header.length))
+            return false;
+
+        glProgramBinary(program, header.format, binary.data(), header.length);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        while (glGetError() != GL_NO_ERROR) {}
+        if (!linked)
+            std::cout << "SHADER_CACHE::REJECTED " << key << ", compiling from source" << std::endl;
+        return linked == GL_TRUE;
+#else
+        return false;
+#endif
+    }
+
+    // asks the driver to keep the binary of program retrievable; call before linking
+    static void prepare(GLuint program)
+    {
+#ifdef PROGRAM_CACHE_SUPPORTED
+        if (enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+    }
+
+    // writes the binary of a successfully linked program to the cache
+    static void store(GLuint program, const std::string& key)
+    {
+#ifdef PROGRAM_CACHE_SUPPORTED
+        if (!enabled())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        FileHeader header;
+        header.magic = MAGIC;
+        glGetProgramBinary(program, length, &header.length, &header.format, binary.data());
+        if (header.length <= 0)
+            return;
+        std::ofstream file(path(key).c_str(), std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), header.length);
+#endif
+    }
+
+    static Stats& stats()
+    {
+        return state().stats;
+    }
+
+private:
+    enum { MAGIC = 0x42505353 }; // "SSPB"
+    struct FileHeader
+    {
+        unsigned int magic;
+        GLenum format;
+        GLsizei length;
+    };
+    struct State
+    {
+        std::string directory;
+        int formatCount;
+        Stats stats;
+    };
+
+    // header-only, so the shared state lives in a function-local static
+    static State& state()
+    {
+        static State s = { std::string(), -1, { 0, 0, 0.0 } };
+        return s;
+    }
+
+    static std::string path(const std::string& key)
+    {
+        return state().directory + "/" + key + ".bin";
+    }
+
+    static unsigned long long hashString(unsigned long long hash, const char* data, size_t length)
+    {
+        for (size_t i = 0; i < length; ++i)
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+        // separator, so ("ab", "c") and ("a", "bc") differ
+        return (hash ^ 0xffu) * 1099511628211ull;
+    }
+};
+#endif
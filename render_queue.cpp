@@ -0,0 +1,212 @@
+#include "render_queue.h"
+
+#include "frame_profiler.h"
+#include "gl_state.h"
+
+#include <algorithm>
+
+namespace
+{
+    const int NAME_BITS = 12;
+    const int DEPTH_BITS = 24;
+    const uint64_t NAME_MASK = (uint64_t(1) << NAME_BITS) - 1;
+    const uint64_t DEPTH_MASK = (uint64_t(1) << DEPTH_BITS) - 1;
+
+    uint64_t quantizeDepth(float depth)
+    {
+        depth = std::min(std::max(depth, 0.0f), 1.0f);
+        return static_cast<uint64_t>(depth * static_cast<float>(DEPTH_MASK)) & DEPTH_MASK;
+    }
+
+    void applyBlend(int blend)
+    {
+        if (blend == RenderQueue::BLEND_NONE)
+        {
+            GLState::disable(GL_BLEND);
+            return;
+        }
+        GLState::enable(GL_BLEND);
+        if (blend == RenderQueue::BLEND_ADDITIVE)
+            GLState::blendFunc(GL_SRC_ALPHA, GL_ONE);
+        else
+            GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    void draw(const DrawPacket& packet)
+    {
+        if (packet.indexType == 0)
+        {
+            if (packet.instanceCount > 0)
+                glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instanceCount);
+            else
+                glDrawArrays(packet.mode, packet.first, packet.count);
+            return;
+        }
+        size_t indexSize = packet.indexType == GL_UNSIGNED_INT ? 4 : packet.indexType == GL_UNSIGNED_SHORT ? 2 : 1;
+        const void* offset = reinterpret_cast<const void*>(static_cast<size_t>(packet.first) * indexSize);
+        if (packet.instanceCount > 0)
+            glDrawElementsInstanced(packet.mode, packet.count, packet.indexType, offset, packet.instanceCount);
+        else
+            glDrawElements(packet.mode, packet.count, packet.indexType, offset);
+    }
+}
+
+DrawPacket DrawPacket::arrays(GLuint program, GLuint vertexArray, GLenum mode, GLint first, GLsizei count)
+{
+    DrawPacket packet = {};
+    packet.program = program;
+    packet.vertexArray = vertexArray;
+    packet.blend = RenderQueue::BLEND_NONE;
+    packet.depthWrite = true;
+    packet.profilePass = -1;
+    packet.mode = mode;
+    packet.first = first;
+    packet.count = count;
+    return packet;
+}
+
+DrawPacket DrawPacket::elements(GLuint program, GLuint vertexArray, GLenum mode, GLenum indexType, GLint first, GLsizei count)
+{
+    DrawPacket packet = arrays(program, vertexArray, mode, first, count);
+    packet.indexType = indexType;
+    return packet;
+}
+
+uint64_t RenderQueue::makeKey(Layer layer, BlendMode blend, GLuint program, GLuint texture, GLuint vertexArray, float depth)
+{
+    uint64_t key = (uint64_t(layer) & 3) << 62 | (uint64_t(blend) & 3) << 60;
+    uint64_t state = (program & NAME_MASK) << (2 * NAME_BITS) | (texture & NAME_MASK) << NAME_BITS | (vertexArray & NAME_MASK);
+    if (layer == OPAQUE_LAYER)
+        return key | state << DEPTH_BITS | quantizeDepth(depth);
+    return key | (DEPTH_MASK - quantizeDepth(depth)) << (3 * NAME_BITS) | state;
+}
+
+float RenderQueue::viewDepth(const glm::mat4& view, const glm::vec3& position, float farPlane)
+{
+    float distance = -(view * glm::vec4(position, 1.0f)).z;
+    return distance / farPlane;
+}
+
+RenderQueue::RenderQueue()
+    : lastStateChanges(0)
+{
+}
+
+void RenderQueue::clear()
+{
+    packets.clear();
+    order.clear();
+}
+
+void RenderQueue::submit(const DrawPacket& packet, Layer layer, float depth)
+{
+    packets.push_back(packet);
+    DrawPacket& queued = packets.back();
+    queued.key = makeKey(layer, static_cast<BlendMode>(packet.blend), packet.program, packet.texture, packet.vertexArray, depth);
+    SortItem item = { queued.key, static_cast<uint32_t>(packets.size() - 1) };
+    order.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+    size_t count = order.size();
+    if (count < 2)
+        return;
+    scratch.resize(count);
+
+    // bits in which some keys differ; bytes without any are left out
+    uint64_t first = order[0].key;
+    uint64_t differing = 0;
+    for (size_t i = 1; i < count; ++i)
+        differing |= order[i].key ^ first;
+
+    SortItem* source = &order[0];
+    SortItem* target = &scratch[0];
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        if (((differing >> shift) & 0xFF) == 0)
+            continue;
+        size_t offsets[256] = {};
+        for (size_t i = 0; i < count; ++i)
+            ++offsets[(source[i].key >> shift) & 0xFF];
+        size_t sum = 0;
+        for (int digit = 0; digit < 256; ++digit)
+        {
+            size_t digitCount = offsets[digit];
+            offsets[digit] = sum;
+            sum += digitCount;
+        }
+        for (size_t i = 0; i < count; ++i)
+            target[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+        std::swap(source, target);
+    }
+    if (source != &order[0])
+        order.swap(scratch);
+}
+
+void RenderQueue::execute(FrameProfiler* profiler)
+{
+    // what the previous packet set up; UNKNOWN forces the first packet to set everything
+    GLuint program = GLState::UNKNOWN;
+    GLuint vertexArray = GLState::UNKNOWN;
+    GLuint textures[GLState::MAX_TEXTURE_UNITS];
+    std::fill(textures, textures + GLState::MAX_TEXTURE_UNITS, GLState::UNKNOWN);
+    int blend = -1;
+    int depthWrite = -1;
+    int profilePass = -1;
+    size_t changes = 0;
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const DrawPacket& packet = packets[order[i].packet];
+        if (profiler && packet.profilePass != profilePass)
+        {
+            if (profilePass >= 0)
+                profiler->endPass(profilePass);
+            profilePass = packet.profilePass;
+            if (profilePass >= 0)
+                profiler->beginPass(profilePass);
+        }
+        if (packet.blend != blend)
+        {
+            applyBlend(packet.blend);
+            blend = packet.blend;
+            ++changes;
+        }
+        if (int(packet.depthWrite) != depthWrite)
+        {
+            GLState::depthMask(packet.depthWrite ? GL_TRUE : GL_FALSE);
+            depthWrite = int(packet.depthWrite);
+            ++changes;
+        }
+        if (packet.program != program)
+        {
+            GLState::useProgram(packet.program);
+            program = packet.program;
+            ++changes;
+        }
+        if (packet.texture != 0 && packet.textureUnit < GLState::MAX_TEXTURE_UNITS && packet.texture != textures[packet.textureUnit])
+        {
+            GLState::bindTextureUnit(packet.textureUnit, GL_TEXTURE_2D, packet.texture);
+            textures[packet.textureUnit] = packet.texture;
+            ++changes;
+        }
+        if (packet.vertexArray != vertexArray)
+        {
+            GLState::bindVertexArray(packet.vertexArray);
+            vertexArray = packet.vertexArray;
+            ++changes;
+        }
+        if (packet.setup)
+            packet.setup(packet, packet.context);
+        draw(packet);
+    }
+
+    if (profiler && profilePass >= 0)
+        profiler->endPass(profilePass);
+    if (blend != BLEND_NONE && blend != -1)
+        applyBlend(BLEND_NONE);
+    if (depthWrite == 0)
+        GLState::depthMask(GL_TRUE);
+    lastStateChanges = changes;
+}
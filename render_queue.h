@@ -0,0 +1,101 @@
+#pragma once
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FrameProfiler;
+
+// One draw call and the state it needs. Packets are plain values: everything
+// the draw depends on besides uniforms is in here, and uniforms are set by the
+// setup function, which runs after the packet's program is bound.
+struct DrawPacket
+{
+    typedef void (*SetupFunction)(const DrawPacket& packet, void* context);
+
+    uint64_t key;              // from RenderQueue::makeKey(); decides the order
+    GLuint program;
+    GLuint vertexArray;
+    GLuint texture;            // 0 for none
+    GLuint textureUnit;        // unit the texture is bound to
+    int blend;                 // RenderQueue::BlendMode
+    bool depthWrite;           // false leaves the depth buffer untouched (depth test still applies)
+    int profilePass;           // FrameProfiler pass the draw is timed in, -1 for none
+
+    GLenum mode;               // GL_TRIANGLES, GL_POINTS, ...
+    GLenum indexType;          // 0 for glDrawArrays*, otherwise the type of the bound element buffer
+    GLint first;               // first vertex, or first index for indexed draws
+    GLsizei count;
+    GLsizei instanceCount;     // 0 for a draw without instancing
+
+    SetupFunction setup;       // may be NULL
+    void* context;
+    unsigned int argument;     // passed through to setup, e.g. an instance offset
+
+    // draws without texture, blending, instancing, profiling or setup, with depth
+    // writes on; set those fields afterwards
+    static DrawPacket arrays(GLuint program, GLuint vertexArray, GLenum mode, GLint first, GLsizei count);
+    static DrawPacket elements(GLuint program, GLuint vertexArray, GLenum mode, GLenum indexType, GLint first, GLsizei count);
+};
+
+// Collects the draws of a frame, orders them by their 64-bit keys and issues
+// them with as few state changes as the order allows.
+//
+// Key layout, from the most significant bit:
+//   opaque:      layer:2 | blend:2 | program:12 | texture:12 | vertex array:12 | depth:24
+//   translucent: layer:2 | blend:2 | inverted depth:24 | program:12 | texture:12 | vertex array:12
+// Opaque draws are grouped by state and then go front to back, so within a
+// group early-Z rejects what is hidden; translucent draws go back to front,
+// which blending needs, and only share state where depths tie. GL names are
+// masked to their field: two names that collide only sort next to each other,
+// the executor still compares the real values.
+//
+// The sort is a stable LSD radix sort over the keys, one byte per pass,
+// skipping bytes in which all keys agree. Draws with equal keys keep their
+// submission order.
+class RenderQueue
+{
+public:
+    enum Layer { OPAQUE_LAYER, TRANSLUCENT_LAYER };
+    enum BlendMode { BLEND_NONE, BLEND_ALPHA, BLEND_ADDITIVE };
+
+    // depth in [0, 1], 0 at the camera; values outside are clamped
+    static uint64_t makeKey(Layer layer, BlendMode blend, GLuint program, GLuint texture, GLuint vertexArray, float depth);
+    // distance of a world space point in front of the camera as a fraction of farPlane
+    static float viewDepth(const glm::mat4& view, const glm::vec3& position, float farPlane);
+
+    RenderQueue();
+
+    void clear();
+    // fills in the key from the packet's fields; the packet is copied
+    void submit(const DrawPacket& packet, Layer layer, float depth);
+    void sort();
+    // issues the sorted draws; blending is left disabled and depth writes
+    // enabled. profiler may be NULL
+    void execute(FrameProfiler* profiler);
+
+    size_t size() const { return packets.size(); }
+    // state changes issued by the last execute(), not counting setup functions
+    size_t stateChanges() const { return lastStateChanges; }
+
+private:
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    std::vector<DrawPacket> packets;
+    std::vector<SortItem> order;
+    std::vector<SortItem> scratch;
+    size_t lastStateChanges;
+
+    RenderQueue(const RenderQueue&);
+    RenderQueue& operator=(const RenderQueue&);
+};
+#endif
@@ -0,0 +1,38 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Normal;
+in vec3 FragPos;
+flat in int Material;
+
+// one colour per wall, indexed by the per-vertex material index
+uniform vec3 wallColors[5];
+
+void main()
+{
+    // ambient
+    float ambientStrength = 0.5;
+    vec3 ambient = ambientStrength * lightColor.rgb;
+
+    // diffuse
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(lightPos.xyz - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor.rgb;
+
+    // specular
+    float specularStrength = 0.7;
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * lightColor.rgb;
+
+    // point lights
+    vec3 clusterDiffuse = vec3(0.0), clusterSpecular = vec3(0.0);
+    addClusterLights(FragPos, norm, viewDir, clusterDiffuse, clusterSpecular);
+    diffuse += clusterDiffuse;
+    specular += specularStrength * clusterSpecular;
+
+    vec3 result = (ambient + diffuse + specular) * wallColors[Material];
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,540 @@
+#include "scene_file.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    uint64_t alignUp(uint64_t value)
+    {
+        return (value + 15) & ~static_cast<uint64_t>(15);
+    }
+
+    void setVec3(float* target, float x, float y, float z)
+    {
+        target[0] = x;
+        target[1] = y;
+        target[2] = z;
+    }
+
+    uint32_t clampCount(uint32_t count, uint32_t minimum, uint32_t maximum)
+    {
+        return std::min(std::max(count, minimum), maximum);
+    }
+
+    bool countInRange(uint32_t count, uint32_t minimum, uint32_t maximum)
+    {
+        return count >= minimum && count <= maximum;
+    }
+
+    uint32_t addString(SceneDescription& scene, const std::string& text)
+    {
+        uint32_t offset = static_cast<uint32_t>(scene.strings.size());
+        scene.strings += text;
+        scene.strings += '\0';
+        return offset;
+    }
+
+    // Reads the properties of one entity from a line's remaining tokens.
+    class PropertyReader
+    {
+    public:
+        PropertyReader(std::istringstream& tokens, std::string& error) : tokens(tokens), error(error) {}
+
+        bool next(std::string& name) { return static_cast<bool>(tokens >> name); }
+
+        bool floats(const std::string& name, float* values, int count)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                std::string token;
+                char* end = NULL;
+                if (!(tokens >> token) || (values[i] = std::strtof(token.c_str(), &end), *end != '\0'))
+                    return fail("'" + name + "' expects " + std::to_string(count) + (count == 1 ? " number" : " numbers"));
+            }
+            return true;
+        }
+
+        bool integer(const std::string& name, uint32_t& value)
+        {
+            std::string token;
+            char* end = NULL;
+            unsigned long parsed = 0;
+            if (!(tokens >> token) || token[0] == '-' || (parsed = std::strtoul(token.c_str(), &end, 10), *end != '\0') || parsed > 0xFFFFFFFFul)
+                return fail("'" + name + "' expects a non-negative integer");
+            value = static_cast<uint32_t>(parsed);
+            return true;
+        }
+
+        bool word(const std::string& name, SceneDescription& scene, uint32_t& offset)
+        {
+            std::string token;
+            if (!(tokens >> token))
+                return fail("'" + name + "' expects a file name");
+            offset = addString(scene, token);
+            return true;
+        }
+
+        bool unknown(const std::string& kind, const std::string& name) { return fail("unknown " + kind + " property '" + name + "'"); }
+
+    private:
+        std::istringstream& tokens;
+        std::string& error;
+
+        bool fail(const std::string& message)
+        {
+            error = message;
+            return false;
+        }
+    };
+
+    bool parseRoom(PropertyReader& reader, SceneRoom& room)
+    {
+        static const char* wallNames[WALL_COUNT] = { "ceiling", "floor", "left", "right", "front" };
+        std::string name;
+        while (reader.next(name))
+        {
+            bool known = false;
+            for (int wall = 0; wall < WALL_COUNT && !known; ++wall)
+            {
+                if (name == wallNames[wall])
+                {
+                    if (!reader.floats(name, room.wallColors[wall], 3))
+                        return false;
+                    known = true;
+                }
+            }
+            if (known)
+                continue;
+            if (name == "center") { if (!reader.floats(name, room.center, 3)) return false; }
+            else if (name == "scale") { if (!reader.floats(name, &room.scale, 1)) return false; }
+            else return reader.unknown("room", name);
+        }
+        return true;
+    }
+
+    bool parseBoard(PropertyReader& reader, SceneDescription& scene, SceneBoard& board)
+    {
+        std::string name;
+        while (reader.next(name))
+        {
+            if (name == "position") { if (!reader.floats(name, board.position, 3)) return false; }
+            else if (name == "size") { if (!reader.floats(name, board.size, 3)) return false; }
+            else if (name == "frame") { if (!reader.floats(name, board.frameSize, 3)) return false; }
+            else if (name == "thickness") { if (!reader.floats(name, &board.frameThickness, 1)) return false; }
+            else if (name == "texture") { if (!reader.word(name, scene, board.texture)) return false; }
+            else if (name == "frame_texture") { if (!reader.word(name, scene, board.frameTexture)) return false; }
+            else return reader.unknown("board", name);
+        }
+        return true;
+    }
+
+    bool parseLight(PropertyReader& reader, SceneLight& light)
+    {
+        std::string name;
+        while (reader.next(name))
+        {
+            if (name == "position") { if (!reader.floats(name, light.position, 3)) return false; }
+            else if (name == "color") { if (!reader.floats(name, light.color, 3)) return false; }
+            else return reader.unknown("light", name);
+        }
+        return true;
+    }
+
+    bool parseEmitter(PropertyReader& reader, SceneEmitter& emitter)
+    {
+        std::string name;
+        while (reader.next(name))
+        {
+            if (name == "room") { if (!reader.integer(name, emitter.room)) return false; }
+            else if (name == "count") { if (!reader.integer(name, emitter.count)) return false; }
+            else if (name == "seed") { if (!reader.integer(name, emitter.seed)) return false; }
+            else return reader.unknown("fireflies", name);
+        }
+        return true;
+    }
+
+    bool parseBallSet(PropertyReader& reader, SceneBallSet& ballSet)
+    {
+        std::string name;
+        while (reader.next(name))
+        {
+            if (name == "room") { if (!reader.integer(name, ballSet.room)) return false; }
+            else if (name == "count") { if (!reader.integer(name, ballSet.count)) return false; }
+            else if (name == "seed") { if (!reader.integer(name, ballSet.seed)) return false; }
+            else if (name == "tint") { if (!reader.floats(name, ballSet.tint, 3)) return false; }
+            else return reader.unknown("balls", name);
+        }
+        return true;
+    }
+
+    // one entity with its continuation lines joined
+    bool parseEntity(const std::string& text, SceneDescription& scene, std::string& error)
+    {
+        std::istringstream tokens(text);
+        std::string kind;
+        tokens >> kind;
+        PropertyReader reader(tokens, error);
+        if (kind == "room")
+        {
+            SceneRoom room = defaultSceneRoom();
+            if (!parseRoom(reader, room))
+                return false;
+            scene.rooms.push_back(room);
+        }
+        else if (kind == "board")
+        {
+            SceneBoard board = defaultSceneBoard();
+            if (!parseBoard(reader, scene, board))
+                return false;
+            // the default textures only go into the strings when a board uses them
+            if (board.texture == 0)
+                board.texture = addString(scene, "board_texture.jpg");
+            if (board.frameTexture == 0)
+                board.frameTexture = addString(scene, "frame_texture.jpg");
+            scene.boards.push_back(board);
+        }
+        else if (kind == "light")
+        {
+            SceneLight light = defaultSceneLight();
+            if (!parseLight(reader, light))
+                return false;
+            scene.lights.push_back(light);
+        }
+        else if (kind == "fireflies")
+        {
+            SceneEmitter emitter = defaultSceneEmitter();
+            if (!parseEmitter(reader, emitter))
+                return false;
+            emitter.count = clampCount(emitter.count, SCENE_MIN_FIREFLIES, SCENE_MAX_FIREFLIES);
+            scene.emitters.push_back(emitter);
+        }
+        else if (kind == "balls")
+        {
+            SceneBallSet ballSet = defaultSceneBallSet();
+            if (!parseBallSet(reader, ballSet))
+                return false;
+            ballSet.count = clampCount(ballSet.count, SCENE_MIN_BALLS, SCENE_MAX_BALLS);
+            scene.ballSets.push_back(ballSet);
+        }
+        else
+        {
+            error = "unknown entity '" + kind + "'";
+            return false;
+        }
+        return true;
+    }
+
+    template <typename T>
+    void appendSection(std::vector<unsigned char>& image, CompiledSceneSection& section, const T* records, size_t count, size_t recordSize)
+    {
+        section.offset = alignUp(image.size());
+        section.count = count;
+        image.resize(static_cast<size_t>(section.offset) + count * recordSize, 0);
+        if (count)
+            memcpy(&image[static_cast<size_t>(section.offset)], records, count * recordSize);
+    }
+
+    template <typename T>
+    void appendRecords(std::vector<unsigned char>& image, CompiledSceneSection& section, const std::vector<T>& records)
+    {
+        appendSection(image, section, records.empty() ? NULL : &records[0], records.size(), sizeof(T));
+    }
+}
+
+SceneRoom defaultSceneRoom()
+{
+    SceneRoom room;
+    setVec3(room.center, 0.0f, 0.3f, 2.0f);
+    room.scale = 2.0f;
+    setVec3(room.wallColors[WALL_CEILING], 0.5f, 0.5f, 0.5f);
+    setVec3(room.wallColors[WALL_FLOOR], 0.5f, 0.5f, 0.5f);
+    setVec3(room.wallColors[WALL_LEFT], 1.0f, 0.0f, 0.0f);
+    setVec3(room.wallColors[WALL_RIGHT], 0.0f, 1.0f, 0.0f);
+    setVec3(room.wallColors[WALL_FRONT], 1.0f, 1.0f, 1.0f);
+    return room;
+}
+
+SceneBoard defaultSceneBoard()
+{
+    SceneBoard board;
+    setVec3(board.position, 0.0f, 0.3f, 1.51f);
+    setVec3(board.size, 1.0f, 0.6f, 0.05f);
+    setVec3(board.frameSize, 1.05f, 0.65f, 0.05f);
+    board.frameThickness = 0.05f;
+    board.texture = 0;       // no string yet; parseScene() fills in board_texture.jpg
+    board.frameTexture = 0;  // and frame_texture.jpg
+    return board;
+}
+
+SceneLight defaultSceneLight()
+{
+    SceneLight light;
+    setVec3(light.position, 0.0f, 0.75f, 1.65f);
+    setVec3(light.color, 1.0f, 1.0f, 1.0f);
+    return light;
+}
+
+SceneEmitter defaultSceneEmitter()
+{
+    SceneEmitter emitter;
+    emitter.room = 0;
+    emitter.count = 100;
+    emitter.seed = 1;
+    return emitter;
+}
+
+SceneBallSet defaultSceneBallSet()
+{
+    SceneBallSet ballSet;
+    ballSet.room = 0;
+    ballSet.count = 16;
+    ballSet.seed = 1;
+    setVec3(ballSet.tint, 1.0f, 1.0f, 1.0f);
+    return ballSet;
+}
+
+std::string compiledScenePath(const std::string& sourcePath)
+{
+    std::string::size_type dot = sourcePath.find_last_of('.');
+    std::string::size_type slash = sourcePath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return sourcePath + ".cscene";
+    return sourcePath.substr(0, dot) + ".cscene";
+}
+
+bool parseScene(const char* path, SceneDescription& scene, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = std::string(path) + ": cannot open";
+        return false;
+    }
+    scene = SceneDescription();
+
+    std::string entity;
+    int entityLine = 0;
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        std::string::size_type comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        // an indented line continues the entity above it
+        if (line[0] == ' ' || line[0] == '\t')
+        {
+            if (entity.empty())
+            {
+                error = std::string(path) + ":" + std::to_string(lineNumber) + ": continuation line without an entity";
+                return false;
+            }
+            entity += ' ';
+            entity += line;
+            continue;
+        }
+        if (!entity.empty() && !parseEntity(entity, scene, error))
+        {
+            error = std::string(path) + ":" + std::to_string(entityLine) + ": " + error;
+            return false;
+        }
+        entity = line;
+        entityLine = lineNumber;
+    }
+    if (!entity.empty() && !parseEntity(entity, scene, error))
+    {
+        error = std::string(path) + ":" + std::to_string(entityLine) + ": " + error;
+        return false;
+    }
+
+    for (size_t i = 0; i < scene.emitters.size(); ++i)
+    {
+        if (scene.emitters[i].room >= scene.rooms.size())
+        {
+            error = std::string(path) + ": fireflies " + std::to_string(i) + " refer to room " + std::to_string(scene.emitters[i].room) + ", which does not exist";
+            return false;
+        }
+    }
+    for (size_t i = 0; i < scene.ballSets.size(); ++i)
+    {
+        if (scene.ballSets[i].room >= scene.rooms.size())
+        {
+            error = std::string(path) + ": balls " + std::to_string(i) + " refer to room " + std::to_string(scene.ballSets[i].room) + ", which does not exist";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<unsigned char> compileScene(const SceneDescription& scene, const SourceStamp& stamp)
+{
+    CompiledSceneHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = COMPILED_SCENE_MAGIC;
+    header.version = COMPILED_SCENE_VERSION;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+
+    std::vector<unsigned char> image(sizeof(header), 0);
+    appendRecords(image, header.sections[SCENE_ROOMS], scene.rooms);
+    appendRecords(image, header.sections[SCENE_BOARDS], scene.boards);
+    appendRecords(image, header.sections[SCENE_LIGHTS], scene.lights);
+    appendRecords(image, header.sections[SCENE_EMITTERS], scene.emitters);
+    appendRecords(image, header.sections[SCENE_BALL_SETS], scene.ballSets);
+    appendSection(image, header.sections[SCENE_STRINGS], scene.strings.data(), scene.strings.size(), 1);
+    memcpy(&image[0], &header, sizeof(header));
+    return image;
+}
+
+bool compileSceneFile(const char* sourcePath, const char* compiledPath)
+{
+    SourceStamp stamp;
+    if (!stampSource(sourcePath, stamp))
+    {
+        std::cout << "SCENE::CANNOT_READ " << sourcePath << std::endl;
+        return false;
+    }
+    SceneDescription scene;
+    std::string error;
+    if (!parseScene(sourcePath, scene, error))
+    {
+        std::cout << "SCENE::PARSE_FAILED " << error << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> image = compileScene(scene, stamp);
+    std::ofstream file(compiledPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&image[0]), static_cast<std::streamsize>(image.size()));
+    if (!file)
+    {
+        std::cout << "SCENE::WRITE_FAILED " << compiledPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+CompiledScene::CompiledScene()
+{
+}
+
+bool CompiledScene::open(const char* path)
+{
+    close();
+    if (!file.open(path, sizeof(CompiledSceneHeader)))
+        return false;
+    if (!validate())
+    {
+        std::cout << "COMPILED_SCENE::INVALID " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool CompiledScene::adopt(std::vector<unsigned char>& image)
+{
+    close();
+    memory.swap(image);
+    if (memory.size() < sizeof(CompiledSceneHeader) || !validate())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CompiledScene::close()
+{
+    file.close();
+    memory.clear();
+}
+
+bool CompiledScene::validate() const
+{
+    static const size_t recordSizes[SCENE_SECTION_COUNT] = {
+        sizeof(SceneRoom), sizeof(SceneBoard), sizeof(SceneLight), sizeof(SceneEmitter), sizeof(SceneBallSet), 1
+    };
+    const CompiledSceneHeader& h = header();
+    if (h.magic != COMPILED_SCENE_MAGIC || h.version != COMPILED_SCENE_VERSION)
+        return false;
+    uint64_t size = byteCount();
+    for (int kind = 0; kind < SCENE_SECTION_COUNT; ++kind)
+    {
+        const CompiledSceneSection& section = h.sections[kind];
+        if (section.offset % 16 != 0 || section.offset > size || section.count > (size - section.offset) / recordSizes[kind])
+            return false;
+    }
+    // every string offset inside the section then ends at a NUL
+    const CompiledSceneSection& strings = h.sections[SCENE_STRINGS];
+    if (strings.count == 0 || bytes()[strings.offset + strings.count - 1] != '\0')
+        return false;
+
+    // the same limits parseScene() applies
+    for (size_t i = 0; i < emitterCount(); ++i)
+    {
+        const SceneEmitter& emitter = emitters()[i];
+        if (emitter.room >= roomCount() || !countInRange(emitter.count, SCENE_MIN_FIREFLIES, SCENE_MAX_FIREFLIES))
+            return false;
+    }
+    for (size_t i = 0; i < ballSetCount(); ++i)
+    {
+        const SceneBallSet& ballSet = ballSets()[i];
+        if (ballSet.room >= roomCount() || !countInRange(ballSet.count, SCENE_MIN_BALLS, SCENE_MAX_BALLS))
+            return false;
+    }
+    return true;
+}
+
+bool CompiledScene::isCurrent(const char* sourcePath) const
+{
+    const CompiledSceneHeader& h = header();
+    SourceStamp stamp = { h.sourceSize, h.sourceTime, h.sourceHash };
+    return isSourceCurrent(sourcePath, stamp);
+}
+
+const char* CompiledScene::string(uint32_t offset) const
+{
+    const CompiledSceneSection& strings = header().sections[SCENE_STRINGS];
+    if (offset >= strings.count)
+        return "";
+    return reinterpret_cast<const char*>(bytes() + strings.offset + offset);
+}
+
+bool loadScene(const char* sourcePath, CompiledScene& scene, std::string& error)
+{
+    std::string compiledPath = compiledScenePath(sourcePath);
+    if (scene.open(compiledPath.c_str()) && scene.isCurrent(sourcePath))
+        return true;
+    // the stale mapping has to go before the file is rewritten
+    scene.close();
+
+    SourceStamp stamp;
+    SceneDescription description;
+    if (!stampSource(sourcePath, stamp))
+    {
+        error = std::string(sourcePath) + ": cannot open";
+        return false;
+    }
+    if (!parseScene(sourcePath, description, error))
+        return false;
+    std::vector<unsigned char> image = compileScene(description, stamp);
+    {
+        std::ofstream file(compiledPath.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&image[0]), static_cast<std::streamsize>(image.size()));
+        // written for the next start; this one keeps the image it already has
+        if (!file)
+            std::cout << "SCENE::WRITE_FAILED " << compiledPath << std::endl;
+    }
+    if (!scene.adopt(image))
+    {
+        error = std::string(sourcePath) + ": compiled scene is invalid";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,193 @@
+#pragma once
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "mapped_file.h"
+#include "scene_geometry.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Scene description. The text form (.scene) is the one to edit: one entity per
+// line, its kind followed by named properties, '#' starting a comment.
+//
+//   room      center 0 0.3 2  scale 2  ceiling 0.5 0.5 0.5  floor 0.5 0.5 0.5  left 1 0 0  right 0 1 0  front 1 1 1
+//   board     position 0 0.3 1.51  size 1 0.6 0.05  frame 1.05 0.65 0.05  thickness 0.05
+//             texture board_texture.jpg  frame_texture frame_texture.jpg
+//   light     position 0 0.75 1.65  color 1 1 1
+//   fireflies room 0  count 100  seed 1
+//   balls     room 0  count 16  seed 1  tint 1 1 1
+//
+// A property may continue on the next line when that line starts with
+// whitespace. Omitted properties keep the values shown above, which are the
+// built-in scene. Emitters (fireflies) and ball sets fill the room they name
+// by index, which has to exist; their counts are clamped to the ranges below,
+// the same the app's sliders allow.
+//
+// The compiled form (.cscene) is a fixed-size header followed by one array of
+// records per kind and a block of NUL-terminated strings, each 16-byte
+// aligned. It is mapped and read in place: opening it checks the header and
+// the section table against the file size, and the room indices and counts of
+// the emitters and ball sets against their limits, so a file that was not
+// written by compileScene() is rejected before anything reads it. Like a cooked
+// texture it records the size, time and hash of the text it was compiled from.
+
+enum { COMPILED_SCENE_MAGIC = 0x4E435343 }; // "CSCN"
+enum { COMPILED_SCENE_VERSION = 1 };
+
+enum SceneCountLimits
+{
+    SCENE_MIN_FIREFLIES = 100,
+    SCENE_MAX_FIREFLIES = 1000000,
+    SCENE_MIN_BALLS = 1,
+    SCENE_MAX_BALLS = 20000
+};
+
+enum SceneSection
+{
+    SCENE_ROOMS,
+    SCENE_BOARDS,
+    SCENE_LIGHTS,
+    SCENE_EMITTERS,
+    SCENE_BALL_SETS,
+    SCENE_STRINGS,     // count is in bytes
+    SCENE_SECTION_COUNT
+};
+
+struct SceneRoom
+{
+    float center[3];
+    float scale;                    // width of the room; height and depth are 1
+    float wallColors[WALL_COUNT][3];
+};
+
+struct SceneBoard
+{
+    float position[3];
+    float size[3];
+    float frameSize[3];
+    float frameThickness;
+    uint32_t texture;               // offsets into the string section
+    uint32_t frameTexture;
+};
+
+struct SceneLight
+{
+    float position[3];
+    float color[3];
+};
+
+struct SceneEmitter
+{
+    uint32_t room;
+    uint32_t count;
+    uint32_t seed;
+};
+
+struct SceneBallSet
+{
+    uint32_t room;
+    uint32_t count;
+    uint32_t seed;
+    float tint[3];
+};
+
+struct CompiledSceneSection
+{
+    uint64_t offset;   // from the start of the file, 16-byte aligned
+    uint64_t count;
+};
+
+struct CompiledSceneHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    CompiledSceneSection sections[SCENE_SECTION_COUNT];
+};
+
+// A parsed text scene.
+struct SceneDescription
+{
+    std::vector<SceneRoom> rooms;
+    std::vector<SceneBoard> boards;
+    std::vector<SceneLight> lights;
+    std::vector<SceneEmitter> emitters;
+    std::vector<SceneBallSet> ballSets;
+    std::string strings;            // starts with an empty string at offset 0
+
+    SceneDescription() : strings(1, '\0') {}
+};
+
+SceneRoom defaultSceneRoom();
+SceneBoard defaultSceneBoard();
+SceneLight defaultSceneLight();
+SceneEmitter defaultSceneEmitter();
+SceneBallSet defaultSceneBallSet();
+
+// "scenes/room.scene" -> "scenes/room.cscene"
+std::string compiledScenePath(const std::string& sourcePath);
+
+// parses path into scene; on failure error holds the file, line and reason
+bool parseScene(const char* path, SceneDescription& scene, std::string& error);
+// the compiled form of scene, stamped with stamp
+std::vector<unsigned char> compileScene(const SceneDescription& scene, const SourceStamp& stamp);
+// parses sourcePath and writes its compiled form to compiledPath; returns
+// false (and prints why) on failure
+bool compileSceneFile(const char* sourcePath, const char* compiledPath);
+
+// A compiled scene, mapped from a file or held in memory.
+class CompiledScene
+{
+public:
+    CompiledScene();
+
+    // maps path and checks the header and section table against the file size
+    bool open(const char* path);
+    // takes a compiled image, e.g. when the compiled file cannot be written
+    bool adopt(std::vector<unsigned char>& image);
+    void close();
+
+    // true if the file was compiled from sourcePath as it is now (see isSourceCurrent())
+    bool isCurrent(const char* sourcePath) const;
+
+    const CompiledSceneHeader& header() const { return *reinterpret_cast<const CompiledSceneHeader*>(bytes()); }
+
+    const SceneRoom* rooms() const { return section<SceneRoom>(SCENE_ROOMS); }
+    size_t roomCount() const { return count(SCENE_ROOMS); }
+    const SceneBoard* boards() const { return section<SceneBoard>(SCENE_BOARDS); }
+    size_t boardCount() const { return count(SCENE_BOARDS); }
+    const SceneLight* lights() const { return section<SceneLight>(SCENE_LIGHTS); }
+    size_t lightCount() const { return count(SCENE_LIGHTS); }
+    const SceneEmitter* emitters() const { return section<SceneEmitter>(SCENE_EMITTERS); }
+    size_t emitterCount() const { return count(SCENE_EMITTERS); }
+    const SceneBallSet* ballSets() const { return section<SceneBallSet>(SCENE_BALL_SETS); }
+    size_t ballSetCount() const { return count(SCENE_BALL_SETS); }
+    // a string referenced by a record; "" for an offset outside the string section
+    const char* string(uint32_t offset) const;
+
+private:
+    MappedFile file;
+    std::vector<unsigned char> memory;  // used instead of file after adopt()
+
+    const unsigned char* bytes() const { return file.data() ? file.data() : memory.empty() ? NULL : &memory[0]; }
+    size_t byteCount() const { return file.data() ? file.size() : memory.size(); }
+    size_t count(SceneSection kind) const { return static_cast<size_t>(header().sections[kind].count); }
+    template <typename T>
+    const T* section(SceneSection kind) const { return reinterpret_cast<const T*>(bytes() + header().sections[kind].offset); }
+    bool validate() const;
+
+    CompiledScene(const CompiledScene&);
+    CompiledScene& operator=(const CompiledScene&);
+};
+
+// Opens the compiled form of sourcePath, recompiling it first when it is
+// missing or older than the text. If the compiled file cannot be written the
+// scene is compiled in memory instead. A missing text with a current compiled
+// file next to it is fine. Returns false (with error set) if neither can be read.
+bool loadScene(const char* sourcePath, CompiledScene& scene, std::string& error);
+#endif
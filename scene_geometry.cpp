@@ -0,0 +1,134 @@
+#include "scene_geometry.h"
+
+void generateRoomMesh(const float* cubeVertices, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+    // first vertex of each face in the cube array (6 vertices of 6 floats per face)
+    const int faceFirstVertex[WALL_COUNT] = {
+        30, // WALL_CEILING: top face
+        24, // WALL_FLOOR: bottom face
+        12, // WALL_LEFT: left face
+        18, // WALL_RIGHT: right face
+        0   // WALL_FRONT: back face (facing the camera)
+    };
+    // the face's triangles are (0,1,2) and (3,4,5), where 3 equals 2 and 5 equals 0,
+    // so corners 0, 1, 2 and 4 are all it takes
+    const int corners[4] = { 0, 1, 2, 4 };
+
+    vertices.clear();
+    indices.clear();
+    for (int face = 0; face < WALL_COUNT; ++face)
+    {
+        unsigned int base = static_cast<unsigned int>(vertices.size() / 7);
+        for (int c = 0; c < 4; ++c)
+        {
+            const float* v = cubeVertices + (faceFirstVertex[face] + corners[c]) * 6;
+            vertices.insert(vertices.end(), v, v + 6);
+            vertices.push_back(static_cast<float>(face));
+        }
+        unsigned int faceIndices[6] = { base, base + 1, base + 2, base + 2, base + 3, base };
+        indices.insert(indices.end(), faceIndices, faceIndices + 6);
+    }
+}
+
+std::vector<float> generateChalkboardVertices(const glm::vec3& size)
+{
+    float width = size.x;
+    float height = size.y;
+    float depth = size.z;
+
+    // Front face with texture coordinates
+    const float vertices[] = {
+        // Positions          // Normals         // Texture Coords
+        // Front face
+        -width / 2, -height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+         width / 2, -height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+         width / 2,  height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+         width / 2,  height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+        -width / 2,  height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+        -width / 2, -height / 2,  depth / 2,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+
+        // Back face
+        -width / 2, -height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+         width / 2, -height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+         width / 2,  height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+         width / 2,  height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+        -width / 2,  height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+        -width / 2, -height / 2, -depth / 2,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+
+        // Left face
+        -width / 2,  height / 2,  depth / 2, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+        -width / 2,  height / 2, -depth / 2, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+        -width / 2, -height / 2, -depth / 2, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        -width / 2, -height / 2, -depth / 2, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        -width / 2, -height / 2,  depth / 2, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+        -width / 2,  height / 2,  depth / 2, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+
+        // Right face
+         width / 2,  height / 2,  depth / 2,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+         width / 2,  height / 2, -depth / 2,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+         width / 2, -height / 2, -depth / 2,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+         width / 2, -height / 2, -depth / 2,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+         width / 2, -height / 2,  depth / 2,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+         width / 2,  height / 2,  depth / 2,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+
+         // Bottom face
+         -width / 2, -height / 2, -depth / 2,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+          width / 2, -height / 2, -depth / 2,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+          width / 2, -height / 2,  depth / 2,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+          width / 2, -height / 2,  depth / 2,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+         -width / 2, -height / 2,  depth / 2,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+         -width / 2, -height / 2, -depth / 2,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+
+         // Top face
+         -width / 2,  height / 2, -depth / 2,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+          width / 2,  height / 2, -depth / 2,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+          width / 2,  height / 2,  depth / 2,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+          width / 2,  height / 2,  depth / 2,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+         -width / 2,  height / 2,  depth / 2,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+         -width / 2,  height / 2, -depth / 2,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
+    };
+    return std::vector<float>(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+}
+
+std::vector<float> generateFrameVertices(const glm::vec3& size, float thickness)
+{
+    float width = size.x;
+    float height = size.y;
+    float depth = size.z;
+
+    // front of the frame, with texture coordinates
+    const float vertices[] = {
+        // top bar
+        -width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+         width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+         width / 2, height / 2 - thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.9f,
+         width / 2, height / 2 - thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.9f,
+        -width / 2, height / 2 - thickness, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.9f,
+        -width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+        // bottom bar
+        -width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+         width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+         width / 2, -height / 2 + thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.1f,
+         width / 2, -height / 2 + thickness, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.1f,
+        -width / 2, -height / 2 + thickness, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.1f,
+        -width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+
+        // left bar
+        -width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+        -width / 2 + thickness, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.1f, 1.0f,
+        -width / 2 + thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.1f, 0.0f,
+        -width / 2 + thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.1f, 0.0f,
+        -width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+        -width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+
+        // right bar
+         width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+         width / 2 - thickness, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.9f, 1.0f,
+         width / 2 - thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.9f, 0.0f,
+         width / 2 - thickness, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 0.9f, 0.0f,
+         width / 2, -height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+         width / 2, height / 2, depth / 2, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+    };
+    return std::vector<float>(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+}
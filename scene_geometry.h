@@ -0,0 +1,35 @@
+#pragma once
+#ifndef SCENE_GEOMETRY_H
+#define SCENE_GEOMETRY_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Static meshes of the scene, built on the CPU once at startup (and by the
+// benchmarks). They only fill vectors, so they need no GL context.
+
+// Wall material indices, matching the wallColors array in room_fragment.glsl.
+enum WallMaterial
+{
+    WALL_CEILING,
+    WALL_FLOOR,
+    WALL_LEFT,
+    WALL_RIGHT,
+    WALL_FRONT,
+    WALL_COUNT
+};
+
+// Takes the five visible walls out of a 36-vertex cube (position and normal per
+// vertex) and merges them into one indexed mesh. Each output vertex is a
+// position, a normal and its WallMaterial as a float.
+void generateRoomMesh(const float* cubeVertices, std::vector<float>& vertices, std::vector<unsigned int>& indices);
+
+// A box of the given size centred on the origin as 36 unindexed vertices of
+// position, normal and texture coordinates; used for the chalkboard.
+std::vector<float> generateChalkboardVertices(const glm::vec3& size);
+
+// The four bars of a picture frame of the given outer size, facing +z, with
+// bars of the given thickness; same vertex layout as the chalkboard.
+std::vector<float> generateFrameVertices(const glm::vec3& size, float thickness);
+#endif
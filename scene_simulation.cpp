@@ -0,0 +1,100 @@
+#include "scene_simulation.h"
+
+#include <cstring>
+
+namespace
+{
+    void updateFireflyChunk(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+    {
+        const FireflyStep* step = static_cast<const FireflyStep*>(context);
+        updateFireflies(*step->store, begin, end, step->deltaTime, step->bounds, step->kernel);
+    }
+
+    void integrateBallChunk(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+    {
+        const BallStep* step = static_cast<const BallStep*>(context);
+        step->balls->integrate(begin, end, step->deltaTime, step->bounds);
+    }
+}
+
+FireflyBounds roomFireflyBounds(const glm::vec3& roomCenter)
+{
+    FireflyBounds bounds;
+    bounds.centerX = roomCenter.x;
+    bounds.centerY = roomCenter.y;
+    bounds.centerZ = roomCenter.z;
+    bounds.bottomY = roomCenter.y - 0.5f;
+    return bounds;
+}
+
+BallBounds roomBallBounds(const glm::vec3& roomCenter, float widthScale)
+{
+    BallBounds bounds;
+    glm::vec3 halfExtent(0.5f * widthScale, 0.5f, 0.5f);
+    bounds.min = roomCenter - halfExtent;
+    bounds.max = roomCenter + halfExtent;
+    return bounds;
+}
+
+void kickFireflyStep(JobSystem& jobs, FireflyStep& step, JobCounter& counter)
+{
+    jobs.parallelFor(step.store->capacity(), FIREFLY_CHUNK_SIZE, updateFireflyChunk, &step, counter);
+}
+
+void kickBallIntegration(JobSystem& jobs, BallStep& step, JobCounter& counter)
+{
+    jobs.parallelFor(step.balls->count(), BALL_CHUNK_SIZE, integrateBallChunk, &step, counter);
+}
+
+void groupBallsByLod(const float* balls, size_t count, const SphereMesh& mesh, const glm::vec3& eye, float pixelsPerUnit,
+                     float maxEdgePixels, std::vector<float>& instances, std::vector<size_t>& lodCounts,
+                     std::vector<unsigned char>& ballLod, const unsigned char* visible)
+{
+    const float* centers = balls;
+    const float* radii = centers + 3 * count;
+    const float* colors = centers + 4 * count;
+    const float* previous = centers + 7 * count;
+
+    ballLod.resize(count);
+    lodCounts.assign(mesh.lods.size(), 0);
+    size_t grouped = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (visible && !visible[i])
+            continue;
+        glm::vec3 center(centers[3 * i], centers[3 * i + 1], centers[3 * i + 2]);
+        float distance = glm::max(glm::length(center - eye), 1e-3f);
+        size_t lod = selectSphereLod(mesh, radii[i] * pixelsPerUnit / distance, maxEdgePixels);
+        ballLod[i] = static_cast<unsigned char>(lod);
+        ++lodCounts[lod];
+        ++grouped;
+    }
+
+    std::vector<size_t> cursor(mesh.lods.size(), 0);
+    for (size_t lod = 1; lod < cursor.size(); ++lod)
+        cursor[lod] = cursor[lod - 1] + lodCounts[lod - 1];
+    instances.resize(10 * grouped);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (visible && !visible[i])
+            continue;
+        float* out = &instances[10 * cursor[ballLod[i]]++];
+        memcpy(out, centers + 3 * i, 3 * sizeof(float));
+        out[3] = radii[i];
+        memcpy(out + 4, colors + 3 * i, 3 * sizeof(float));
+        memcpy(out + 7, previous + 3 * i, 3 * sizeof(float));
+    }
+}
+
+void ballBoundingBoxes(const float* balls, size_t count, BoundingBox* boxes)
+{
+    const float* centers = balls;
+    const float* radii = centers + 3 * count;
+    const float* previous = centers + 7 * count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 center(centers[3 * i], centers[3 * i + 1], centers[3 * i + 2]);
+        glm::vec3 last(previous[3 * i], previous[3 * i + 1], previous[3 * i + 2]);
+        boxes[i] = mergeBounds(sphereBounds(center, radii[i]), sphereBounds(last, radii[i]));
+    }
+}
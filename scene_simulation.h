@@ -0,0 +1,74 @@
+#pragma once
+#ifndef SCENE_SIMULATION_H
+#define SCENE_SIMULATION_H
+
+#include <glm/glm.hpp>
+
+#include "ball_sim.h"
+#include "culling.h"
+#include "firefly_sim.h"
+#include "job_system.h"
+#include "sphere_mesh.h"
+
+#include <cstddef>
+#include <vector>
+
+// The parts of a simulation step that tie the firefly and ball systems to the
+// scene: where they may move, how their steps are split over the job system,
+// and how ball instances are grouped by level of detail for drawing. Kept out
+// of main.cpp so the benchmarks run exactly the code the app runs.
+
+// fireflies per job when a step is split over the job system; a multiple of FIREFLY_LANES
+const size_t FIREFLY_CHUNK_SIZE = 16384;
+
+// balls per job when their integration is split over the job system
+const size_t BALL_CHUNK_SIZE = 4096;
+
+// fireflies drift around the centre of the room and respawn once they fall below its floor
+FireflyBounds roomFireflyBounds(const glm::vec3& roomCenter);
+// balls bounce off the inner walls of the room, whose width is scaled by widthScale
+BallBounds roomBallBounds(const glm::vec3& roomCenter, float widthScale);
+
+// One firefly step, split into FIREFLY_CHUNK_SIZE jobs. It is the jobs'
+// context, so it has to stay alive until their counter drops to zero. Every
+// firefly carries its own random state, so the result does not depend on
+// which thread runs which chunk, or in what order.
+struct FireflyStep
+{
+    FireflyStore* store;
+    float deltaTime;
+    FireflyBounds bounds;
+    FireflyKernel kernel;
+};
+void kickFireflyStep(JobSystem& jobs, FireflyStep& step, JobCounter& counter);
+
+// The integration half of a ball step, split into BALL_CHUNK_SIZE jobs; it is
+// their context like FireflyStep. Balls only meet in the contact pass, so
+// once the counter drops to zero call balls->resolveContacts(bounds) to
+// finish the step on one thread.
+struct BallStep
+{
+    BallSystem* balls;
+    float deltaTime;
+    BallBounds bounds;
+};
+void kickBallIntegration(JobSystem& jobs, BallStep& step, JobCounter& counter);
+
+// Picks a level of detail for every ball from its projected radius, then
+// groups the balls by level with a counting sort. balls holds count positions,
+// then count radii, colors and previous positions (the layout of a simulation
+// snapshot); instances receives 10 interleaved floats per ball (position,
+// radius, color, previous position) ordered by level, and lodCounts the number
+// of balls of each level. pixelsPerUnit is the on-screen size of one unit at
+// distance one. If visible is not NULL only the balls whose flag is set are
+// grouped. ballLod is scratch for the level of every ball; keep it between
+// calls so it does not allocate every frame.
+void groupBallsByLod(const float* balls, size_t count, const SphereMesh& mesh, const glm::vec3& eye, float pixelsPerUnit,
+                     float maxEdgePixels, std::vector<float>& instances, std::vector<size_t>& lodCounts,
+                     std::vector<unsigned char>& ballLod, const unsigned char* visible = NULL);
+
+// The box each ball of a snapshot (laid out as for groupBallsByLod()) sweeps
+// between its previous and current position, which covers every position the
+// renderer interpolates.
+void ballBoundingBoxes(const float* balls, size_t count, BoundingBox* boxes);
+#endif
@@ -5,10 +5,60 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "gl_state.h"
+#include "program_cache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <chrono>
+#include <type_traits>
+
+// compile-time FNV-1a hash of a uniform name
+// ------------------------------------------------------------------------
+constexpr unsigned int uniformHash(const char* str, unsigned int hash = 2166136261u)
+{
+    return *str ? uniformHash(str + 1, (hash ^ static_cast<unsigned char>(*str)) * 16777619u) : hash;
+}
+
+// fixed binding points of the uniform blocks shared between programs
+enum UniformBlockBinding
+{
+    FRAME_DATA_BINDING = 0
+};
+
+// fixed texture units of the samplers shared between programs, above the
+// units the draws bind their own textures to
+enum SharedTextureUnit
+{
+    LIGHT_DATA_UNIT = 5,
+    LIGHT_CLUSTER_UNIT = 6,
+    LIGHT_INDEX_UNIT = 7
+};
+
+// a uniform name with its hash; the string is compared against the cached
+// name whenever the hash matches
+struct UniformName
+{
+    unsigned int hash;
+    const char* str;
+    constexpr UniformName(unsigned int h, const char* s) : hash(h), str(s) {}
+};
+
+// "model"_u builds a UniformName without allocating; it is only hashed at
+// compile time where a constant is needed, e.g. constexpr UniformName m = "model"_u;
+constexpr UniformName operator"" _u(const char* str, std::size_t)
+{
+    return UniformName(uniformHash(str), str);
+}
+
+// UNIFORM("model") is "model"_u with the hash passed through a template
+// argument, so it is never left to run time
+#define UNIFORM(literal) UniformName(std::integral_constant<unsigned int, uniformHash(literal)>::value, literal)
 
 class Shader
 {
@@ -46,9 +96,23 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        vertexCode = expandSource(vertexCode, GL_VERTEX_SHADER);
+        fragmentCode = expandSource(fragmentCode, GL_FRAGMENT_SHADER);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        // 2. reuse the cached binary of this program if the driver accepts it
+        ID = glCreateProgram();
+        std::vector<std::string> cacheParts;
+        cacheParts.push_back(vertexCode);
+        cacheParts.push_back(fragmentCode);
+        std::string cacheKey = ProgramBinaryCache::key(cacheParts);
+        if (ProgramBinaryCache::load(ID, cacheKey))
+        {
+            finishProgram(start, true);
+            return;
+        }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        // 3. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -61,85 +125,332 @@ public:
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        ProgramBinaryCache::prepare(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        if (checkCompileErrors(ID, "PROGRAM") && checkUniformHashes(ID))
+            ProgramBinaryCache::store(ID, cacheKey);
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-
+        finishProgram(start, false);
+    }
+    // constructor for a vertex-only program whose outputs are captured with
+    // transform feedback into one interleaved buffer
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const std::vector<const char*>& feedbackVaryings)
+    {
+        std::string vertexCode;
+        std::ifstream vShaderFile;
+        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            vShaderFile.open(vertexPath);
+            std::stringstream vShaderStream;
+            vShaderStream << vShaderFile.rdbuf();
+            vShaderFile.close();
+            vertexCode = vShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
+        vertexCode = expandSource(vertexCode, GL_VERTEX_SHADER);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        // the varyings are part of the linked program, so they are part of the key
+        ID = glCreateProgram();
+        std::vector<std::string> cacheParts;
+        cacheParts.push_back(vertexCode);
+        for (size_t i = 0; i < feedbackVaryings.size(); ++i)
+            cacheParts.push_back(feedbackVaryings[i]);
+        std::string cacheKey = ProgramBinaryCache::key(cacheParts);
+        if (ProgramBinaryCache::load(ID, cacheKey))
+        {
+            finishProgram(start, true);
+            return;
+        }
+        const char* vShaderCode = vertexCode.c_str();
+        unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        glAttachShader(ID, vertex);
+        // the captured varyings have to be declared before linking
+        glTransformFeedbackVaryings(ID, (GLsizei)feedbackVaryings.size(), feedbackVaryings.data(), GL_INTERLEAVED_ATTRIBS);
+        ProgramBinaryCache::prepare(ID);
+        glLinkProgram(ID);
+        if (checkCompileErrors(ID, "PROGRAM") && checkUniformHashes(ID))
+            ProgramBinaryCache::store(ID, cacheKey);
+        glDeleteShader(vertex);
+        finishProgram(start, false);
+    }
+    // swaps in another linked program (e.g. a reloaded one that passed
+    // checkUniformHashes) and deletes the old one
+    // ------------------------------------------------------------------------
+    void replaceProgram(GLuint program)
+    {
+        GLState::forgetProgram(ID);
+        glDeleteProgram(ID);
+        ID = program;
+        reportedMisses.clear();
+        if (!cacheUniformLocations())
+            rejectProgram();
+        bindSharedResources();
     }
-    // activate the shader
+    // activate the shader (a no-op if it already is)
     // ------------------------------------------------------------------------
     void use() const
     {
-        glUseProgram(ID);
+        GLState::useProgram(ID);
     }
-    // utility uniform functions
+    // attaches a uniform block to a binding point, if the program declares it
     // ------------------------------------------------------------------------
-    void setBool(const std::string& name, bool value) const
+    void bindUniformBlock(const char* blockName, GLuint binding) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        GLuint blockIndex = glGetUniformBlockIndex(ID, blockName);
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, blockIndex, binding);
     }
+    // points a sampler at a texture unit, if the program declares it
     // ------------------------------------------------------------------------
-    void setInt(const std::string& name, int value) const
+    void bindSampler(const char* samplerName, GLint unit) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        GLint location = glGetUniformLocation(ID, samplerName);
+        if (location == -1)
+            return;
+        GLState::useProgram(ID);
+        glUniform1i(location, unit);
     }
+    // uniform lookup
     // ------------------------------------------------------------------------
-    void setFloat(const std::string& name, float value) const
+    // returns the location cached at link time, or -1 (reported once) if the
+    // program has no active uniform with that name
+    GLint getUniformLocation(const char* name) const
+    {
+        return findUniform(uniformHash(name), name);
+    }
+    GLint getUniformLocation(UniformName name) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        return findUniform(name.hash, name.str);
     }
+    // utility uniform functions (by cached location)
     // ------------------------------------------------------------------------
-    void setVec2(const std::string& name, const glm::vec2& value) const
+    void setBool(GLint location, bool value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform1i(location, (int)value);
     }
-    void setVec2(const std::string& name, float x, float y) const
+    // ------------------------------------------------------------------------
+    void setInt(GLint location, int value) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string& name, const glm::vec3& value) const
+    void setFloat(GLint location, float value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform1f(location, value);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const
+    // ------------------------------------------------------------------------
+    void setVec2(GLint location, const glm::vec2& value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec2(GLint location, float x, float y) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform2f(location, x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string& name, const glm::vec4& value) const
+    void setVec3(GLint location, const glm::vec3& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(location, 1, &value[0]);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w) const
+    void setVec3(GLint location, float x, float y, float z) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform3f(location, x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string& name, const glm::mat2& mat) const
+    void setVec4(GLint location, const glm::vec4& value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
+    }
+    void setVec4(GLint location, float x, float y, float z, float w) const
+    {
+        glUniform4f(location, x, y, z, w);
+    }
+    void setVec3Array(GLint location, GLsizei count, const glm::vec3* values) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniform3fv(location, count, &values[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string& name, const glm::mat3& mat) const
+    void setMat2(GLint location, const glm::mat2& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string& name, const glm::mat4& mat) const
+    void setMat3(GLint location, const glm::mat3& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
+    // ------------------------------------------------------------------------
+    void setMat4(GLint location, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // utility uniform functions (by hashed name, e.g. setMat4(UNIFORM("model"), model))
+    // ------------------------------------------------------------------------
+    void setBool(UniformName name, bool value) const { setBool(getUniformLocation(name), value); }
+    void setInt(UniformName name, int value) const { setInt(getUniformLocation(name), value); }
+    void setFloat(UniformName name, float value) const { setFloat(getUniformLocation(name), value); }
+    void setVec2(UniformName name, const glm::vec2& value) const { setVec2(getUniformLocation(name), value); }
+    void setVec2(UniformName name, float x, float y) const { setVec2(getUniformLocation(name), x, y); }
+    void setVec3(UniformName name, const glm::vec3& value) const { setVec3(getUniformLocation(name), value); }
+    void setVec3(UniformName name, float x, float y, float z) const { setVec3(getUniformLocation(name), x, y, z); }
+    void setVec3Array(UniformName name, GLsizei count, const glm::vec3* values) const { setVec3Array(getUniformLocation(name), count, values); }
+    void setVec4(UniformName name, const glm::vec4& value) const { setVec4(getUniformLocation(name), value); }
+    void setVec4(UniformName name, float x, float y, float z, float w) const { setVec4(getUniformLocation(name), x, y, z, w); }
+    void setMat2(UniformName name, const glm::mat2& mat) const { setMat2(getUniformLocation(name), mat); }
+    void setMat3(UniformName name, const glm::mat3& mat) const { setMat3(getUniformLocation(name), mat); }
+    void setMat4(UniformName name, const glm::mat4& mat) const { setMat4(getUniformLocation(name), mat); }
+    // utility uniform functions (by runtime string, hashed on every call)
+    // ------------------------------------------------------------------------
+    void setBool(const std::string& name, bool value) const { setBool(getUniformLocation(name.c_str()), value); }
+    void setInt(const std::string& name, int value) const { setInt(getUniformLocation(name.c_str()), value); }
+    void setFloat(const std::string& name, float value) const { setFloat(getUniformLocation(name.c_str()), value); }
+    void setVec2(const std::string& name, const glm::vec2& value) const { setVec2(getUniformLocation(name.c_str()), value); }
+    void setVec2(const std::string& name, float x, float y) const { setVec2(getUniformLocation(name.c_str()), x, y); }
+    void setVec3(const std::string& name, const glm::vec3& value) const { setVec3(getUniformLocation(name.c_str()), value); }
+    void setVec3(const std::string& name, float x, float y, float z) const { setVec3(getUniformLocation(name.c_str()), x, y, z); }
+    void setVec4(const std::string& name, const glm::vec4& value) const { setVec4(getUniformLocation(name.c_str()), value); }
+    void setVec4(const std::string& name, float x, float y, float z, float w) const { setVec4(getUniformLocation(name.c_str()), x, y, z, w); }
+    void setMat2(const std::string& name, const glm::mat2& mat) const { setMat2(getUniformLocation(name.c_str()), mat); }
+    void setMat3(const std::string& name, const glm::mat3& mat) const { setMat3(getUniformLocation(name.c_str()), mat); }
+    void setMat4(const std::string& name, const glm::mat4& mat) const { setMat4(getUniformLocation(name.c_str()), mat); }
 
 private:
+    struct CachedUniform
+    {
+        unsigned int hash;
+        GLint location;
+        std::string name;
+
+        bool operator<(const CachedUniform& other) const { return hash < other.hash; }
+    };
+
+    // active uniforms sorted by name hash, filled once after linking
+    std::vector<CachedUniform> uniforms;
+    // hashes of names already reported as missing, so a miss is only logged once
+    mutable std::vector<unsigned int> reportedMisses;
+
+    // common tail of the constructors: lookup tables, shared bindings and startup stats
+    // ------------------------------------------------------------------------
+    void finishProgram(std::chrono::steady_clock::time_point start, bool fromCache)
+    {
+        if (!cacheUniformLocations())
+            rejectProgram();
+        bindSharedResources();
+        ProgramBinaryCache::Stats& stats = ProgramBinaryCache::stats();
+        ++(fromCache ? stats.loaded : stats.compiled);
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    // the uniform blocks and samplers every program that declares them shares
+    // ------------------------------------------------------------------------
+    void bindSharedResources()
+    {
+        bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+        bindSampler("lightData", LIGHT_DATA_UNIT);
+        bindSampler("lightClusters", LIGHT_CLUSTER_UNIT);
+        bindSampler("lightIndices", LIGHT_INDEX_UNIT);
+    }
+    // fills the lookup table; false if two names of the program share a hash
+    // ------------------------------------------------------------------------
+    bool cacheUniformLocations()
+    {
+        return collectUniforms(ID, uniforms);
+    }
+    // a program whose uniforms cannot all be told apart is treated like one that
+    // failed to link, rather than setting the wrong uniform through a hash
+    // ------------------------------------------------------------------------
+    void rejectProgram()
+    {
+        GLState::forgetProgram(ID);
+        glDeleteProgram(ID);
+        ID = 0;
+        uniforms.clear();
+    }
+    // enumerates the active uniforms of a linked program, sorted by name hash
+    // ------------------------------------------------------------------------
+    static bool collectUniforms(GLuint program, std::vector<CachedUniform>& table)
+    {
+        table.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            // arrays are reported as "name[0]": register the bare name and every element
+            std::string::size_type bracket = name.find('[');
+            if (bracket != std::string::npos)
+                name = name.substr(0, bracket);
+            addUniform(table, name, glGetUniformLocation(program, name.c_str()));
+            for (GLint element = 0; size > 1 && element < size; ++element)
+            {
+                std::string elementName = name + "[" + std::to_string(element) + "]";
+                addUniform(table, elementName, glGetUniformLocation(program, elementName.c_str()));
+            }
+        }
+        std::sort(table.begin(), table.end());
+        bool distinct = true;
+        for (size_t i = 1; i < table.size(); ++i)
+        {
+            if (table[i].hash == table[i - 1].hash)
+            {
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << table[i - 1].name << " and " << table[i].name
+                          << " in program " << program << std::endl;
+                distinct = false;
+            }
+        }
+        return distinct;
+    }
+    // ------------------------------------------------------------------------
+    static void addUniform(std::vector<CachedUniform>& table, const std::string& name, GLint location)
+    {
+        // members of uniform blocks have no location and are not set through glUniform*
+        if (location == -1)
+            return;
+        CachedUniform uniform;
+        uniform.hash = uniformHash(name.c_str());
+        uniform.location = location;
+        uniform.name = name;
+        table.push_back(uniform);
+    }
+    // ------------------------------------------------------------------------
+    GLint findUniform(unsigned int hash, const char* name) const
+    {
+        CachedUniform key;
+        key.hash = hash;
+        std::vector<CachedUniform>::const_iterator it = std::lower_bound(uniforms.begin(), uniforms.end(), key);
+        // the hash only finds the entry; the name decides
+        if (it != uniforms.end() && it->hash == hash && name && it->name == name)
+            return it->location;
+        if (std::find(reportedMisses.begin(), reportedMisses.end(), hash) == reportedMisses.end())
+        {
+            reportedMisses.push_back(hash);
+            std::cout << "WARNING::SHADER::UNIFORM_NOT_FOUND: " << (name ? name : "<unnamed>") << " in program " << ID << std::endl;
+        }
+        return -1;
+    }
+
+public:
     // utility function for checking shader compilation/linking errors.
+    // returns true on success
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -161,6 +472,60 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success == GL_TRUE;
+    }
+    // the chunk every shader stage gets after its #version line: the FrameData
+    // block and, in fragment shaders, the clustered point lights
+    // ------------------------------------------------------------------------
+    static const char* commonSourcePath()
+    {
+        return "shader_common.glsl";
+    }
+    // inserts the common chunk into a stage's source, marked with VERTEX_SHADER
+    // or FRAGMENT_SHADER; #line directives keep the line numbers of errors in
+    // the stage's own source. The result is what gets compiled and cached
+    // ------------------------------------------------------------------------
+    static std::string expandSource(const std::string& code, GLenum stage)
+    {
+        std::string common;
+        std::ifstream commonFile(commonSourcePath(), std::ios::binary);
+        if (commonFile)
+        {
+            std::stringstream commonStream;
+            commonStream << commonFile.rdbuf();
+            common = commonStream.str();
+        }
+        else
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << commonSourcePath() << std::endl;
+        }
+        if (!common.empty() && common[common.size() - 1] != '\n')
+            common += '\n';
+
+        // #version has to stay first
+        std::string::size_type body = 0;
+        if (code.compare(0, 8, "#version") == 0)
+        {
+            body = code.find('\n');
+            body = body == std::string::npos ? code.size() : body + 1;
+        }
+        std::string expanded = code.substr(0, body);
+        if (!expanded.empty() && expanded[expanded.size() - 1] != '\n')
+            expanded += '\n';
+        expanded += stage == GL_VERTEX_SHADER ? "#define VERTEX_SHADER\n" : "#define FRAGMENT_SHADER\n";
+        expanded += "#line 1 1\n";
+        expanded += common;
+        expanded += body ? "#line 2 0\n" : "#line 1 0\n";
+        expanded += code.substr(body);
+        return expanded;
+    }
+    // reports uniforms of a linked program whose names share a hash; callers
+    // treat such a program as not linked. returns true if there are none
+    // ------------------------------------------------------------------------
+    static bool checkUniformHashes(GLuint program)
+    {
+        std::vector<CachedUniform> table;
+        return collectUniforms(program, table);
     }
 };
 #endif
\ No newline at end of file
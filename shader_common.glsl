@@ -0,0 +1,44 @@
+// Inserted by the Shader loader right after the #version line of every
+// shader stage, which it marks with VERTEX_SHADER or FRAGMENT_SHADER first.
+// Errors in here are reported as source string 1, the shader itself as 0.
+
+// per-frame camera and light data (FrameData in frame_data.h)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 clusterScale;  // light clusters: tiles per pixel, slice scale and bias
+    vec4 clusterSize;   // tiles across, tiles up, slices
+};
+
+#ifdef FRAGMENT_SHADER
+// point lights, found through the cluster of the fragment (see LightClusterGrid)
+uniform samplerBuffer lightData;      // two texels per light: position and radius, colour
+uniform usamplerBuffer lightClusters; // first index and light count of every cluster
+uniform usamplerBuffer lightIndices;
+
+// adds the diffuse and specular light of the point lights in the cluster of
+// the fragment at world position fragPos; each fades out smoothly towards its radius
+void addClusterLights(vec3 fragPos, vec3 norm, vec3 viewDir, inout vec3 diffuse, inout vec3 specular)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    ivec3 cell = ivec3(vec3(gl_FragCoord.xy * clusterScale.xy, log(depth) * clusterScale.z + clusterScale.w));
+    cell = clamp(cell, ivec3(0), ivec3(clusterSize.xyz) - 1);
+    int cluster = (cell.z * int(clusterSize.y) + cell.y) * int(clusterSize.x) + cell.x;
+    uvec2 range = texelFetch(lightClusters, cluster).xy;
+    for (uint i = 0u; i < range.y; ++i)
+    {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(lightData, 2 * light);
+        vec3 color = texelFetch(lightData, 2 * light + 1).rgb;
+        vec3 toLight = positionRadius.xyz - fragPos;
+        float falloff = clamp(1.0 - dot(toLight, toLight) / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+        vec3 lightDir = normalize(toLight);
+        diffuse += max(dot(norm, lightDir), 0.0) * falloff * falloff * color;
+        specular += pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), 32.0) * falloff * falloff * color;
+    }
+}
+#endif
@@ -0,0 +1,461 @@
+#include "shader_registry.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    // GL_COMPLETION_STATUS_KHR and GL_COMPLETION_STATUS_ARB share this value
+    const GLenum COMPLETION_STATUS = 0x91B1;
+
+    bool readSource(const std::string& path, std::string& source)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        std::stringstream stream;
+        stream << file.rdbuf();
+        source = stream.str();
+        return !source.empty();
+    }
+
+    void splitPath(const std::string& path, std::string& directory, std::string& name)
+    {
+        std::string::size_type slash = path.find_last_of("/\\");
+        directory = slash == std::string::npos ? "." : path.substr(0, slash);
+        name = slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    // issues compile and link without querying any status, so nothing waits
+    // for the driver here
+    GLuint issueBuild(const std::string& vertexCode, const std::string& fragmentCode,
+                      const std::vector<std::string>& varyings, GLuint& vertex, GLuint& fragment)
+    {
+        GLuint program = glCreateProgram();
+        const char* vertexSource = vertexCode.c_str();
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vertexSource, NULL);
+        glCompileShader(vertex);
+        glAttachShader(program, vertex);
+        fragment = 0;
+        if (!fragmentCode.empty())
+        {
+            const char* fragmentSource = fragmentCode.c_str();
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fragmentSource, NULL);
+            glCompileShader(fragment);
+            glAttachShader(program, fragment);
+        }
+        if (!varyings.empty())
+        {
+            std::vector<const char*> names;
+            for (size_t i = 0; i < varyings.size(); ++i)
+                names.push_back(varyings[i].c_str());
+            glTransformFeedbackVaryings(program, (GLsizei)names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+        }
+        ProgramBinaryCache::prepare(program);
+        glLinkProgram(program);
+        return program;
+    }
+
+    // reports compile/link errors and uniform hash collisions of a finished
+    // build and frees its shader objects; returns true if the program is usable
+    bool finishLink(GLuint program, GLuint vertex, GLuint fragment)
+    {
+        Shader::checkCompileErrors(vertex, "VERTEX");
+        if (fragment)
+            Shader::checkCompileErrors(fragment, "FRAGMENT");
+        bool linked = Shader::checkCompileErrors(program, "PROGRAM") && Shader::checkUniformHashes(program);
+        glDeleteShader(vertex);
+        if (fragment)
+            glDeleteShader(fragment);
+        return linked;
+    }
+}
+
+ShaderRegistry::ShaderRegistry(GLFWwindow* window)
+    : commonPath(Shader::commonSourcePath()), driverParallel(false), reloads(0), failures(0), workerWindow(NULL), quit(false)
+{
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLAD_GL_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        driverParallel = true;
+    }
+#endif
+#ifdef GL_ARB_parallel_shader_compile
+    if (!driverParallel && GLAD_GL_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        driverParallel = true;
+    }
+#endif
+    if (!driverParallel)
+    {
+        // a hidden window only for its context, which shares programs with the main one.
+        // GLFW cannot read a hint back; the main window was created with the
+        // current one, so its visibility is what the hint goes back to
+        int visible = glfwGetWindowAttrib(window, GLFW_VISIBLE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        workerWindow = glfwCreateWindow(1, 1, "shader compiler", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+        glfwMakeContextCurrent(window);
+        if (workerWindow)
+            worker = std::thread(&ShaderRegistry::workerLoop, this);
+        else
+            std::cout << "SHADER_REGISTRY::NO_SHARED_CONTEXT, reloads wait for reloadDeferred()" << std::endl;
+    }
+
+#ifdef __linux__
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd < 0)
+        std::cout << "SHADER_REGISTRY::INOTIFY_FAILED, shaders will not be reloaded" << std::endl;
+#else
+    nextPoll = 0.0;
+#endif
+}
+
+ShaderRegistry::~ShaderRegistry()
+{
+    release();
+}
+
+void ShaderRegistry::release()
+{
+    if (worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+    if (workerWindow)
+    {
+        glfwDestroyWindow(workerWindow);
+        workerWindow = NULL;
+    }
+    for (size_t i = 0; i < results.size(); ++i)
+        glDeleteProgram(results[i].program);
+    results.clear();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        Entry& entry = entries[i];
+        if (entry.building && entry.program)
+        {
+            glDeleteShader(entry.vertex);
+            if (entry.fragment)
+                glDeleteShader(entry.fragment);
+            glDeleteProgram(entry.program);
+        }
+        entry.building = false;
+    }
+#ifdef __linux__
+    if (notifyFd >= 0)
+        close(notifyFd);
+    notifyFd = -1;
+#endif
+}
+
+void ShaderRegistry::add(Shader& shader, const char* vertexPath, const char* fragmentPath)
+{
+    entries.push_back(Entry(shader, vertexPath));
+    entries.back().fragmentPath = fragmentPath;
+    watch(entries.size() - 1);
+}
+
+void ShaderRegistry::add(Shader& shader, const char* vertexPath, const std::vector<const char*>& feedbackVaryings)
+{
+    entries.push_back(Entry(shader, vertexPath));
+    entries.back().varyings.assign(feedbackVaryings.begin(), feedbackVaryings.end());
+    watch(entries.size() - 1);
+}
+
+int ShaderRegistry::pendingCount() const
+{
+    int pending = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+        pending += entries[i].building || entries[i].dirty;
+    return pending;
+}
+
+void ShaderRegistry::watch(size_t index)
+{
+    const Entry& entry = entries[index];
+    const std::string* paths[SOURCE_COUNT] = { &entry.vertexPath, &entry.fragmentPath, &commonPath };
+#ifdef __linux__
+    if (notifyFd < 0)
+        return;
+    // directories are watched rather than files, so editors that save by
+    // writing a new file and renaming it over the old one are still seen
+    for (int i = 0; i < SOURCE_COUNT; ++i)
+    {
+        if (paths[i]->empty())
+            continue;
+        std::string directory, name;
+        splitPath(*paths[i], directory, name);
+        bool watched = false;
+        for (size_t d = 0; d < watchedDirectories.size(); ++d)
+            watched = watched || watchedDirectories[d].second == directory;
+        if (watched)
+            continue;
+        int descriptor = inotify_add_watch(notifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (descriptor >= 0)
+            watchedDirectories.push_back(std::make_pair(descriptor, directory));
+    }
+#else
+    modifiedTimes.resize(entries.size() * SOURCE_COUNT, 0);
+    for (int i = 0; i < SOURCE_COUNT; ++i)
+    {
+        struct stat status;
+        if (!paths[i]->empty() && stat(paths[i]->c_str(), &status) == 0)
+            modifiedTimes[index * SOURCE_COUNT + i] = static_cast<long long>(status.st_mtime);
+    }
+#endif
+}
+
+void ShaderRegistry::pollFiles()
+{
+#ifdef __linux__
+    if (notifyFd < 0)
+        return;
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+        ssize_t length = read(notifyFd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->len == 0)
+                continue;
+            std::string eventDirectory;
+            for (size_t d = 0; d < watchedDirectories.size(); ++d)
+            {
+                if (watchedDirectories[d].first == event->wd)
+                    eventDirectory = watchedDirectories[d].second;
+            }
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                const std::string* paths[SOURCE_COUNT] = { &entries[i].vertexPath, &entries[i].fragmentPath, &commonPath };
+                for (int p = 0; p < SOURCE_COUNT; ++p)
+                {
+                    std::string directory, name;
+                    splitPath(*paths[p], directory, name);
+                    if (!paths[p]->empty() && directory == eventDirectory && name == event->name)
+                        entries[i].dirty = true;
+                }
+            }
+        }
+    }
+#else
+    // without a change notification API, stat the sources a few times a second
+    double now = glfwGetTime();
+    if (now < nextPoll)
+        return;
+    nextPoll = now + 0.25;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const std::string* paths[SOURCE_COUNT] = { &entries[i].vertexPath, &entries[i].fragmentPath, &commonPath };
+        for (int p = 0; p < SOURCE_COUNT; ++p)
+        {
+            struct stat status;
+            if (paths[p]->empty() || stat(paths[p]->c_str(), &status) != 0)
+                continue;
+            long long modified = static_cast<long long>(status.st_mtime);
+            if (modified != modifiedTimes[i * SOURCE_COUNT + p])
+            {
+                modifiedTimes[i * SOURCE_COUNT + p] = modified;
+                entries[i].dirty = true;
+            }
+        }
+    }
+#endif
+}
+
+void ShaderRegistry::update()
+{
+    pollFiles();
+
+    if (workerWindow)
+    {
+        std::vector<Result> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.swap(results);
+        }
+        for (size_t i = 0; i < finished.size(); ++i)
+            finishBuild(finished[i].entry, finished[i].program);
+    }
+    else
+    {
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (entries[i].building)
+                pollBuild(i);
+        }
+    }
+
+    // without either way to build in the background a build would stall this
+    // frame, so changed programs stay dirty until reloadDeferred()
+    if (deferredReloads())
+        return;
+
+    // a file saved again while its program builds is picked up after that build
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].dirty && !entries[i].building)
+            startBuild(i);
+    }
+}
+
+void ShaderRegistry::reloadDeferred()
+{
+    if (!deferredReloads())
+        return;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (!entries[i].dirty)
+            continue;
+        startBuild(i);
+        if (entries[i].building)
+            pollBuild(i);
+    }
+}
+
+void ShaderRegistry::startBuild(size_t index)
+{
+    Entry& entry = entries[index];
+    entry.dirty = false;
+    std::string vertexCode, fragmentCode;
+    if (!readSource(entry.vertexPath, vertexCode) ||
+        (!entry.fragmentPath.empty() && !readSource(entry.fragmentPath, fragmentCode)))
+    {
+        // most likely caught halfway through a save; the next event retries
+        return;
+    }
+    vertexCode = Shader::expandSource(vertexCode, GL_VERTEX_SHADER);
+    if (!entry.fragmentPath.empty())
+        fragmentCode = Shader::expandSource(fragmentCode, GL_FRAGMENT_SHADER);
+
+    // same key as the Shader constructors, so a reloaded program is cached too
+    std::vector<std::string> cacheParts;
+    cacheParts.push_back(vertexCode);
+    if (!entry.fragmentPath.empty())
+        cacheParts.push_back(fragmentCode);
+    cacheParts.insert(cacheParts.end(), entry.varyings.begin(), entry.varyings.end());
+    std::string cacheKey = ProgramBinaryCache::key(cacheParts);
+
+    entry.building = true;
+    if (workerWindow)
+    {
+        Job job;
+        job.entry = index;
+        job.vertexCode.swap(vertexCode);
+        job.fragmentCode.swap(fragmentCode);
+        job.varyings = entry.varyings;
+        job.cacheKey = cacheKey;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        wake.notify_one();
+    }
+    else
+    {
+        entry.cacheKey = cacheKey;
+        entry.program = issueBuild(vertexCode, fragmentCode, entry.varyings, entry.vertex, entry.fragment);
+    }
+}
+
+void ShaderRegistry::pollBuild(size_t index)
+{
+    Entry& entry = entries[index];
+    // without parallel compile (only from reloadDeferred()) there is nothing to
+    // poll, and the status query below waits for the driver
+    GLint done = GL_TRUE;
+    if (driverParallel)
+        glGetProgramiv(entry.program, COMPLETION_STATUS, &done);
+    if (!done)
+        return;
+
+    GLuint program = entry.program;
+    if (finishLink(program, entry.vertex, entry.fragment))
+    {
+        ProgramBinaryCache::store(program, entry.cacheKey);
+    }
+    else
+    {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    entry.program = entry.vertex = entry.fragment = 0;
+    finishBuild(index, program);
+}
+
+void ShaderRegistry::finishBuild(size_t index, GLuint program)
+{
+    Entry& entry = entries[index];
+    entry.building = false;
+    if (program)
+    {
+        entry.shader->replaceProgram(program);
+        ++reloads;
+        std::cout << "SHADER_REGISTRY::RELOADED " << entry.vertexPath << " " << entry.fragmentPath << std::endl;
+    }
+    else
+    {
+        ++failures;
+        std::cout << "SHADER_REGISTRY::KEPT_PREVIOUS_PROGRAM " << entry.vertexPath << " " << entry.fragmentPath << std::endl;
+    }
+}
+
+void ShaderRegistry::workerLoop()
+{
+    glfwMakeContextCurrent(workerWindow);
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return quit || !jobs.empty(); });
+            if (quit)
+                break;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        GLuint vertex, fragment;
+        GLuint program = issueBuild(job.vertexCode, job.fragmentCode, job.varyings, vertex, fragment);
+        if (finishLink(program, vertex, fragment))
+        {
+            ProgramBinaryCache::store(program, job.cacheKey);
+        }
+        else
+        {
+            glDeleteProgram(program);
+            program = 0;
+        }
+        // the render context may only use the program once this one is done with it
+        glFinish();
+
+        Result result;
+        result.entry = job.entry;
+        result.program = program;
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(result);
+    }
+    glfwMakeContextCurrent(NULL);
+}
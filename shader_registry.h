@@ -0,0 +1,130 @@
+#pragma once
+#ifndef SHADER_REGISTRY_H
+#define SHADER_REGISTRY_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "shader.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hot reload for the shader programs of the app. Registered programs have their
+// source files and the chunk shared by all shaders (Shader::commonSourcePath())
+// watched (inotify on Linux, modification times elsewhere); when one changes,
+// the program is rebuilt without blocking the render thread and swapped into
+// its Shader only once it has linked. A program that fails to build leaves the
+// old one in place.
+//
+// Builds use GL_KHR_parallel_shader_compile (or the ARB version) when the
+// driver has it: compile and link are issued from update() and their
+// completion is polled on later frames. Otherwise a worker thread compiles on
+// a hidden context that shares objects with the main window. If that context
+// cannot be created either, update() only collects the changes and
+// reloadDeferred() builds them, stalling the thread that calls it.
+class ShaderRegistry
+{
+public:
+    // window is the main window; must be called on the thread that owns its context
+    explicit ShaderRegistry(GLFWwindow* window);
+    ~ShaderRegistry();
+    // stops the worker and destroys its context; call before glfwTerminate()
+    void release();
+
+    // watches the sources of a vertex/fragment program
+    void add(Shader& shader, const char* vertexPath, const char* fragmentPath);
+    // watches the source of a vertex-only transform feedback program
+    void add(Shader& shader, const char* vertexPath, const std::vector<const char*>& feedbackVaryings);
+
+    // call once per frame on the render thread: picks up changed files, starts
+    // their builds and swaps in every program that finished linking
+    void update();
+    // with deferredReloads(), compiles and swaps in the changed programs on the
+    // render thread and waits for them; call where a stall is acceptable
+    void reloadDeferred();
+
+    // true if builds run on driver threads, false if on the shared-context worker
+    bool parallelCompile() const { return driverParallel; }
+    // true if changed programs wait for reloadDeferred() instead of building in the background
+    bool deferredReloads() const { return !driverParallel && !workerWindow; }
+    int reloadCount() const { return reloads; }
+    int failureCount() const { return failures; }
+    int pendingCount() const;
+
+private:
+    struct Entry
+    {
+        Shader* shader;
+        std::string vertexPath;
+        std::string fragmentPath; // empty for transform feedback programs
+        std::vector<std::string> varyings;
+        bool dirty;
+        bool building;
+        // objects of the build in flight (parallel compile only)
+        GLuint program;
+        GLuint vertex;
+        GLuint fragment;
+        std::string cacheKey;
+
+        Entry(Shader& target, const char* vertexSource)
+            : shader(&target), vertexPath(vertexSource), dirty(false), building(false),
+              program(0), vertex(0), fragment(0) {}
+    };
+    // a build handed to the worker, and what came back
+    struct Job
+    {
+        size_t entry;
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::vector<std::string> varyings;
+        std::string cacheKey;
+    };
+    struct Result
+    {
+        size_t entry;
+        GLuint program; // 0 if the build failed
+    };
+
+    // the sources of an entry: vertex, fragment (may be empty) and the common chunk
+    enum { SOURCE_COUNT = 3 };
+
+    std::vector<Entry> entries;
+    std::string commonPath;
+    bool driverParallel;
+    int reloads;
+    int failures;
+
+    // file watching
+#ifdef __linux__
+    int notifyFd;
+    std::vector<std::pair<int, std::string> > watchedDirectories;
+#else
+    double nextPoll;
+    std::vector<long long> modifiedTimes; // SOURCE_COUNT per entry
+#endif
+
+    // shared-context worker
+    GLFWwindow* workerWindow;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::vector<Result> results;
+    bool quit;
+
+    void watch(size_t entry);
+    void pollFiles();
+    void startBuild(size_t entry);
+    void pollBuild(size_t entry);
+    void finishBuild(size_t entry, GLuint program);
+    void workerLoop();
+
+    ShaderRegistry(const ShaderRegistry&);
+    ShaderRegistry& operator=(const ShaderRegistry&);
+};
+#endif
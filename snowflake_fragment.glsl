@@ -2,7 +2,7 @@
 
 out vec4 FragColor;
 
-uniform vec4 objectColor;
+in vec4 layerColor;
 
 void main() {
     // 㵱ǰƬڵĵ
@@ -12,5 +12,5 @@ void main() {
         discard;
     }
     
-    FragColor = vec4(objectColor); 
+    FragColor = layerColor;
 }
@@ -1,15 +1,42 @@
 #version 330 core
-layout(location = 0) in vec3 aPos;
+// per-firefly data, one point per firefly; each instance draws one layer of all
+// of them (positions come from separate x/y/z arrays of the SoA firefly store)
+layout(location = 0) in float aX;
+layout(location = 1) in float aY;
+layout(location = 2) in float aZ;
+layout(location = 3) in float aSize;
+layout(location = 4) in float aPhase;
+// position one simulation step earlier
+layout(location = 5) in float aPrevX;
+layout(location = 6) in float aPrevY;
+layout(location = 7) in float aPrevZ;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float pointSize;
+uniform float time;
+uniform float interpolation; // 0 = previous step, 1 = latest step
+uniform int firstLayer;      // layer of instance 0
+
+out vec4 layerColor;
+
+// 塢Ρ͸
+const float layerSizes[3] = float[3](5.0, 15.0, 30.0);
+const vec4 layerColors[3] = vec4[3](
+    vec4(0.0, 0.0, 0.0, 1.0),
+    vec4(0.98, 0.58, 0.098, 1.0),
+    vec4(0.969, 0.89, 0.455, 0.5)
+);
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    int layer = gl_InstanceID + firstLayer;
+    vec3 aPos = mix(vec3(aPrevX, aPrevY, aPrevZ), vec3(aX, aY, aZ), interpolation);
+    gl_Position = projection * view * vec4(aPos, 1.0);
     // ľ
-    vec3 viewPos = vec3(view * model * vec4(aPos, 1.0)); // תͼռ
-    float distance = length(viewPos); // 
-    gl_PointSize = pointSize / (distance * 1.0); // ɸҪõС
+    vec3 eyePos = vec3(view * vec4(aPos, 1.0)); // תͼռ
+    float distance = length(eyePos); // 
+    // size ȡֵ 1  5 3 Ϊ׼ŸС
+    gl_PointSize = layerSizes[layer] * (aSize / 3.0) / distance;
+
+    layerColor = layerColors[layer];
+    // λ˸
+    if (layer == 2)
+        layerColor.a *= 0.8 + 0.2 * sin(time * 3.0 + aPhase);
 }
@@ -0,0 +1,70 @@
+#include "sphere_mesh.h"
+
+#include <cmath>
+
+SphereMesh generateSphereLods(const int levels[][2], size_t levelCount)
+{
+    const float pi = 3.14159265358979f;
+    SphereMesh mesh;
+    for (size_t level = 0; level < levelCount; ++level)
+    {
+        int sectorCount = levels[level][0];
+        int stackCount = levels[level][1];
+        unsigned int firstVertex = static_cast<unsigned int>(mesh.vertices.size() / 6);
+        SphereLod lod = { sectorCount, stackCount, mesh.indices.size(), 0 };
+
+        // (stackCount + 1) rings of (sectorCount + 1) vertices, pole to pole;
+        // the first and last vertex of a ring coincide so the seam is closed
+        float sectorStep = 2.0f * pi / sectorCount;
+        float stackStep = pi / stackCount;
+        for (int i = 0; i <= stackCount; ++i)
+        {
+            float stackAngle = pi / 2.0f - i * stackStep; // from pi/2 to -pi/2
+            float xz = std::cos(stackAngle);
+            float y = std::sin(stackAngle);
+            for (int j = 0; j <= sectorCount; ++j)
+            {
+                float sectorAngle = j * sectorStep;
+                float x = xz * std::cos(sectorAngle);
+                float z = xz * std::sin(sectorAngle);
+                float vertex[6] = { x, y, z, x, y, z };
+                mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + 6);
+            }
+        }
+
+        // two triangles per quad, one at the poles
+        for (int i = 0; i < stackCount; ++i)
+        {
+            unsigned int k1 = firstVertex + i * (sectorCount + 1);
+            unsigned int k2 = k1 + sectorCount + 1;
+            for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+            {
+                if (i != 0)
+                {
+                    unsigned int triangle[3] = { k1, k1 + 1, k2 };
+                    mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+                }
+                if (i != stackCount - 1)
+                {
+                    unsigned int triangle[3] = { k1 + 1, k2 + 1, k2 };
+                    mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+                }
+            }
+        }
+        lod.indexCount = mesh.indices.size() - lod.firstIndex;
+        mesh.lods.push_back(lod);
+    }
+    return mesh;
+}
+
+size_t selectSphereLod(const SphereMesh& mesh, float screenRadius, float maxEdgePixels)
+{
+    // an equator edge spans 2 * pi * r / sectorCount pixels
+    float sectorsNeeded = 2.0f * 3.14159265f * screenRadius / maxEdgePixels;
+    for (size_t level = 0; level < mesh.lods.size(); ++level)
+    {
+        if (mesh.lods[level].sectorCount >= sectorsNeeded)
+            return level;
+    }
+    return mesh.lods.empty() ? 0 : mesh.lods.size() - 1;
+}
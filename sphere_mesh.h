@@ -0,0 +1,35 @@
+#pragma once
+#ifndef SPHERE_MESH_H
+#define SPHERE_MESH_H
+
+#include <cstddef>
+#include <vector>
+
+// One level of detail inside a SphereMesh: a range of its index array.
+struct SphereLod
+{
+    int sectorCount;
+    int stackCount;
+    size_t firstIndex;
+    size_t indexCount;
+};
+
+// Unit spheres at several levels of detail sharing one vertex and one index
+// array, so every level can be drawn from the same buffers. Each vertex is a
+// position followed by its normal (equal on a unit sphere, kept separate so
+// the layout matches the other lit meshes). Indices already include each
+// level's vertex offset.
+struct SphereMesh
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<SphereLod> lods; // coarsest first
+};
+
+// levels holds (sectorCount, stackCount) pairs, coarsest first
+SphereMesh generateSphereLods(const int levels[][2], size_t levelCount);
+
+// coarsest level whose polygon edges stay under maxEdgePixels for a sphere
+// covering screenRadius pixels; the finest level if none does
+size_t selectSphereLod(const SphereMesh& mesh, float screenRadius, float maxEdgePixels);
+#endif
@@ -524,6 +524,19 @@ extern "C" {
 	STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 	STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+	// JPEG decoding can be split into tasks: the entropy decoding of restart
+	// interval segments (images loaded from memory only), the IDCT of progressive
+	// images and the upsampling + color conversion of row bands. parallel_for
+	// must call task(task_data, i) for every i in [0, count), on any threads, and
+	// return once all calls have returned. max_tasks is about the number of
+	// threads available. The output is identical to a serial decode (for
+	// corrupt files, except where a serial decode gives up and leaves the rest
+	// of the image unset). Pass NULL to decode on the calling thread only (the
+	// default).
+	typedef void stbi_jpeg_task(void* task_data, int index);
+	typedef void stbi_jpeg_parallel_for(void* user, int count, stbi_jpeg_task* task, void* task_data);
+	STBIDEF void stbi_jpeg_set_parallel_for(stbi_jpeg_parallel_for* parallel_for, void* user, int max_tasks);
+
 	// ZLIB client - used by PNG, available for other purposes
 
 	STBIDEF char* stbi_zlib_decode_malloc_guesssize(const char* buffer, int len, int initial_size, int* outlen);
@@ -774,6 +787,37 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 kernels for the JPEG IDCT and color conversion. Like SSE2 above, GCC
+// and Clang only get them when the whole build targets AVX2 (-mavx2); VC++
+// compiles them anyway and checks the CPU at run time. Define STBI_NO_AVX2
+// to leave them out.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG) && (defined(__AVX2__) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__AVX2__)
+static int stbi__avx2_available(void)
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return 0;
+	__cpuid(info, 1);
+	// the OS must save the YMM registers (OSXSAVE, then XCR0 bits 1 and 2)
+	if (((info[2] >> 27) & 1) == 0 || ((info[2] >> 28) & 1) == 0 || (_xgetbv(0) & 6) != 6)
+		return 0;
+	__cpuidex(info, 7, 0);
+	return ((info[1] >> 5) & 1) != 0;
+}
+#else
+static int stbi__avx2_available(void)
+{
+	// compiled with -mavx2 (or /arch:AVX2), so the compiler already assumes it
+	return 1;
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -1134,6 +1178,17 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+static stbi_jpeg_parallel_for* stbi__jpeg_parallel_for_func = NULL;
+static void* stbi__jpeg_parallel_user = NULL;
+static int stbi__jpeg_parallel_tasks = 1;
+
+STBIDEF void stbi_jpeg_set_parallel_for(stbi_jpeg_parallel_for* parallel_for, void* user, int max_tasks)
+{
+	stbi__jpeg_parallel_for_func = parallel_for;
+	stbi__jpeg_parallel_user = user;
+	stbi__jpeg_parallel_tasks = max_tasks > 1 ? max_tasks : 1;
+}
+
 static void* stbi__load_main(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri, int bpc)
 {
 	memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1998,6 +2053,8 @@ typedef struct
 
 	// kernels
 	void (*idct_block_kernel)(stbi_uc* out, int out_stride, short data[64]);
+	// two blocks at once, or NULL
+	void (*idct_pair_kernel)(stbi_uc* out0, int out0_stride, short data0[64], stbi_uc* out1, int out1_stride, short data1[64]);
 	void (*YCbCr_to_RGB_kernel)(stbi_uc* out, const stbi_uc* y, const stbi_uc* pcb, const stbi_uc* pcr, int count, int step);
 	stbi_uc* (*resample_row_hv_2_kernel)(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs);
 } stbi__jpeg;
@@ -2717,6 +2774,184 @@ static void stbi__idct_simd(stbi_uc* out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 integer IDCT of two blocks at once: the SSE2 IDCT above with the first
+// block in the low 128-bit lane and the second in the high lane. Every step
+// stays within a lane, so both blocks come out bit-identical to the C version.
+static void stbi__idct_avx2_pair(stbi_uc* out0, int out0_stride, short data0[64], stbi_uc* out1, int out1_stride, short data1[64])
+{
+	__m256i row0, row1, row2, row3, row4, row5, row6, row7;
+	__m256i tmp;
+
+#define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##lo = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i c0##hi = _mm256_unpackhi_epi16((x),(y)); \
+      __m256i out0##_l = _mm256_madd_epi16(c0##lo, c0); \
+      __m256i out0##_h = _mm256_madd_epi16(c0##hi, c0); \
+      __m256i out1##_l = _mm256_madd_epi16(c0##lo, c1); \
+      __m256i out1##_h = _mm256_madd_epi16(c0##hi, c1)
+
+#define dct_widen(out, in) \
+      __m256i out##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+      __m256i out##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4)
+
+#define dct_wadd(out, a, b) \
+      __m256i out##_l = _mm256_add_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_add_epi32(a##_h, b##_h)
+
+#define dct_wsub(out, a, b) \
+      __m256i out##_l = _mm256_sub_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_sub_epi32(a##_h, b##_h)
+
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+         __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, s), _mm256_srai_epi32(sum_h, s)); \
+         out1 = _mm256_packs_epi32(_mm256_srai_epi32(dif_l, s), _mm256_srai_epi32(dif_h, s)); \
+      }
+
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi8(a, b); \
+      b = _mm256_unpackhi_epi8(tmp, b)
+
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi16(a, b); \
+      b = _mm256_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(row0, row4); \
+         __m256i dif04 = _mm256_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(row1, row7); \
+         __m256i sum35 = _mm256_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+#define dct_load(r) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i*) (data0 + (r) * 8))), \
+                              _mm_load_si128((const __m128i*) (data1 + (r) * 8)), 1)
+
+	__m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+	__m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+	__m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+	__m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+	__m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+	__m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+	__m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+	__m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+	__m256i bias_0 = _mm256_set1_epi32(512);
+	__m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+	row0 = dct_load(0);
+	row1 = dct_load(1);
+	row2 = dct_load(2);
+	row3 = dct_load(3);
+	row4 = dct_load(4);
+	row5 = dct_load(5);
+	row6 = dct_load(6);
+	row7 = dct_load(7);
+
+	// column pass
+	dct_pass(bias_0, 10);
+
+	{
+		// 16bit 8x8 transpose, per lane
+		dct_interleave16(row0, row4);
+		dct_interleave16(row1, row5);
+		dct_interleave16(row2, row6);
+		dct_interleave16(row3, row7);
+
+		dct_interleave16(row0, row2);
+		dct_interleave16(row1, row3);
+		dct_interleave16(row4, row6);
+		dct_interleave16(row5, row7);
+
+		dct_interleave16(row0, row1);
+		dct_interleave16(row2, row3);
+		dct_interleave16(row4, row5);
+		dct_interleave16(row6, row7);
+	}
+
+	// row pass
+	dct_pass(bias_1, 17);
+
+	{
+		__m256i p0 = _mm256_packus_epi16(row0, row1);
+		__m256i p1 = _mm256_packus_epi16(row2, row3);
+		__m256i p2 = _mm256_packus_epi16(row4, row5);
+		__m256i p3 = _mm256_packus_epi16(row6, row7);
+
+		// 8bit 8x8 transpose, per lane
+		dct_interleave8(p0, p2);
+		dct_interleave8(p1, p3);
+
+		dct_interleave8(p0, p1);
+		dct_interleave8(p2, p3);
+
+		dct_interleave8(p0, p2);
+		dct_interleave8(p1, p3);
+
+		// store: rows 0..7 of each block are p0, p0 >> 64, p2, p2 >> 64, p1, p1 >> 64, p3, p3 >> 64
+		{
+			__m256i rows[4];
+			int i;
+			rows[0] = p0;
+			rows[1] = p2;
+			rows[2] = p1;
+			rows[3] = p3;
+			for (i = 0; i < 4; ++i) {
+				__m128i a = _mm256_castsi256_si128(rows[i]);
+				__m128i b = _mm256_extracti128_si256(rows[i], 1);
+				_mm_storel_epi64((__m128i*) out0, a); out0 += out0_stride;
+				_mm_storel_epi64((__m128i*) out0, _mm_shuffle_epi32(a, 0x4e)); out0 += out0_stride;
+				_mm_storel_epi64((__m128i*) out1, b); out1 += out1_stride;
+				_mm_storel_epi64((__m128i*) out1, _mm_shuffle_epi32(b, 0x4e)); out1 += out1_stride;
+			}
+		}
+	}
+	_mm256_zeroupper();
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+#undef dct_load
+}
+
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2959,68 +3194,219 @@ static void stbi__jpeg_reset(stbi__jpeg* j)
 	// since we don't even allow 1<<30 pixels
 }
 
-static int stbi__parse_entropy_coded_data(stbi__jpeg* z)
+// images with fewer pixels than this are decoded on the calling thread only
+#define STBI__JPEG_PARALLEL_MIN_PIXELS  (1 << 18)
+
+static int stbi__jpeg_use_parallel(stbi__jpeg* z)
 {
-	stbi__jpeg_reset(z);
-	if (!z->progressive) {
-		if (z->scan_n == 1) {
-			int i, j;
-			STBI_SIMD_ALIGN(short, data[64]);
-			int n = z->order[0];
-			// non-interleaved data, we just need to process one block at a time,
-			// in trivial scanline order
-			// number of blocks to do just depends on how many actual "pixels" this
-			// component has, independent of interleaved MCU blocking and such
-			int w = (z->img_comp[n].x + 7) >> 3;
-			int h = (z->img_comp[n].y + 7) >> 3;
-			for (j = 0; j < h; ++j) {
-				for (i = 0; i < w; ++i) {
-					int ha = z->img_comp[n].ha;
-					if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-					z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
-					// every data block is an MCU, so countdown the restart interval
-					if (--z->todo <= 0) {
-						if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-						// if it's NOT a restart, then just bail, so we get corrupt data
-						// rather than no data
-						if (!STBI__RESTART(z->marker)) return 1;
-						stbi__jpeg_reset(z);
-					}
+	return stbi__jpeg_parallel_for_func && stbi__jpeg_parallel_tasks > 1 &&
+		(stbi__uint32)z->s->img_x * z->s->img_y >= STBI__JPEG_PARALLEL_MIN_PIXELS;
+}
+
+// number of MCUs in the current (non-progressive) scan
+static int stbi__jpeg_scan_mcus(stbi__jpeg* z)
+{
+	if (z->scan_n == 1) {
+		// non-interleaved data: every block of the component is an MCU
+		int n = z->order[0];
+		return ((z->img_comp[n].x + 7) >> 3) * ((z->img_comp[n].y + 7) >> 3);
+	}
+	return z->img_mcu_x * z->img_mcu_y;
+}
+
+// decodes and IDCTs MCU number mcu (in scanline order) of the current
+// baseline scan. Blocks are transformed two at a time if there is a kernel for it.
+static int stbi__jpeg_decode_mcu(stbi__jpeg* z, int mcu)
+{
+	STBI_SIMD_ALIGN(short, data[2][64]);
+	stbi_uc* pending = NULL;
+	int pending_stride = 0;
+	int k, x, y;
+	if (z->scan_n == 1) {
+		int n = z->order[0];
+		int w = (z->img_comp[n].x + 7) >> 3;
+		int i = mcu % w, j = mcu / w;
+		int ha = z->img_comp[n].ha;
+		if (!stbi__jpeg_decode_block(z, data[0], z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+		z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data[0]);
+		return 1;
+	}
+	// scan an interleaved mcu... process scan_n components in order
+	for (k = 0; k < z->scan_n; ++k) {
+		int n = z->order[k];
+		int i = mcu % z->img_mcu_x, j = mcu / z->img_mcu_x;
+		// scan out an mcu's worth of this component; that's just determined
+		// by the basic H and V specified for the component
+		for (y = 0; y < z->img_comp[n].v; ++y) {
+			for (x = 0; x < z->img_comp[n].h; ++x) {
+				int x2 = (i * z->img_comp[n].h + x) * 8;
+				int y2 = (j * z->img_comp[n].v + y) * 8;
+				int ha = z->img_comp[n].ha;
+				stbi_uc* out = z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2;
+				short* block = data[pending ? 1 : 0];
+				if (!stbi__jpeg_decode_block(z, block, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+				if (!z->idct_pair_kernel) {
+					z->idct_block_kernel(out, z->img_comp[n].w2, block);
+				}
+				else if (pending) {
+					z->idct_pair_kernel(pending, pending_stride, data[0], out, z->img_comp[n].w2, data[1]);
+					pending = NULL;
+				}
+				else {
+					pending = out;
+					pending_stride = z->img_comp[n].w2;
 				}
 			}
-			return 1;
 		}
-		else { // interleaved
-			int i, j, k, x, y;
-			STBI_SIMD_ALIGN(short, data[64]);
-			for (j = 0; j < z->img_mcu_y; ++j) {
-				for (i = 0; i < z->img_mcu_x; ++i) {
-					// scan an interleaved mcu... process scan_n components in order
-					for (k = 0; k < z->scan_n; ++k) {
-						int n = z->order[k];
-						// scan out an mcu's worth of this component; that's just determined
-						// by the basic H and V specified for the component
-						for (y = 0; y < z->img_comp[n].v; ++y) {
-							for (x = 0; x < z->img_comp[n].h; ++x) {
-								int x2 = (i * z->img_comp[n].h + x) * 8;
-								int y2 = (j * z->img_comp[n].v + y) * 8;
-								int ha = z->img_comp[n].ha;
-								if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-								z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2, z->img_comp[n].w2, data);
-							}
-						}
-					}
-					// after all interleaved components, that's an interleaved MCU,
-					// so now count down the restart interval
-					if (--z->todo <= 0) {
-						if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-						if (!STBI__RESTART(z->marker)) return 1;
-						stbi__jpeg_reset(z);
-					}
-				}
+	}
+	if (pending)
+		z->idct_block_kernel(pending, pending_stride, data[0]);
+	return 1;
+}
+
+typedef struct
+{
+	stbi__jpeg* z;
+	stbi_uc** starts; // first byte of each restart interval
+	int segments;     // decoded by the tasks; the last one is left to the caller
+	int tasks;
+	int* failed;      // per task, the first segment that did not decode cleanly
+} stbi__jpeg_segment_job;
+
+static void stbi__jpeg_decode_segments(void* task_data, int index)
+{
+	stbi__jpeg_segment_job* job = (stbi__jpeg_segment_job*)task_data;
+	int per_task = job->segments / job->tasks, extra = job->segments % job->tasks;
+	int first = index * per_task + (index < extra ? index : extra);
+	int last = first + per_task + (index < extra);
+	int total = stbi__jpeg_scan_mcus(job->z);
+	int segment, mcu;
+	stbi__context s;
+	// the huffman tables are read-only and the segments write disjoint
+	// blocks, so a shallow copy of the decoder state is all a task needs
+	stbi__jpeg* z = (stbi__jpeg*)stbi__malloc(sizeof(stbi__jpeg));
+	if (!z) {
+		job->failed[index] = first;
+		return;
+	}
+	*z = *job->z;
+	s = *job->z->s;
+	z->s = &s;
+	for (segment = first; segment < last; ++segment) {
+		int end = (segment + 1) * z->restart_interval;
+		s.img_buffer = job->starts[segment];
+		stbi__jpeg_reset(z);
+		for (mcu = segment * z->restart_interval; mcu < end && mcu < total; ++mcu)
+			if (!stbi__jpeg_decode_mcu(z, mcu))
+				break;
+		// exactly what the serial loop checks at the end of an interval; if it
+		// would not find the restart marker, it stops decoding there
+		if (mcu == end && z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+		if (mcu < end || !STBI__RESTART(z->marker)) {
+			job->failed[index] = segment;
+			break;
+		}
+	}
+	STBI_FREE(z);
+}
+
+// decodes all but the last restart interval of a baseline scan in parallel.
+// Returns how many intervals are done and leaves the stream at the start of
+// the next; the caller decodes the rest serially. That is 0 if the scan does
+// not qualify, and stops short of any interval that fails to decode, so the
+// caller reports the error (or stops) exactly where a serial decode would.
+static int stbi__jpeg_parallel_segments(stbi__jpeg* z)
+{
+	stbi__jpeg_segment_job job;
+	stbi_uc *p, *end;
+	int total, count, found, tasks, i, done;
+
+	if (!stbi__jpeg_use_parallel(z) || z->restart_interval <= 0 || z->s->read_from_callbacks)
+		return 0;
+	total = stbi__jpeg_scan_mcus(z);
+	count = (total + z->restart_interval - 1) / z->restart_interval;
+	if (count < 2)
+		return 0;
+
+	// find the restart markers; the scan ends at the first other marker
+	job.starts = (stbi_uc**)stbi__malloc_mad2(count, sizeof(stbi_uc*), 0);
+	if (!job.starts)
+		return 0;
+	job.starts[0] = z->s->img_buffer;
+	found = 1;
+	p = z->s->img_buffer;
+	end = z->s->img_buffer_end;
+	while (p + 1 < end) {
+		if (p[0] != 0xff || p[1] == 0x00) {
+			p += p[0] == 0xff ? 2 : 1;
+			continue;
+		}
+		if (p[1] == 0xff) { // fill byte
+			++p;
+			continue;
+		}
+		if (!STBI__RESTART(p[1]) || found == count)
+			break;
+		job.starts[found++] = p + 2;
+		p += 2;
+	}
+	if (found != count) {
+		STBI_FREE(job.starts);
+		return 0;
+	}
+
+	tasks = stbi__jpeg_parallel_tasks * 2;
+	if (tasks > count - 1)
+		tasks = count - 1;
+	job.z = z;
+	job.segments = count - 1;
+	job.tasks = tasks;
+	job.failed = (int*)stbi__malloc_mad2(tasks, sizeof(int), 0);
+	if (!job.failed) {
+		STBI_FREE(job.starts);
+		return 0;
+	}
+	for (i = 0; i < tasks; ++i)
+		job.failed[i] = count - 1;
+	stbi__jpeg_parallel_for_func(stbi__jpeg_parallel_user, tasks, stbi__jpeg_decode_segments, &job);
+
+	// intervals are independent, so everything before the first failure is
+	// just as the serial decoder would have left it
+	done = count - 1;
+	for (i = 0; i < tasks; ++i)
+		if (job.failed[i] < done)
+			done = job.failed[i];
+	z->s->img_buffer = job.starts[done];
+	STBI_FREE(job.failed);
+	STBI_FREE(job.starts);
+	return done;
+}
+
+static int stbi__parse_entropy_coded_data(stbi__jpeg* z)
+{
+	stbi__jpeg_reset(z);
+	if (!z->progressive) {
+		int mcu = 0, total = stbi__jpeg_scan_mcus(z);
+		// with restart markers, the intervals are independent: all but the last
+		// can be decoded in parallel, after which we carry on serially
+		int done = stbi__jpeg_parallel_segments(z);
+		if (done) {
+			mcu = done * z->restart_interval;
+			stbi__jpeg_reset(z);
+		}
+		for (; mcu < total; ++mcu) {
+			if (!stbi__jpeg_decode_mcu(z, mcu)) return 0;
+			// count down the restart interval (for non-interleaved data every
+			// block is an MCU)
+			if (--z->todo <= 0) {
+				if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+				// if it's NOT a restart, then just bail, so we get corrupt data
+				// rather than no data
+				if (!STBI__RESTART(z->marker)) return 1;
+				stbi__jpeg_reset(z);
 			}
-			return 1;
 		}
+		return 1;
 	}
 	else {
 		if (z->scan_n == 1) {
@@ -3094,22 +3480,59 @@ static void stbi__jpeg_dequantize(short* data, stbi__uint16* dequant)
 		data[i] *= dequant[i];
 }
 
+// dequantize and idct block rows [j0, j1) of component n
+static void stbi__jpeg_finish_rows(stbi__jpeg* z, int n, int j0, int j1)
+{
+	int i, j;
+	int w = (z->img_comp[n].x + 7) >> 3;
+	int w2 = z->img_comp[n].w2;
+	for (j = j0; j < j1; ++j) {
+		short* data = z->img_comp[n].coeff + 64 * j * z->img_comp[n].coeff_w;
+		stbi_uc* out = z->img_comp[n].data + w2 * j * 8;
+		i = 0;
+		if (z->idct_pair_kernel) {
+			for (; i + 1 < w; i += 2) {
+				stbi__jpeg_dequantize(data + 64 * i, z->dequant[z->img_comp[n].tq]);
+				stbi__jpeg_dequantize(data + 64 * (i + 1), z->dequant[z->img_comp[n].tq]);
+				z->idct_pair_kernel(out + i * 8, w2, data + 64 * i, out + (i + 1) * 8, w2, data + 64 * (i + 1));
+			}
+		}
+		for (; i < w; ++i) {
+			stbi__jpeg_dequantize(data + 64 * i, z->dequant[z->img_comp[n].tq]);
+			z->idct_block_kernel(out + i * 8, w2, data + 64 * i);
+		}
+	}
+}
+
+typedef struct
+{
+	stbi__jpeg* z;
+	int bands; // per component
+} stbi__jpeg_finish_job;
+
+static void stbi__jpeg_finish_band(void* task_data, int index)
+{
+	stbi__jpeg_finish_job* job = (stbi__jpeg_finish_job*)task_data;
+	int n = index / job->bands, band = index % job->bands;
+	int h = (job->z->img_comp[n].y + 7) >> 3;
+	stbi__jpeg_finish_rows(job->z, n, h * band / job->bands, h * (band + 1) / job->bands);
+}
+
 static void stbi__jpeg_finish(stbi__jpeg* z)
 {
 	if (z->progressive) {
-		// dequantize and idct the data
-		int i, j, n;
-		for (n = 0; n < z->s->img_n; ++n) {
-			int w = (z->img_comp[n].x + 7) >> 3;
-			int h = (z->img_comp[n].y + 7) >> 3;
-			for (j = 0; j < h; ++j) {
-				for (i = 0; i < w; ++i) {
-					short* data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-					stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-					z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
-				}
-			}
+		// dequantize and idct the data; blocks are independent, so bands of
+		// block rows can go in parallel
+		int n;
+		if (stbi__jpeg_use_parallel(z)) {
+			stbi__jpeg_finish_job job;
+			job.z = z;
+			job.bands = stbi__jpeg_parallel_tasks * 2;
+			stbi__jpeg_parallel_for_func(stbi__jpeg_parallel_user, z->s->img_n * job.bands, stbi__jpeg_finish_band, &job);
+			return;
 		}
+		for (n = 0; n < z->s->img_n; ++n)
+			stbi__jpeg_finish_rows(z, n, 0, (z->img_comp[n].y + 7) >> 3);
 	}
 }
 
@@ -3839,10 +4262,73 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc* out, stbi_uc const* y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// the SSE2 conversion above, 16 pixels at a time; the tail goes to it
+static void stbi__YCbCr_to_RGB_avx2(stbi_uc* out, stbi_uc const* y, stbi_uc const* pcb, stbi_uc const* pcr, int count, int step)
+{
+	int i = 0;
+	if (step == 4) {
+		__m128i signflip = _mm_set1_epi8(-0x80);
+		__m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f * 4096.0f + 0.5f));
+		__m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f * 4096.0f + 0.5f));
+		__m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f * 4096.0f + 0.5f));
+		__m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f * 4096.0f + 0.5f));
+		__m256i y_bias = _mm256_set1_epi16(128);
+		__m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+		for (; i + 15 < count; i += 16) {
+			// load
+			__m128i y_bytes = _mm_loadu_si128((__m128i*) (y + i));
+			__m128i cr_biased = _mm_xor_si128(_mm_loadu_si128((__m128i*) (pcr + i)), signflip); // -128
+			__m128i cb_biased = _mm_xor_si128(_mm_loadu_si128((__m128i*) (pcb + i)), signflip); // -128
+
+			// widen to short, same values as the SSE2 unpacks: y << 8 | 128, c << 8
+			__m256i yw = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+			__m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cr_biased), 8);
+			__m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cb_biased), 8);
+
+			// color transform
+			__m256i yws = _mm256_srli_epi16(yw, 4);
+			__m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+			__m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+			__m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+			__m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+			__m256i rws = _mm256_add_epi16(cr0, yws);
+			__m256i gwt = _mm256_add_epi16(cb0, yws);
+			__m256i bws = _mm256_add_epi16(yws, cb1);
+			__m256i gws = _mm256_add_epi16(gwt, cr1);
+
+			// descale
+			__m256i rw = _mm256_srai_epi16(rws, 4);
+			__m256i bw = _mm256_srai_epi16(bws, 4);
+			__m256i gw = _mm256_srai_epi16(gws, 4);
+
+			// back to byte, set up for transpose
+			__m256i brb = _mm256_packus_epi16(rw, bw);
+			__m256i gxb = _mm256_packus_epi16(gw, xw);
+
+			// transpose to interleave channels; lanes hold pixels 0-3 | 8-11 and 4-7 | 12-15
+			__m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+			__m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+			__m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+			__m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+			// store in pixel order
+			_mm256_storeu_si256((__m256i*) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+			_mm256_storeu_si256((__m256i*) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+			out += 64;
+		}
+		_mm256_zeroupper();
+	}
+	stbi__YCbCr_to_RGB_simd(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg* j)
 {
 	j->idct_block_kernel = stbi__idct_block;
+	j->idct_pair_kernel = NULL;
 	j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
 	j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
@@ -3854,6 +4340,13 @@ static void stbi__setup_jpeg(stbi__jpeg* j)
 	}
 #endif
 
+#ifdef STBI_AVX2
+	if (stbi__sse2_available() && stbi__avx2_available()) {
+		j->idct_pair_kernel = stbi__idct_avx2_pair;
+		j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+	}
+#endif
+
 #ifdef STBI_NEON
 	j->idct_block_kernel = stbi__idct_simd;
 	j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3884,6 +4377,167 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
 	return (stbi_uc)((t + (t >> 8)) >> 8);
 }
 
+// resamples and color-converts output rows [j0, j1) to first (row j0) and on;
+// res_comp must be the resampler state at row j0 and is advanced to j1
+static void stbi__jpeg_output_rows(stbi__jpeg* z, stbi__resample* res_comp, stbi_uc** linebuf, stbi_uc* first, int n, int decode_n, int is_rgb, unsigned int j0, unsigned int j1)
+{
+	int k;
+	unsigned int i, j;
+	stbi_uc* coutput[4] = { NULL, NULL, NULL, NULL };
+	for (j = j0; j < j1; ++j) {
+		stbi_uc* out = first + n * z->s->img_x * (j - j0);
+		for (k = 0; k < decode_n; ++k) {
+			stbi__resample* r = &res_comp[k];
+			int y_bot = r->ystep >= (r->vs >> 1);
+			coutput[k] = r->resample(linebuf[k],
+				y_bot ? r->line1 : r->line0,
+				y_bot ? r->line0 : r->line1,
+				r->w_lores, r->hs);
+			if (++r->ystep >= r->vs) {
+				r->ystep = 0;
+				r->line0 = r->line1;
+				if (++r->ypos < z->img_comp[k].y)
+					r->line1 += z->img_comp[k].w2;
+			}
+		}
+		if (n >= 3) {
+			stbi_uc* y = coutput[0];
+			if (z->s->img_n == 3) {
+				if (is_rgb) {
+					for (i = 0; i < z->s->img_x; ++i) {
+						out[0] = y[i];
+						out[1] = coutput[1][i];
+						out[2] = coutput[2][i];
+						out[3] = 255;
+						out += n;
+					}
+				}
+				else {
+					z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+				}
+			}
+			else if (z->s->img_n == 4) {
+				if (z->app14_color_transform == 0) { // CMYK
+					for (i = 0; i < z->s->img_x; ++i) {
+						stbi_uc m = coutput[3][i];
+						out[0] = stbi__blinn_8x8(coutput[0][i], m);
+						out[1] = stbi__blinn_8x8(coutput[1][i], m);
+						out[2] = stbi__blinn_8x8(coutput[2][i], m);
+						out[3] = 255;
+						out += n;
+					}
+				}
+				else if (z->app14_color_transform == 2) { // YCCK
+					z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+					for (i = 0; i < z->s->img_x; ++i) {
+						stbi_uc m = coutput[3][i];
+						out[0] = stbi__blinn_8x8(255 - out[0], m);
+						out[1] = stbi__blinn_8x8(255 - out[1], m);
+						out[2] = stbi__blinn_8x8(255 - out[2], m);
+						out += n;
+					}
+				}
+				else { // YCbCr + alpha?  Ignore the fourth channel for now
+					z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+				}
+			}
+			else
+				for (i = 0; i < z->s->img_x; ++i) {
+					out[0] = out[1] = out[2] = y[i];
+					out[3] = 255; // not used if n==3
+					out += n;
+				}
+		}
+		else {
+			if (is_rgb) {
+				if (n == 1)
+					for (i = 0; i < z->s->img_x; ++i)
+						*out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+				else {
+					for (i = 0; i < z->s->img_x; ++i, out += 2) {
+						out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+						out[1] = 255;
+					}
+				}
+			}
+			else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+				for (i = 0; i < z->s->img_x; ++i) {
+					stbi_uc m = coutput[3][i];
+					stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+					stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+					stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+					out[0] = stbi__compute_y(r, g, b);
+					out[1] = 255;
+					out += n;
+				}
+			}
+			else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+				for (i = 0; i < z->s->img_x; ++i) {
+					out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+					out[1] = 255;
+					out += n;
+				}
+			}
+			else {
+				stbi_uc* y = coutput[0];
+				if (n == 1)
+					for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
+				else
+					for (i = 0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+			}
+		}
+	}
+}
+
+// moves r (set up for row 0 of component k) to output row j, in closed form:
+// after j rows, ystep has been incremented vs/2 + j times and wrapped once per vs
+static void stbi__jpeg_resample_seek(stbi__jpeg* z, stbi__resample* r, int k, unsigned int j)
+{
+	unsigned int steps = (unsigned int)(r->vs >> 1) + j;
+	int wraps = (int)(steps / r->vs);
+	int last = z->img_comp[k].y - 1;
+	r->ystep = (int)(steps % r->vs);
+	r->ypos = wraps;
+	r->line1 = z->img_comp[k].data + z->img_comp[k].w2 * (wraps < last ? wraps : last);
+	r->line0 = wraps == 0 ? z->img_comp[k].data : z->img_comp[k].data + z->img_comp[k].w2 * (wraps - 1 < last ? wraps - 1 : last);
+}
+
+typedef struct
+{
+	stbi__jpeg* z;
+	stbi__resample* res_comp; // at row 0
+	stbi_uc* output;
+	stbi_uc* scratch;         // decode_n line buffers and an output row per band
+	size_t band_bytes;
+	int n, decode_n, is_rgb, bands;
+} stbi__jpeg_output_job;
+
+static void stbi__jpeg_output_band(void* task_data, int index)
+{
+	stbi__jpeg_output_job* job = (stbi__jpeg_output_job*)task_data;
+	stbi__jpeg* z = job->z;
+	unsigned int j0 = (unsigned int)((double)z->s->img_y * index / job->bands);
+	unsigned int j1 = (unsigned int)((double)z->s->img_y * (index + 1) / job->bands);
+	size_t row_bytes = (size_t)job->n * z->s->img_x;
+	stbi_uc* scratch = job->scratch + job->band_bytes * index;
+	stbi__resample res_comp[4];
+	stbi_uc* linebuf[4];
+	int k;
+	if (j0 == j1)
+		return;
+	for (k = 0; k < job->decode_n; ++k) {
+		res_comp[k] = job->res_comp[k];
+		stbi__jpeg_resample_seek(z, &res_comp[k], k, j0);
+		linebuf[k] = scratch + (size_t)k * (z->s->img_x + 3);
+	}
+	// the row converters write one byte past each 3-channel row, which here
+	// is the first byte of the next band; so the last row goes via scratch
+	stbi__jpeg_output_rows(z, res_comp, linebuf, job->output + row_bytes * j0, job->n, job->decode_n, job->is_rgb, j0, j1 - 1);
+	scratch += (size_t)job->decode_n * (z->s->img_x + 3);
+	stbi__jpeg_output_rows(z, res_comp, linebuf, scratch, job->n, job->decode_n, job->is_rgb, j1 - 1, j1);
+	memcpy(job->output + row_bytes * (j1 - 1), scratch, row_bytes);
+}
+
 static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp, int req_comp)
 {
 	int n, decode_n, is_rgb;
@@ -3911,10 +4565,9 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
 
 	// resample and color-convert
 	{
-		int k;
-		unsigned int i, j;
+		int k, parallel = 0;
 		stbi_uc* output;
-		stbi_uc* coutput[4] = { NULL, NULL, NULL, NULL };
+		stbi_uc* linebuf[4];
 
 		stbi__resample res_comp[4];
 
@@ -3944,110 +4597,31 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
 		output = (stbi_uc*)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
 		if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-		// now go ahead and resample
-		for (j = 0; j < z->s->img_y; ++j) {
-			stbi_uc* out = output + n * z->s->img_x * j;
-			for (k = 0; k < decode_n; ++k) {
-				stbi__resample* r = &res_comp[k];
-				int y_bot = r->ystep >= (r->vs >> 1);
-				coutput[k] = r->resample(z->img_comp[k].linebuf,
-					y_bot ? r->line1 : r->line0,
-					y_bot ? r->line0 : r->line1,
-					r->w_lores, r->hs);
-				if (++r->ystep >= r->vs) {
-					r->ystep = 0;
-					r->line0 = r->line1;
-					if (++r->ypos < z->img_comp[k].y)
-						r->line1 += z->img_comp[k].w2;
-				}
-			}
-			if (n >= 3) {
-				stbi_uc* y = coutput[0];
-				if (z->s->img_n == 3) {
-					if (is_rgb) {
-						for (i = 0; i < z->s->img_x; ++i) {
-							out[0] = y[i];
-							out[1] = coutput[1][i];
-							out[2] = coutput[2][i];
-							out[3] = 255;
-							out += n;
-						}
-					}
-					else {
-						z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-					}
-				}
-				else if (z->s->img_n == 4) {
-					if (z->app14_color_transform == 0) { // CMYK
-						for (i = 0; i < z->s->img_x; ++i) {
-							stbi_uc m = coutput[3][i];
-							out[0] = stbi__blinn_8x8(coutput[0][i], m);
-							out[1] = stbi__blinn_8x8(coutput[1][i], m);
-							out[2] = stbi__blinn_8x8(coutput[2][i], m);
-							out[3] = 255;
-							out += n;
-						}
-					}
-					else if (z->app14_color_transform == 2) { // YCCK
-						z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-						for (i = 0; i < z->s->img_x; ++i) {
-							stbi_uc m = coutput[3][i];
-							out[0] = stbi__blinn_8x8(255 - out[0], m);
-							out[1] = stbi__blinn_8x8(255 - out[1], m);
-							out[2] = stbi__blinn_8x8(255 - out[2], m);
-							out += n;
-						}
-					}
-					else { // YCbCr + alpha?  Ignore the fourth channel for now
-						z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-					}
-				}
-				else
-					for (i = 0; i < z->s->img_x; ++i) {
-						out[0] = out[1] = out[2] = y[i];
-						out[3] = 255; // not used if n==3
-						out += n;
-					}
-			}
-			else {
-				if (is_rgb) {
-					if (n == 1)
-						for (i = 0; i < z->s->img_x; ++i)
-							*out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-					else {
-						for (i = 0; i < z->s->img_x; ++i, out += 2) {
-							out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-							out[1] = 255;
-						}
-					}
-				}
-				else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-					for (i = 0; i < z->s->img_x; ++i) {
-						stbi_uc m = coutput[3][i];
-						stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-						stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-						stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-						out[0] = stbi__compute_y(r, g, b);
-						out[1] = 255;
-						out += n;
-					}
-				}
-				else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-					for (i = 0; i < z->s->img_x; ++i) {
-						out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-						out[1] = 255;
-						out += n;
-					}
-				}
-				else {
-					stbi_uc* y = coutput[0];
-					if (n == 1)
-						for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
-					else
-						for (i = 0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-				}
+		// now go ahead and resample; rows only depend on the decoded
+		// components, so large images are done in parallel bands
+		if (stbi__jpeg_use_parallel(z)) {
+			stbi__jpeg_output_job job;
+			job.z = z;
+			job.res_comp = res_comp;
+			job.output = output;
+			job.n = n;
+			job.decode_n = decode_n;
+			job.is_rgb = is_rgb;
+			job.bands = stbi__jpeg_parallel_tasks * 2;
+			// img_x is < 1 << 24, so this can't overflow
+			job.band_bytes = (size_t)(decode_n + n) * z->s->img_x + 3 * decode_n + 1;
+			job.scratch = (stbi_uc*)stbi__malloc_mad2(job.bands, (int)job.band_bytes, 0);
+			if (job.scratch) {
+				stbi__jpeg_parallel_for_func(stbi__jpeg_parallel_user, job.bands, stbi__jpeg_output_band, &job);
+				STBI_FREE(job.scratch);
+				parallel = 1;
 			}
 		}
+		if (!parallel) {
+			for (k = 0; k < decode_n; ++k)
+				linebuf[k] = z->img_comp[k].linebuf;
+			stbi__jpeg_output_rows(z, res_comp, linebuf, output, n, decode_n, is_rgb, 0, z->s->img_y);
+		}
 		stbi__cleanup_jpeg(z);
 		*out_x = z->s->img_x;
 		*out_y = z->s->img_y;
@@ -7787,6 +8361,7 @@ static int stbi__info_main(stbi__context* s, int* x, int* y, int* comp)
 
 static int stbi__is_16_main(stbi__context* s)
 {
+	STBI_NOTUSED(s); // unused when only JPEG is compiled in
 #ifndef STBI_NO_PNG
 	if (stbi__png_is16(s))  return 1;
 #endif
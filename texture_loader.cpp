@@ -0,0 +1,380 @@
+#include "texture_loader.h"
+
+#include "gl_state.h"
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        std::streamsize size = file.tellg();
+        if (size <= 0)
+            return false;
+        bytes.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&bytes[0]), size));
+    }
+
+    struct DecodeTasks
+    {
+        stbi_jpeg_task* task;
+        void* data;
+    };
+
+    void runDecodeTasks(void* context, size_t begin, size_t end, size_t /*chunkIndex*/)
+    {
+        const DecodeTasks* tasks = static_cast<const DecodeTasks*>(context);
+        for (size_t i = begin; i < end; ++i)
+            tasks->task(tasks->data, static_cast<int>(i));
+    }
+}
+
+TextureLoader::TextureLoader(unsigned int threadCount, size_t ringBytes)
+    : placeholder(0), cookedLoads(0), ringBuffer(0), ringSize(ringBytes), ringHead(0), ringTail(0), quit(false)
+{
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &placeholder);
+    GLState::bindTexture(GL_TEXTURE_2D, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &ringBuffer);
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, NULL, GL_STREAM_DRAW);
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // the decode threads help with their own tasks while they wait, so the
+    // pool counts them in
+    stbi_jpeg_set_parallel_for(&TextureLoader::parallelFor, this, static_cast<int>(decodeJobs.workerCount()) + 1);
+    if (threadCount == 0)
+        threadCount = 1;
+    for (unsigned int i = 0; i < threadCount; ++i)
+        threads.push_back(std::thread(&TextureLoader::decodeLoop, this));
+}
+
+TextureLoader::~TextureLoader()
+{
+    release();
+}
+
+void TextureLoader::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+    threads.clear();
+    if (!ringBuffer)
+        return;
+    stbi_jpeg_set_parallel_for(NULL, NULL, 1);
+
+    for (size_t i = 0; i < decoded.size(); ++i)
+        free(decoded[i]);
+    decoded.clear();
+    for (size_t i = 0; i < waiting.size(); ++i)
+        free(waiting[i]);
+    waiting.clear();
+    for (size_t i = 0; i < uploads.size(); ++i)
+        glDeleteSync(uploads[i].fence);
+    uploads.clear();
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        glDeleteTextures(1, &slots[i].texture);
+        slots[i].texture = 0;
+    }
+    glDeleteTextures(1, &placeholder);
+    glDeleteBuffers(1, &ringBuffer);
+    placeholder = ringBuffer = 0;
+}
+
+TextureLoader::Handle TextureLoader::load(const char* path, const Options& options)
+{
+    Slot slot;
+    slot.path = path;
+    slot.options = options;
+    slot.state = DECODING;
+    slot.texture = 0;
+    slots.push_back(slot);
+
+    Request request;
+    request.handle = static_cast<Handle>(slots.size() - 1);
+    request.path = path;
+    request.flipVertically = options.flipVertically;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(request);
+    }
+    wake.notify_one();
+    return request.handle;
+}
+
+GLuint TextureLoader::get(Handle handle) const
+{
+    return slots[handle].state == RESIDENT ? slots[handle].texture : placeholder;
+}
+
+size_t TextureLoader::residentCount() const
+{
+    size_t resident = 0;
+    for (size_t i = 0; i < slots.size(); ++i)
+        resident += slots[i].state == RESIDENT;
+    return resident;
+}
+
+void TextureLoader::update()
+{
+    // fences signal in submission order, so stop at the first pending one
+    while (!uploads.empty())
+    {
+        GLenum status = glClientWaitSync(uploads.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(uploads.front().fence);
+        slots[uploads.front().handle].state = RESIDENT;
+        ringTail = uploads.front().ringEnd;
+        uploads.pop_front();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < decoded.size(); ++i)
+        {
+            slots[decoded[i].handle].state = DECODED;
+            waiting.push_back(decoded[i]);
+        }
+        decoded.clear();
+    }
+
+    // uploads are bounded by the free part of the ring, so a burst of large
+    // images spreads over several frames
+    while (!waiting.empty())
+    {
+        Decoded& image = waiting.front();
+        if (image.cooked)
+        {
+            uploadCooked(image);
+        }
+        else if (!image.pixels)
+        {
+            slots[image.handle].state = FAILED;
+            std::cout << "Failed to load texture " << slots[image.handle].path << std::endl;
+        }
+        else if (!upload(image))
+        {
+            break;
+        }
+        free(image);
+        waiting.pop_front();
+    }
+}
+
+void TextureLoader::finish()
+{
+    for (;;)
+    {
+        update();
+        size_t pending = 0;
+        for (size_t i = 0; i < slots.size(); ++i)
+            pending += slots[i].state != RESIDENT && slots[i].state != FAILED;
+        if (pending == 0)
+            return;
+        if (!uploads.empty())
+            glClientWaitSync(uploads.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool TextureLoader::allocate(size_t bytes, size_t& offset)
+{
+    // keep every region 16-byte aligned
+    bytes = (bytes + 15) & ~static_cast<size_t>(15);
+    if (uploads.empty())
+        ringHead = ringTail = 0;
+    if (bytes > ringSize)
+        return false;
+    if (uploads.empty() || ringHead > ringTail)
+    {
+        // used part is [ringTail, ringHead): try after it, then wrap to the start
+        if (ringSize - ringHead >= bytes)
+        {
+            offset = ringHead;
+            ringHead += bytes;
+            return true;
+        }
+        if (ringTail >= bytes)
+        {
+            offset = 0;
+            ringHead = bytes;
+            return true;
+        }
+        return false;
+    }
+    // wrapped: the free part is [ringHead, ringTail)
+    if (ringTail - ringHead >= bytes)
+    {
+        offset = ringHead;
+        ringHead += bytes;
+        return true;
+    }
+    return false;
+}
+
+bool TextureLoader::upload(const Decoded& image)
+{
+    size_t bytes = static_cast<size_t>(image.width) * image.height * image.channels;
+    size_t offset = 0;
+    bool inRing = allocate(bytes, offset);
+    // an image that could never fit is uploaded from memory; others wait for room
+    if (!inRing && bytes <= ringSize)
+        return false;
+
+    static const GLenum formats[5] = { 0, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    GLenum format = formats[image.channels];
+    Slot& slot = slots[image.handle];
+    glGenTextures(1, &slot.texture);
+    GLState::bindTexture(GL_TEXTURE_2D, slot.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, slot.options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, slot.options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, slot.options.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, slot.options.magFilter);
+    if (image.channels < 3)
+    {
+        // grey (and grey + alpha) images read as grey, not red
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, image.channels == 2 ? GL_GREEN : GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    // rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (inRing)
+    {
+        // the fences guarantee the GPU is done with this part of the ring
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+        void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        memcpy(target, image.pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (void*)offset);
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
+
+    Upload pending;
+    pending.handle = image.handle;
+    pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // everything allocated so far is free again once this upload retires
+    pending.ringEnd = ringHead;
+    uploads.push_back(pending);
+    slot.state = UPLOADING;
+    return true;
+}
+
+void TextureLoader::uploadCooked(const Decoded& image)
+{
+    static const GLenum formats[5] = { 0, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    const CookedTextureHeader& header = image.cooked->header();
+    GLenum format = formats[header.format];
+    Slot& slot = slots[image.handle];
+    glGenTextures(1, &slot.texture);
+    GLState::bindTexture(GL_TEXTURE_2D, slot.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, slot.options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, slot.options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, slot.options.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, slot.options.magFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(header.levelCount - 1));
+    if (header.format < COOKED_RGB8)
+    {
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, header.format == COOKED_RG8 ? GL_GREEN : GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    // every level comes straight from the mapping; the driver has its copy
+    // when glTexImage2D returns, so the file can be unmapped right after
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int level = 0; level < header.levelCount; ++level)
+    {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), format, header.levels[level].width, header.levels[level].height,
+                     0, format, GL_UNSIGNED_BYTE, image.cooked->level(level));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
+
+    Upload pending;
+    pending.handle = image.handle;
+    pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pending.ringEnd = ringHead;
+    uploads.push_back(pending);
+    slot.state = UPLOADING;
+    ++cookedLoads;
+}
+
+void TextureLoader::free(Decoded& image)
+{
+    stbi_image_free(image.pixels);
+    delete image.cooked;
+    image.pixels = NULL;
+    image.cooked = NULL;
+}
+
+void TextureLoader::parallelFor(void* loader, int count, void (*task)(void*, int), void* taskData)
+{
+    JobSystem& jobs = static_cast<TextureLoader*>(loader)->decodeJobs;
+    DecodeTasks tasks = { task, taskData };
+    JobCounter counter;
+    jobs.parallelFor(static_cast<size_t>(count), 1, runDecodeTasks, &tasks, counter);
+    jobs.wait(counter);
+}
+
+void TextureLoader::decodeLoop()
+{
+    for (;;)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return quit || !requests.empty(); });
+            if (quit)
+                return;
+            request = requests.front();
+            requests.pop_front();
+        }
+
+        Decoded image;
+        image.handle = request.handle;
+        image.pixels = NULL;
+        image.cooked = new CookedTexture();
+        std::string cookedPath = cookedTexturePath(request.path);
+        if (!image.cooked->open(cookedPath.c_str()) || !image.cooked->isCurrent(request.path.c_str(), request.flipVertically))
+        {
+            delete image.cooked;
+            image.cooked = NULL;
+            // the flip flag is per thread, so loaders with different options do not race
+            stbi_set_flip_vertically_on_load_thread(request.flipVertically);
+            std::vector<unsigned char> bytes;
+            if (readFile(request.path, bytes))
+                image.pixels = stbi_load_from_memory(&bytes[0], static_cast<int>(bytes.size()),
+                                                     &image.width, &image.height, &image.channels, 0);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        decoded.push_back(image);
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include "cooked_texture.h"
+#include "job_system.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads 2D textures without blocking the render thread. load() returns a
+// handle at once; the file is decoded with stb_image on the loader's own
+// threads (not the job system, so a long decode never holds up a simulation
+// step), then copied into a ring of pixel unpack buffers and uploaded from
+// there. A fence after each upload tells when the texture is resident and its
+// part of the ring can be reused. Until then get() returns a shared 1x1
+// placeholder, so drawing code never has to check.
+//
+// If an up-to-date cooked file (cookedTexturePath() of the image) exists, it
+// is mapped instead and its mip levels are uploaded straight from the mapping.
+//
+// Files are read into memory before decoding, so stb_image can split a large
+// JPEG (restart intervals, progressive IDCT, color conversion) into tasks; the
+// loader hands those to a job system of its own while it is alive.
+class TextureLoader
+{
+public:
+    typedef unsigned int Handle;
+
+    struct Options
+    {
+        GLint wrap;
+        GLint minFilter;
+        GLint magFilter;
+        bool flipVertically;
+        Options() : wrap(GL_REPEAT), minFilter(GL_LINEAR), magFilter(GL_LINEAR), flipVertically(true) {}
+    };
+
+    // ringBytes is the size of the pixel unpack ring, which also bounds what
+    // is uploaded per frame; larger images are uploaded straight from memory
+    explicit TextureLoader(unsigned int threadCount = 2, size_t ringBytes = 16 << 20);
+    ~TextureLoader();
+    // stops the decode threads and deletes every GL object; call before glfwTerminate()
+    void release();
+
+    // queues path for loading; must be called on the render thread
+    Handle load(const char* path, const Options& options = Options());
+
+    // call once per frame on the render thread: retires finished uploads and
+    // starts new ones for decoded images that fit in the ring
+    void update();
+    // blocks until every queued texture is resident or has failed, for runs
+    // whose output must not depend on how long loading took
+    void finish();
+
+    // the texture if it is resident, otherwise the placeholder
+    GLuint get(Handle handle) const;
+    bool ready(Handle handle) const { return slots[handle].state == RESIDENT; }
+    size_t count() const { return slots.size(); }
+    size_t residentCount() const;
+    // textures that came from a cooked file rather than the image
+    size_t cookedCount() const { return cookedLoads; }
+
+private:
+    enum State { DECODING, DECODED, UPLOADING, RESIDENT, FAILED };
+    struct Slot
+    {
+        std::string path;
+        Options options;
+        State state;
+        GLuint texture;
+    };
+    struct Request
+    {
+        Handle handle;
+        std::string path;
+        bool flipVertically;
+    };
+    struct Decoded
+    {
+        Handle handle;
+        unsigned char* pixels; // from stbi_load, NULL if decoding failed
+        CookedTexture* cooked; // instead of pixels if a current cooked file exists
+        int width;
+        int height;
+        int channels;
+    };
+    // an upload whose fence has not signalled yet; ringEnd is where its part of the ring ends
+    struct Upload
+    {
+        Handle handle;
+        GLsync fence;
+        size_t ringEnd;
+    };
+
+    std::vector<Slot> slots;
+    GLuint placeholder;
+    size_t cookedLoads;
+
+    // pixel unpack ring: bytes [ringTail, ringHead) (wrapping) are in flight
+    GLuint ringBuffer;
+    size_t ringSize;
+    size_t ringHead;
+    size_t ringTail;
+    std::deque<Upload> uploads;
+    // decoded images waiting for room in the ring
+    std::deque<Decoded> waiting;
+
+    std::vector<std::thread> threads;
+    JobSystem decodeJobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> requests;
+    std::vector<Decoded> decoded;
+    bool quit;
+
+    bool allocate(size_t bytes, size_t& offset);
+    bool upload(const Decoded& image);
+    void uploadCooked(const Decoded& image);
+    static void free(Decoded& image);
+    static void parallelFor(void* loader, int count, void (*task)(void*, int), void* taskData);
+    void decodeLoop();
+
+    TextureLoader(const TextureLoader&);
+    TextureLoader& operator=(const TextureLoader&);
+};
+#endif
@@ -0,0 +1,36 @@
+// Scene compile step: converts .scene text files into the .cscene files (see
+// scene_file.h) the app maps at startup. The app compiles a scene itself when
+// its compiled file is missing or stale, so this is for shipping compiled
+// scenes or checking a scene for errors without starting the app.
+//
+//   g++ -O2 -std=c++14 -I.. -I<glm> scene_compile.cpp ../scene_file.cpp ../mapped_file.cpp -o scene_compile
+//   ./scene_compile scene...
+
+#include "scene_file.h"
+
+#include <cstdio>
+
+int main(int argc, char** argv)
+{
+    int failures = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string target = compiledScenePath(argv[i]);
+        CompiledScene result;
+        if (compileSceneFile(argv[i], target.c_str()) && result.open(target.c_str()))
+        {
+            printf("%s -> %s: %zu rooms, %zu boards, %zu lights, %zu fireflies, %zu ball sets\n", argv[i], target.c_str(),
+                   result.roomCount(), result.boardCount(), result.lightCount(), result.emitterCount(), result.ballSetCount());
+        }
+        else
+        {
+            ++failures;
+        }
+    }
+    if (argc < 2)
+    {
+        printf("usage: %s scene...\n", argv[0]);
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
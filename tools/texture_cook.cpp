@@ -0,0 +1,53 @@
+// Texture cook step: converts images into .ctex files (see cooked_texture.h)
+// next to them, with the full mip chain, for TextureLoader to map at runtime.
+// Run it from the asset directory after changing a texture; the app falls
+// back to decoding the image while its cooked file is missing or stale.
+//
+//   g++ -O2 -std=c++14 -I.. texture_cook.cpp ../cooked_texture.cpp ../mapped_file.cpp -o texture_cook
+//   ./texture_cook [--no-flip] image...
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "cooked_texture.h"
+
+#include <cstdio>
+#include <cstring>
+
+int main(int argc, char** argv)
+{
+    // the app loads every texture flipped, as OpenGL expects the bottom row first
+    bool flip = true;
+    int failures = 0;
+    int cooked = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-flip") == 0)
+        {
+            flip = false;
+            continue;
+        }
+        std::string target = cookedTexturePath(argv[i]);
+        if (cookTexture(argv[i], target.c_str(), flip))
+        {
+            CookedTexture result;
+            if (result.open(target.c_str()))
+            {
+                const CookedTextureHeader& header = result.header();
+                printf("%s -> %s: %ux%u, %u channels, %u levels\n", argv[i], target.c_str(),
+                       header.levels[0].width, header.levels[0].height, header.format, header.levelCount);
+            }
+            ++cooked;
+        }
+        else
+        {
+            ++failures;
+        }
+    }
+    if (cooked + failures == 0)
+    {
+        printf("usage: %s [--no-flip] image...\n", argv[0]);
+        return 1;
+    }
+    return failures ? 1 : 0;
+}